@@ -70,6 +70,12 @@ typedef struct
   unsigned long  pos;
 } F_POS;
 
+typedef struct
+{
+  unsigned long  sector; /*first physical sector*/
+  unsigned long  count;  /*number of consecutive sectors*/
+} F_EXTENT;
+
 typedef struct
 {
   char            filename[F_MAXPATH]; /*file name+ext*/
@@ -302,6 +308,12 @@ unsigned char fn_seteof ( F_FILE * );
 
 F_FILE * fn_truncate ( const char *, long );
 
+unsigned char fn_sync ( void );
+
+unsigned char fn_getextents ( const char * filename, F_EXTENT * extents, unsigned char max, unsigned char * num );
+unsigned char fn_readsector ( void * buf, unsigned long sector );
+unsigned char fn_writesector ( const void * buf, unsigned long sector );
+
 unsigned char fn_getcwd ( char * buffer, unsigned char maxlen, char root );
 
 unsigned char fn_hardformat ( unsigned char fattype );
@@ -351,6 +363,16 @@ unsigned char fr_getserial ( unsigned long * );
 unsigned char fr_flush ( F_FILE * f );
 #define f_flush( filehandle ) fr_flush( filehandle )
 
+unsigned char fr_sync ( void );
+#define f_sync() fr_sync()
+
+unsigned char fr_getextents ( const char * filename, F_EXTENT * extents, unsigned char max, unsigned char * num );
+#define f_getextents( filename, extents, max, num ) fr_getextents( filename, extents, max, num )
+unsigned char fr_readsector ( void * buf, unsigned long sector );
+#define f_readsector( buf, sector ) fr_readsector( buf, sector )
+unsigned char fr_writesector ( const void * buf, unsigned long sector );
+#define f_writesector( buf, sector ) fr_writesector( buf, sector )
+
 long fr_write ( const void * buf, long size, long _size_t, F_FILE * filehandle );
 #define f_write( buf, size, _size_t, filehandle ) fr_write( buf, size, _size_t, filehandle )
 
@@ -411,6 +433,12 @@ unsigned char fn_findnext ( F_FIND * find );
 unsigned char fn_flush ( F_FILE * f );
 #define f_flush( filehandle ) fn_flush( filehandle )
 
+#define f_sync() fn_sync()
+
+#define f_getextents( filename, extents, max, num ) fn_getextents( filename, extents, max, num )
+#define f_readsector( buf, sector )  fn_readsector( buf, sector )
+#define f_writesector( buf, sector ) fn_writesector( buf, sector )
+
 #define f_write( buf, size, _size_t, filehandle ) fn_write( buf, size, _size_t, filehandle )
 
 #define f_seek( filehandle, offset, whence ) fn_seek( filehandle, offset, whence )
@@ -44,6 +44,8 @@
 #include "drv.h"
 #include "util.h"
 #include "volume.h"
+#include "dir.h"
+#include "fat.h"
 
 #include "../../version/ver_fat_sl.h"
 #if VER_FAT_SL_MAJOR != 5 || VER_FAT_SL_MINOR != 2
@@ -79,6 +81,27 @@ unsigned char _f_checkstatus ( void )
 }
 
 
+/****************************************************************************
+ *
+ * _f_patchsyncentry
+ *
+ * apply a deferred directory entry update to gl_sector if it holds the
+ * directory sector of that entry, so every reader sees the pending size and
+ * start cluster
+ *
+ ***************************************************************************/
+void _f_patchsyncentry ( void )
+{
+  if ( gl_volume.syncpending && ( gl_volume.actsector == gl_volume.syncsector ) )
+  {
+    F_DIRENTRY * de = (F_DIRENTRY *)( gl_sector + sizeof( F_DIRENTRY ) * gl_volume.syncpos );
+
+    _f_setdecluster( de, gl_volume.syncstartcluster );
+    _f_setlong( &de->filesize, gl_volume.syncfilesize );
+  }
+} /* _f_patchsyncentry */
+
+
 /****************************************************************************
  *
  * _f_writesector
@@ -145,6 +168,15 @@ unsigned char _f_writeglsector ( unsigned long sector )
       mdrv_ret = mdrv->writesector( mdrv, (unsigned char *)gl_sector, sector );
       if ( !mdrv_ret )
       {
+        if ( sector == gl_volume.syncsector )
+        {
+          gl_volume.syncpending = 0; /*deferred entry written with this sector*/
+        }
+
+#if F_FAT_MIRROR_LAZY
+        _f_markfatmirror( sector ); /*also when flushed by _f_readglsector*/
+#endif
+
         return F_NO_ERROR;
       }
 
@@ -202,6 +234,7 @@ unsigned char _f_readglsector ( unsigned long sector )
     if ( !mdrv_ret )
     {
       gl_volume.actsector = sector;
+      _f_patchsyncentry();
       return F_NO_ERROR;
     }
 
@@ -55,6 +55,7 @@ extern F_DRIVER * mdrv;  /* driver structure */
 unsigned char _f_checkstatus ( void );
 unsigned char _f_readglsector ( unsigned long );
 unsigned char _f_writeglsector ( unsigned long );
+void _f_patchsyncentry ( void );
 
 #ifdef __cplusplus
 }
@@ -417,6 +417,102 @@ unsigned char fr_hardformat ( unsigned char fattype )
   return rc;
 }
 
+/*
+** fr_sync
+**
+** Write a directory entry update deferred by F_SYNC_POLICY
+**
+** RETURN: error code
+*/
+unsigned char fr_sync ( void )
+{
+  unsigned char  rc;
+
+  if( xSemaphoreTake( fs_lock_semaphore, F_MAX_LOCK_WAIT_TICKS ) == pdPASS )
+  {
+    rc = fn_sync();
+    xSemaphoreGive( fs_lock_semaphore );
+  }
+  else
+  {
+    rc = F_ERR_OS;
+  }
+
+  return rc;
+}
+
+/*
+** fr_getextents
+**
+** Get the physical sector ranges of a file
+**
+** RETURN: error code
+*/
+unsigned char fr_getextents ( const char * filename, F_EXTENT * extents, unsigned char max, unsigned char * num )
+{
+  unsigned char  rc;
+
+  if( xSemaphoreTake( fs_lock_semaphore, F_MAX_LOCK_WAIT_TICKS ) == pdPASS )
+  {
+    rc = fn_getextents( filename, extents, max, num );
+    xSemaphoreGive( fs_lock_semaphore );
+  }
+  else
+  {
+    rc = F_ERR_OS;
+  }
+
+  return rc;
+}
+
+/*
+** fr_readsector
+**
+** Read a physical sector bypassing the file system
+**
+** RETURN: error code
+*/
+unsigned char fr_readsector ( void * buf, unsigned long sector )
+{
+  unsigned char  rc;
+
+  if( xSemaphoreTake( fs_lock_semaphore, F_MAX_LOCK_WAIT_TICKS ) == pdPASS )
+  {
+    rc = fn_readsector( buf, sector );
+    xSemaphoreGive( fs_lock_semaphore );
+  }
+  else
+  {
+    rc = F_ERR_OS;
+  }
+
+  return rc;
+}
+
+/*
+** fr_writesector
+**
+** Write a physical sector bypassing the file system
+**
+** RETURN: error code
+*/
+unsigned char fr_writesector ( const void * buf, unsigned long sector )
+{
+  unsigned char  rc;
+
+  if( xSemaphoreTake( fs_lock_semaphore, F_MAX_LOCK_WAIT_TICKS ) == pdPASS )
+  {
+    rc = fn_writesector( buf, sector );
+    xSemaphoreGive( fs_lock_semaphore );
+  }
+  else
+  {
+    rc = F_ERR_OS;
+  }
+
+  return rc;
+}
+
 /*
 ** fr_get_serial
 **
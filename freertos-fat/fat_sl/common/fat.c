@@ -38,6 +38,7 @@
  *
  */
 #include "../../api/fat_sl.h"
+#include "../../psp/include/psp_string.h"
 
 #include "fat.h"
 #include "util.h"
@@ -49,12 +50,158 @@
  #error Incompatible FAT_SL version number!
 #endif
 
+#if F_FAT_MIRROR_LAZY
+
+/****************************************************************************
+ *
+ * _f_resetfatmirror
+ *
+ * clear the mirror dirty map and size its groups for the mounted volume
+ *
+ ***************************************************************************/
+void _f_resetfatmirror ( void )
+{
+  gl_volume.mirrorgroup = ( gl_volume.firstfat.num + F_FAT_MIRROR_MAP_BITS - 1 ) / F_FAT_MIRROR_MAP_BITS;
+  if ( !gl_volume.mirrorgroup )
+  {
+    gl_volume.mirrorgroup = 1;
+  }
+
+  psp_memset( gl_volume.mirrormap, 0, sizeof( gl_volume.mirrormap ) );
+} /* _f_resetfatmirror */
+
+
+/****************************************************************************
+ *
+ * _f_markfatmirror
+ *
+ * mark a sector written to the first fat as still to be copied to the
+ * mirror fats, every write of a fat sector goes through here however it
+ * was flushed
+ *
+ * INPUTS
+ *
+ * sector - physical sector written
+ *
+ ***************************************************************************/
+void _f_markfatmirror ( unsigned long sector )
+{
+  unsigned long  bit;
+
+  if ( gl_volume.state != F_STATE_WORKING )
+  {
+    return; /*format writes every fat itself*/
+  }
+
+  if ( ( sector < gl_volume.firstfat.sector ) || ( sector >= gl_volume.firstfat.sector + gl_volume.firstfat.num ) )
+  {
+    return;
+  }
+
+  bit = ( sector - gl_volume.firstfat.sector ) / gl_volume.mirrorgroup;
+  gl_volume.mirrormap[bit >> 3] |= (unsigned char)( 1u << ( bit & 7 ) );
+} /* _f_markfatmirror */
+
+
+/****************************************************************************
+ *
+ * _f_ismirrordirty
+ *
+ * check if a fat sector has changes not yet copied to the mirror fats
+ *
+ * INPUTS
+ *
+ * sector - zero based fat sector
+ *
+ ***************************************************************************/
+static unsigned char _f_ismirrordirty ( unsigned long sector )
+{
+  unsigned long  bit = sector / gl_volume.mirrorgroup;
+
+  return (unsigned char)( gl_volume.mirrormap[bit >> 3] & ( 1u << ( bit & 7 ) ) );
+} /* _f_ismirrordirty */
+
+
+/****************************************************************************
+ *
+ * _f_mirrorfat
+ *
+ * copy every fat sector marked in the dirty map from the first fat to the
+ * mirror fats
+ *
+ * RETURNS
+ *
+ * error code or zero if successful
+ *
+ ***************************************************************************/
+unsigned char _f_mirrorfat ( void )
+{
+  unsigned long  bit;
+  unsigned char  ret;
+
+  ret = _f_writefatsector(); /*so the sector being changed is marked too*/
+  if ( ret )
+  {
+    return ret;
+  }
+
+  gl_volume.fatsector = (unsigned long)-1; /*gl_sector is reused below*/
+
+  for ( bit = 0 ; bit < F_FAT_MIRROR_MAP_BITS ; bit++ )
+  {
+    unsigned long  sector;
+    unsigned long  end;
+
+    if ( !( gl_volume.mirrormap[bit >> 3] & ( 1u << ( bit & 7 ) ) ) )
+    {
+      continue;
+    }
+
+    sector = bit * gl_volume.mirrorgroup;
+    end = sector + gl_volume.mirrorgroup;
+    if ( end > gl_volume.firstfat.num )
+    {
+      end = gl_volume.firstfat.num;
+    }
+
+    for ( ; sector < end ; sector++ )
+    {
+      unsigned long  fatsector = gl_volume.firstfat.sector + sector;
+      unsigned char  a;
+
+      ret = _f_readglsector( fatsector );
+      if ( ret )
+      {
+        return ret;
+      }
+
+      for ( a = 1 ; a < gl_volume.bootrecord.number_of_FATs ; a++ )
+      {
+        fatsector += gl_volume.firstfat.num;
+        ret = _f_writeglsector( fatsector );
+        if ( ret )
+        {
+          return ret;
+        }
+      }
+    }
+
+    gl_volume.mirrormap[bit >> 3] &= (unsigned char)~( 1u << ( bit & 7 ) );
+  }
+
+  return F_NO_ERROR;
+} /* _f_mirrorfat */
+
+#endif /* F_FAT_MIRROR_LAZY */
+
+
 /****************************************************************************
  *
  * _f_writefatsector
  *
  * writing fat sector into volume, this function check if fat was modified
- * and writes data
+ * and writes data, with F_FAT_MIRROR_LAZY only the first fat is written and
+ * _f_writeglsector marks the sector for _f_mirrorfat
  *
  * RETURNS
  *
@@ -63,7 +210,9 @@
  ***************************************************************************/
 unsigned char _f_writefatsector ( void )
 {
+#if !F_FAT_MIRROR_LAZY
   unsigned char  a;
+#endif
 
   if ( gl_volume.modified )
   {
@@ -74,6 +223,17 @@ unsigned char _f_writefatsector ( void )
       return F_ERR_INVALIDSECTOR;
     }
 
+#if F_FAT_MIRROR_LAZY
+    {
+      unsigned char  ret;
+
+      ret = _f_writeglsector( fatsector ); /*marks it for _f_mirrorfat*/
+      if ( ret )
+      {
+        return ret;
+      }
+    }
+#else
     for ( a = 0 ; a < gl_volume.bootrecord.number_of_FATs ; a++ )
     {
       unsigned char  ret;
@@ -85,6 +245,7 @@ unsigned char _f_writefatsector ( void )
 
       fatsector += gl_volume.firstfat.num;
     }
+#endif
 
     gl_volume.modified = 0;
   }
@@ -133,6 +294,13 @@ unsigned char _f_getfatsector ( unsigned long sector )
         return F_NO_ERROR;
       }
 
+#if F_FAT_MIRROR_LAZY
+      if ( _f_ismirrordirty( sector ) )
+      {
+        break; /*mirror is stale*/
+      }
+#endif
+
       fatsector += gl_volume.firstfat.num;
     }
 
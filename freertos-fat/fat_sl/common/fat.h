@@ -60,6 +60,12 @@ unsigned char _f_setclustervalue ( unsigned long, unsigned long );
 unsigned char _f_alloccluster ( unsigned long * );
 unsigned char _f_removechain ( unsigned long );
 
+#if F_FAT_MIRROR_LAZY
+void _f_resetfatmirror ( void );
+void _f_markfatmirror ( unsigned long );
+unsigned char _f_mirrorfat ( void );
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -661,6 +661,7 @@ static unsigned char _f_updatefileentry ( int remove )
   F_DIRENTRY    * de;
   unsigned short  date;
   unsigned short  time;
+  unsigned char   ret;
 
   de = (F_DIRENTRY *)( gl_sector + sizeof( F_DIRENTRY ) * gl_file.dirpos.pos );
   if ( _f_readglsector( gl_file.dirpos.sector ) || remove )
@@ -682,10 +683,110 @@ static unsigned char _f_updatefileentry ( int remove )
     _f_setword( &de->lastaccessdate, date );  /*if there is realtime clock then creation date could be set from*/
   }
 
-  return _f_writeglsector( (unsigned long)-1 );
+  ret = _f_writeglsector( (unsigned long)-1 );
+  if ( !ret )
+  {
+#if F_SYNC_POLICY == F_SYNC_PERIODIC
+    gl_volume.synctime = F_SYNC_GETMS();
+#endif
+  }
+
+  return ret;
 } /* _f_updatefileentry */
 
 
+/****************************************************************************
+ * _f_writesyncentry
+ * Writes a deferred directory entry update to the media.
+ ***************************************************************************/
+static unsigned char _f_writesyncentry ( void )
+{
+  F_DIRENTRY    * de;
+  unsigned short  date;
+  unsigned short  time;
+  unsigned char   ret;
+
+  if ( !gl_volume.syncpending )
+  {
+    return F_NO_ERROR;
+  }
+
+  ret = _f_readglsector( gl_volume.syncsector ); /*pending values are patched in on read*/
+  if ( ret )
+  {
+    return ret;
+  }
+
+  de = (F_DIRENTRY *)( gl_sector + sizeof( F_DIRENTRY ) * gl_volume.syncpos );
+  f_igettimedate( &time, &date );
+  _f_setword( &de->cdate, date );
+  _f_setword( &de->ctime, time );
+  if ( gl_volume.mediatype == F_FAT32_MEDIA )
+  {
+    _f_setword( &de->lastaccessdate, date );
+  }
+
+  ret = _f_writeglsector( gl_volume.syncsector );
+  if ( !ret )
+  {
+#if F_SYNC_POLICY == F_SYNC_PERIODIC
+    gl_volume.synctime = F_SYNC_GETMS();
+#endif
+  }
+
+  return ret;
+} /* _f_writesyncentry */
+
+
+/****************************************************************************
+ * _f_deferfileentry
+ * Updates the directory entry of the open file according to F_SYNC_POLICY,
+ * either immediately or by recording it as the deferred entry.
+ ***************************************************************************/
+static unsigned char _f_deferfileentry ( void )
+{
+#if F_SYNC_POLICY != F_SYNC_ON_CLOSE
+  unsigned char  ret;
+
+  /* only one entry can be deferred, write out any other file's entry */
+  if ( gl_volume.syncpending
+      && ( ( gl_volume.syncsector != gl_file.dirpos.sector ) || ( gl_volume.syncpos != gl_file.dirpos.pos ) ) )
+  {
+    ret = _f_writesyncentry();
+    if ( ret )
+    {
+      return ret;
+    }
+  }
+
+ #if F_SYNC_POLICY == F_SYNC_PERIODIC
+  if ( F_SYNC_GETMS() - gl_volume.synctime >= F_SYNC_PERIOD_MS )
+  {
+    ret = _f_updatefileentry( 0 );
+  #if F_FAT_MIRROR_LAZY
+    if ( !ret )
+    {
+      ret = _f_mirrorfat();
+    }
+  #endif
+    return ret;
+  }
+ #endif
+
+  gl_volume.syncsector = gl_file.dirpos.sector;
+  gl_volume.syncpos = gl_file.dirpos.pos;
+  gl_volume.syncstartcluster = gl_file.startcluster;
+  gl_volume.syncfilesize = gl_file.filesize;
+  gl_volume.syncpending = 1;
+
+  _f_patchsyncentry(); /*keep a cached copy of the directory sector coherent*/
+  return F_NO_ERROR;
+#else
+  return _f_updatefileentry( 0 );
+#endif /* F_SYNC_POLICY != F_SYNC_ON_CLOSE */
+} /* _f_deferfileentry */
+
+
 /****************************************************************************
  *
  * fn_close
@@ -746,7 +847,7 @@ unsigned char fn_close ( F_FILE * f )
       }
     }
 
-    ret = _f_updatefileentry( 0 );
+    ret = _f_deferfileentry();
 
  #if F_FILE_CHANGED_EVENT
     if ( f_filechangedevent && !ret )
@@ -823,13 +924,270 @@ unsigned char fn_flush ( F_FILE * f )
       }
     }
 
-    return _f_updatefileentry( 0 );
+    return _f_deferfileentry();
   }
 
   return F_NO_ERROR;
 } /* fn_flush */
 
 
+/****************************************************************************
+ *
+ * fn_sync
+ *
+ * write a directory entry update deferred by F_SYNC_POLICY to the media and
+ * copy fat sectors changed under F_FAT_MIRROR_LAZY to the mirror fats
+ *
+ * RETURNS
+ *
+ * error code or zero if successful
+ *
+ ***************************************************************************/
+unsigned char fn_sync ( void )
+{
+  unsigned char  ret;
+
+  ret = _f_getvolume();
+  if ( ret )
+  {
+    return ret;
+  }
+
+  if ( gl_file.mode != F_FILE_CLOSE )
+  {
+    return F_ERR_LOCKED;
+  }
+
+  return _f_syncvolume();
+} /* fn_sync */
+
+
+/****************************************************************************
+ *
+ * _f_syncvolume
+ *
+ * write everything deferred by F_SYNC_POLICY and F_FAT_MIRROR_LAZY, whether
+ * or not a file is open, used by fn_sync and at unmount
+ *
+ * RETURNS
+ *
+ * error code or zero if successful
+ *
+ ***************************************************************************/
+unsigned char _f_syncvolume ( void )
+{
+  unsigned char  ret;
+
+  ret = _f_writesyncentry();
+#if F_FAT_MIRROR_LAZY
+  if ( !ret )
+  {
+    ret = _f_mirrorfat();
+  }
+#endif
+
+  return ret;
+} /* _f_syncvolume */
+
+
+/****************************************************************************
+ *
+ * fn_getextents
+ *
+ * get the physical sector ranges occupied by a file, so a preallocated file
+ * can be accessed with fn_readsector and fn_writesector without cluster
+ * chain walks or directory updates
+ *
+ * INPUTS
+ *
+ * filename - file whose extents are needed
+ * extents - where to store the sector ranges in file order
+ * max - number of entries in extents
+ * num - where to store the number of ranges found
+ *
+ * RETURNS
+ *
+ * error code or zero if successful, F_ERR_ALLOCATION if the file is split
+ * into more than max ranges
+ *
+ ***************************************************************************/
+unsigned char fn_getextents ( const char * filename, F_EXTENT * extents, unsigned char max, unsigned char * num )
+{
+  F_POS          pos;
+  F_DIRENTRY   * de;
+  F_NAME         fsname;
+  unsigned long  cluster;
+  unsigned long  remain;
+  unsigned long  sectorcou;
+  unsigned char  ret;
+
+  *num = 0;
+
+  if ( _f_setfsname( filename, &fsname ) )
+  {
+    return F_ERR_INVALIDNAME;                                     /*invalid name*/
+  }
+
+  if ( _f_checknamewc( fsname.filename, fsname.fileext ) )
+  {
+    return F_ERR_INVALIDNAME;                                                    /*invalid name*/
+  }
+
+  ret = _f_getvolume();
+  if ( ret )
+  {
+    return ret;
+  }
+
+  if ( !_f_findpath( &fsname, &pos ) )
+  {
+    return F_ERR_INVALIDDIR;
+  }
+
+  if ( !_f_findfilewc( fsname.filename, fsname.fileext, &pos, &de, 0 ) )
+  {
+    return F_ERR_NOTFOUND;
+  }
+
+  if ( de->attr & F_ATTR_DIR )
+  {
+    return F_ERR_INVALIDDIR;                                /*directory*/
+  }
+
+  cluster = _f_getdecluster( de );
+  remain = ( _f_getlong( &de->filesize ) + F_SECTOR_SIZE - 1 ) / F_SECTOR_SIZE;
+  sectorcou = gl_volume.bootrecord.sector_per_cluster;
+
+  gl_volume.fatsector = (unsigned long)-1;
+  while ( remain )
+  {
+    F_POS          cpos;
+    unsigned long  count;
+
+    if ( ( cluster < 2 ) || ( cluster >= F_CLUSTER_RESERVED ) )
+    {
+      return F_ERR_EOF;                                    /*chain shorter than size*/
+    }
+
+    _f_clustertopos( cluster, &cpos );
+    count = ( remain < sectorcou ) ? remain : sectorcou;
+
+    if ( *num && ( extents[*num - 1].sector + extents[*num - 1].count == cpos.sector ) )
+    {
+      extents[*num - 1].count += count;
+    }
+    else
+    {
+      if ( *num == max )
+      {
+        return F_ERR_ALLOCATION;
+      }
+
+      extents[*num].sector = cpos.sector;
+      extents[*num].count = count;
+      ( *num )++;
+    }
+
+    remain -= count;
+    if ( remain )
+    {
+      ret = _f_getclustervalue( cluster, &cluster );
+      if ( ret )
+      {
+        return ret;
+      }
+    }
+  }
+
+  return F_NO_ERROR;
+} /* fn_getextents */
+
+
+/****************************************************************************
+ *
+ * fn_readsector
+ *
+ * read a physical sector into a caller buffer, bypassing the file system
+ *
+ * INPUTS
+ *
+ * buf - where to store F_SECTOR_SIZE bytes
+ * sector - physical sector, normally taken from fn_getextents
+ *
+ * RETURNS
+ *
+ * error code or zero if successful
+ *
+ ***************************************************************************/
+unsigned char fn_readsector ( void * buf, unsigned long sector )
+{
+  unsigned char  ret;
+
+  ret = _f_getvolume();
+  if ( ret )
+  {
+    return ret;
+  }
+
+  if ( ( sector == gl_volume.actsector ) && ( gl_volume.modified || gl_file.modified ) )
+  {
+    ret = _f_writeglsector( (unsigned long)-1 );
+    if ( ret )
+    {
+      return ret;
+    }
+  }
+
+  if ( mdrv->readsector( mdrv, buf, sector ) )
+  {
+    return F_ERR_READ;
+  }
+
+  return F_NO_ERROR;
+} /* fn_readsector */
+
+
+/****************************************************************************
+ *
+ * fn_writesector
+ *
+ * write a physical sector from a caller buffer, bypassing the file system,
+ * the sector must belong to a file located with fn_getextents
+ *
+ * INPUTS
+ *
+ * buf - F_SECTOR_SIZE bytes to write
+ * sector - physical sector
+ *
+ * RETURNS
+ *
+ * error code or zero if successful
+ *
+ ***************************************************************************/
+unsigned char fn_writesector ( const void * buf, unsigned long sector )
+{
+  unsigned char  ret;
+
+  ret = _f_getvolume();
+  if ( ret )
+  {
+    return ret;
+  }
+
+  if ( sector == gl_volume.actsector )
+  {
+    gl_volume.actsector = (unsigned long)-1; /*cached copy is stale*/
+  }
+
+  if ( mdrv->writesector( mdrv, (void *)buf, sector ) )
+  {
+    return F_ERR_WRITE;
+  }
+
+  return F_NO_ERROR;
+} /* fn_writesector */
+
+
 /****************************************************************************
  *
  * fn_read
@@ -58,6 +58,8 @@ extern "C" {
 #define F_FILE_WRP   0x10
 #define F_FILE_AP    0x20
 
+unsigned char _f_syncvolume ( void );
+
 #ifdef __cplusplus
 }
 #endif
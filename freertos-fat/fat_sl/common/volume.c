@@ -540,6 +540,7 @@ unsigned char fn_hardformat ( unsigned char fattype )
   }
 
   gl_volume.state = F_STATE_NEEDMOUNT;
+  gl_volume.syncpending = 0;
 
   psp_memset( &phy, 0, sizeof( F_PHY ) );
 
@@ -737,6 +738,7 @@ unsigned char _f_getvolume ( void )
     {
       gl_file.modified = 0;
       gl_volume.modified = 0;
+      gl_volume.syncpending = 0; /*deferred entry belongs to the previous media*/
       gl_volume.lastalloccluster = 0;
       gl_volume.actsector = (unsigned long)( -1 );
       gl_volume.fatsector = (unsigned long)( -1 );
@@ -757,6 +759,9 @@ unsigned char _f_getvolume ( void )
 
       if ( !_f_readbootrecord() )
       {
+#if F_FAT_MIRROR_LAZY
+        _f_resetfatmirror();
+#endif
         gl_volume.state = F_STATE_WORKING;
         return F_NO_ERROR;
       }
@@ -971,10 +976,19 @@ unsigned char fn_initvolume ( F_DRIVERINIT initfunc )
  ***************************************************************************/
 unsigned char fn_delvolume ( void )
 {
+  unsigned char  ret = F_NO_ERROR;
+
+  /*write any deferred directory entry even with a file still open, as
+    nothing would write it after release*/
+  if ( gl_volume.state == F_STATE_WORKING )
+  {
+    ret = _f_syncvolume();
+  }
+
   if ( mdrv->release )
   {
     (void)mdrv->release( mdrv );
   }
 
-  return 0;
+  return ret;
 }
@@ -88,6 +88,18 @@ typedef struct
   char           cwd[F_MAXPATH]; /*current working folder in this volume*/
   unsigned char  mediatype;
   unsigned long  maxcluster;
+
+  unsigned char  syncpending;      /*directory entry update is deferred*/
+  unsigned long  syncsector;       /*directory sector of the deferred entry*/
+  unsigned long  syncpos;          /*entry index in the directory sector*/
+  unsigned long  syncstartcluster; /*start cluster to be recorded*/
+  unsigned long  syncfilesize;     /*file size to be recorded*/
+  unsigned long  synctime;         /*time of the last directory entry update*/
+
+#if F_FAT_MIRROR_LAZY
+  unsigned long  mirrorgroup;      /*FAT sectors covered by one bit of mirrormap*/
+  unsigned char  mirrormap[( F_FAT_MIRROR_MAP_BITS + 7 ) / 8]; /*FAT sectors not yet copied to the mirrors*/
+#endif
 } F_VOLUME;
 
 
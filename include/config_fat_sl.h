@@ -63,6 +63,55 @@ extern "C" {
 #define F_MAXPATH               64    /* Maximum length a file name (including its full path) can be. */
 #define F_MAX_LOCK_WAIT_TICKS   20    /* The maximum number of RTOS ticks to wait when attempting to obtain a lock on the file system when F_FS_THREAD_AWARE is set to 1. */
 
+/**************************************************************************
+**
+**  Durability policy for directory entry updates
+**
+**  Closing or flushing a file normally rewrites its directory sector to
+**  record the new size and start cluster. With a deferred policy the update
+**  is kept in memory (one entry) and written by f_sync(), at unmount (even
+**  with a file open), when another file's entry has to be updated, or when
+**  anything else rewrites the same directory sector. Reads of the directory always see the pending
+**  values, so f_open(), f_filelength() and f_findfirst() stay consistent.
+**
+**  Crash-loss window: data written since the last directory update is still
+**  on the card and chained in the FAT, but the directory entry holds the old
+**  size. After a power loss the file reverts to that size and any clusters
+**  allocated for a new file since then are orphaned until the card is
+**  checked. With F_SYNC_PERIODIC a close writes the entry once it is
+**  F_SYNC_PERIOD_MS old, and with F_SYNC_EXPLICIT only f_sync() does. The
+**  camera task calls f_sync() every F_SYNC_PERIOD_MS, which bounds the
+**  window under either policy when no file is left open.
+**
+**************************************************************************/
+#define F_SYNC_ON_CLOSE         0     /* Update the directory entry on every close and flush. */
+#define F_SYNC_PERIODIC         1     /* Update it on the first close after F_SYNC_PERIOD_MS has elapsed. */
+#define F_SYNC_EXPLICIT         2     /* Update it only from f_sync() or unmount. */
+
+#define F_SYNC_POLICY           F_SYNC_PERIODIC
+#define F_SYNC_PERIOD_MS        60000 /* Maximum age of a deferred directory entry when F_SYNC_POLICY is F_SYNC_PERIODIC. */
+
+/**************************************************************************
+**
+**  Lazy FAT mirroring
+**
+**  With F_FAT_MIRROR_LAZY set, allocating or freeing clusters writes only
+**  the first FAT. Modified FAT sectors are tracked in a dirty map and copied
+**  to the remaining FATs by f_sync(), at unmount, and together with the
+**  periodic directory entry update. FAT1 is authoritative; a stale mirror is
+**  never used as a read fallback. After a power loss the mirrors may differ
+**  from FAT1 in the sectors modified since the last f_sync().
+**
+**************************************************************************/
+#define F_FAT_MIRROR_LAZY       1     /* Set to one to defer writing FAT mirror copies. */
+#define F_FAT_MIRROR_MAP_BITS   256   /* Resolution of the dirty map; each bit covers an equal group of FAT sectors. */
+
+#if F_SYNC_POLICY == F_SYNC_PERIODIC
+#include "FreeRTOS.h"
+#include "task.h"
+#define F_SYNC_GETMS()          ( (unsigned long)xTaskGetTickCount() * portTICK_PERIOD_MS )
+#endif
+
 #ifdef __cplusplus
 }
 #endif
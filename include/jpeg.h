@@ -0,0 +1,120 @@
+/**
+ * Methods for locating structure in a JPEG byte stream as it is read out.
+ */
+#ifndef _JPEG_H_
+#define _JPEG_H_
+
+#include <stm32f4xx.h>
+#include <stm32f4xx_hal_conf.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* JPEG markers. */
+#define JPEG_MARKER 0xFF
+#define JPEG_SOF0   0xC0
+#define JPEG_SOF1   0xC1
+#define JPEG_DHT    0xC4
+#define JPEG_RST0   0xD0
+#define JPEG_RST7   0xD7
+#define JPEG_SOI    0xD8
+#define JPEG_EOI    0xD9
+#define JPEG_SOS    0xDA
+#define JPEG_DQT    0xDB
+#define JPEG_DRI    0xDD
+#define JPEG_APP0   0xE0
+
+/* Cells per side of the scene signature grid. */
+#define JPEG_SIGNATURE_GRID  8
+#define JPEG_SIGNATURE_CELLS (JPEG_SIGNATURE_GRID * JPEG_SIGNATURE_GRID)
+
+/* Entropy coded bytes held back between calls to jpeg_dc_decode(). An MCU
+   is only decoded once this much data is available. */
+#define JPEG_CARRY_LENGTH 512
+
+/* Widest thumbnail, at one pixel per luma block, and the most thumbnail
+   rows in an MCU row. A 2592 pixel wide frame gives 324 pixels. */
+#define JPEG_THUMBNAIL_WIDTH 324
+#define JPEG_THUMBNAIL_ROWS  2
+
+/* Decoder states. */
+#define JPEG_DC_FAILED   0
+#define JPEG_DC_DECODING 1
+#define JPEG_DC_DONE     2
+
+/* State carried between calls to jpeg_find_eoi(). */
+typedef struct _JpegScanner {
+	uint8_t Pending;           /* Previous buffer ended with 0xFF */
+} JpegScanner;
+
+/* Canonical Huffman table, decoded as in ITU T.81 F.2.2.3. */
+typedef struct _JpegHuffman {
+	int32_t MaxCode[17];       /* Largest code of each length, or -1 */
+	uint16_t MinCode[17];      /* Smallest code of each length */
+	uint8_t ValuePointer[17];  /* Index in Values of the smallest code */
+	uint8_t Values[256];
+} JpegHuffman;
+
+typedef struct _JpegComponent {
+	uint8_t Id;
+	uint8_t H;                 /* Horizontal sampling factor */
+	uint8_t V;                 /* Vertical sampling factor */
+	uint8_t QuantTable;
+	uint8_t DcTable;
+	uint8_t AcTable;
+	int16_t Predictor;         /* DC value of the previous block */
+} JpegComponent;
+
+/* Receives each row of the thumbnail as it is decoded. */
+typedef void (*JpegRowOutput)(void* context, const uint8_t* row, uint16_t width);
+
+/**
+ * Huffman decoder for the DC coefficients of a baseline JPEG. AC
+ * coefficients are decoded only to skip them; there is no IDCT.
+ */
+typedef struct _JpegDcDecoder {
+	JpegHuffman Dc[2];
+	JpegHuffman Ac[2];
+	uint16_t QuantDc[4];       /* DC quantiser of each table */
+	JpegComponent Components[3];
+	uint8_t ComponentCount;
+	uint8_t State;
+	uint16_t McusX;
+	uint16_t McusY;
+	uint16_t RestartInterval;  /* MCUs between RST markers, or 0 */
+	uint32_t Mcu;              /* Next MCU to decode */
+	uint32_t Bits;             /* Bits not yet used, MSB first */
+	uint8_t BitCount;
+	uint8_t Marker;            /* A marker stops the entropy coded data */
+	const uint8_t* Data;       /* Buffer passed to jpeg_dc_decode() */
+	uint32_t DataLength;
+	uint32_t DataPosition;
+	uint16_t CarryLength;
+	uint16_t CarryPosition;
+	uint8_t Carry[JPEG_CARRY_LENGTH];
+	int32_t Sums[JPEG_SIGNATURE_CELLS];   /* Luma DC of the blocks in each cell */
+	uint16_t Counts[JPEG_SIGNATURE_CELLS];
+	uint16_t ThumbnailWidth;   /* 0 if the image is too wide for a thumbnail */
+	uint16_t ThumbnailHeight;
+	uint16_t ThumbnailRow;     /* Next thumbnail row to output */
+	JpegRowOutput RowOutput;   /* Set after jpeg_dc_begin() to get the thumbnail */
+	void* RowContext;
+	uint8_t Rows[JPEG_THUMBNAIL_ROWS][JPEG_THUMBNAIL_WIDTH];
+} JpegDcDecoder;
+
+uint8_t jpeg_check_soi(const uint8_t* buffer, uint32_t length);
+uint32_t jpeg_header_length(const uint8_t* buffer, uint32_t length);
+uint32_t jpeg_segment(uint8_t* buffer, uint8_t marker, uint16_t length);
+uint32_t jpeg_find_eoi(JpegScanner* scanner, const uint8_t* buffer, uint32_t length);
+uint32_t jpeg_find_soi(JpegScanner* scanner, const uint8_t* buffer, uint32_t length);
+uint32_t jpeg_dc_begin(JpegDcDecoder* decoder, const uint8_t* buffer, uint32_t length);
+void jpeg_dc_decode(JpegDcDecoder* decoder, const uint8_t* buffer, uint32_t length, uint8_t last);
+uint8_t jpeg_dc_signature(JpegDcDecoder* decoder, uint8_t* signature);
+uint8_t jpeg_signature_compare(const uint8_t* a, const uint8_t* b, uint8_t threshold);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _JPEG_H_ */
@@ -35,6 +35,7 @@ extern "C" {
 
 #define OV5642_CHIP_ID_HIGH_BYTE 0x300A
 #define OV5642_CHIP_ID_LOW_BYTE  0x300B
+#define OV5642_QSCALE            0x4407
 
 /* Register constants */
 #define ARDUCHIP_5MP             0x41
@@ -52,29 +53,79 @@ extern "C" {
 #define STATUS_FIFO_DONE_MASK    0x08
 
 /* Register access macros */
-#define CCR_FRAMES(n) (n & 0x3)
+#define CCR_FRAMES(n) (((n) - 1) & 0x7)
+
+/* Most frames captured on one trigger. A frame count field of 7 means
+   capture until the FIFO is full. */
+#define ARDUCAM_MAX_FRAMES       7
+
+/* Capture profiles, from the largest images to the smallest. */
+typedef enum {
+	OV5642_PROFILE_1080P,
+	OV5642_PROFILE_1080P_LOW,
+	OV5642_PROFILE_VGA,
+	OV5642_PROFILE_QVGA,
+	OV5642_PROFILE_COUNT,
+	OV5642_PROFILE_NONE = 0xFF
+} OV5642_Profile;
+
+#define OV5642_PROFILE_DEFAULT   OV5642_PROFILE_1080P
+#define OV5642_PROFILE_REGISTERS 19
+
+/* Indexes of 16-bit fields and OV5642_QSCALE in the profile registers */
+#define OV5642_PROFILE_WINDOW_X  1
+#define OV5642_PROFILE_WINDOW_Y  3
+#define OV5642_PROFILE_WINDOW_W  5
+#define OV5642_PROFILE_WINDOW_H  7
+#define OV5642_PROFILE_OUTPUT_W  9
+#define OV5642_PROFILE_OUTPUT_H  11
+#define OV5642_PROFILE_QSCALE    14
+#define OV5642_PROFILE_AVERAGE_W 15
+#define OV5642_PROFILE_AVERAGE_H 17
+
+/* Region of the field to capture, in percent of the full frame. */
+typedef struct _OV5642_Window {
+	uint8_t Left;
+	uint8_t Top;
+	uint8_t Width;
+	uint8_t Height;
+} OV5642_Window;
+
+/* JPEG quantisation scale limits */
+#define OV5642_QSCALE_MIN        0x02
+#define OV5642_QSCALE_MAX        0x3F
 
 /* ArduChip API */
 uint8_t arducam_chip();
 uint8_t arducam_init();
 Devices_StatusTypeDef arducam_setup();
 Devices_StatusTypeDef arducam_start_capture();
+Devices_StatusTypeDef arducam_set_frames(uint8_t frames);
 Devices_StatusTypeDef arducam_low_power_set();
 Devices_StatusTypeDef arducam_low_power_remove();
+Devices_StatusTypeDef arducam_capture_done(uint8_t* done);
+Devices_StatusTypeDef arducam_capture_length(uint32_t* capture_length);
 Devices_StatusTypeDef arducam_wait_capture(uint32_t* capture_length);
 Devices_StatusTypeDef arducam_read_capture(uint8_t* buffer, uint16_t length);
 Devices_StatusTypeDef arducam_burst_read(uint8_t* buffer, uint16_t length);
+Devices_StatusTypeDef arducam_fifo_rewind();
 
 
 /* CMOS sensor API */
 uint16_t ov5642_chip();
 uint8_t ov5642_init();
 Devices_StatusTypeDef ov5642_setup();
+Devices_StatusTypeDef ov5642_set_profile(OV5642_Profile profile);
+OV5642_Profile ov5642_get_profile();
+Devices_StatusTypeDef ov5642_set_qscale(uint8_t qscale);
+uint8_t ov5642_get_qscale();
+Devices_StatusTypeDef ov5642_set_window(const OV5642_Window* window);
 
 /* OV5642 register configuration arrays */
-extern RegisterTuple16_8 ov5642_dvp_fmt_global_init[];
-extern RegisterTuple16_8 ov5642_dvp_fmt_jpeg_qvga[];
-extern RegisterTuple16_8 ov5642_res_1080P[];
+extern const uint8_t ov5642_dvp_fmt_global_init[];
+extern const uint8_t ov5642_dvp_fmt_jpeg_qvga[];
+extern const uint16_t ov5642_profile_registers[OV5642_PROFILE_REGISTERS];
+extern const uint8_t ov5642_profiles[OV5642_PROFILE_COUNT][OV5642_PROFILE_REGISTERS];
 
 #ifdef __cplusplus
 }
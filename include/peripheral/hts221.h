@@ -22,6 +22,8 @@ extern "C" {
 #define HTS221_WHO_AM_I        0x0F
 #define HTS221_AV_CONF         0x10
 #define HTS221_CTRL_REG_1      0x20
+#define HTS221_CTRL_REG_2      0x21
+#define HTS221_CTRL_REG_3      0x22
 #define HTS221_HUMIDITY_OUT_L  0x28
 #define HTS221_HUMIDITY_OUT_H  0x29
 #define HTS221_TEMP_OUT_L      0x2A
@@ -32,6 +34,12 @@ extern "C" {
 /* Contents of the WHO_AM_I register */
 #define HTS221_WHO_I_AM        0xBC
 
+/* DRDY output, wired to an EXTI line. It goes high when a conversion is
+   ready and low once the output registers are read. */
+#define HTS221_DRDY_PORT       GPIOA
+#define HTS221_DRDY_PIN        GPIO_PIN_1
+#define HTS221_DRDY_IRQn       EXTI1_IRQn
+
 typedef struct __HTS221_ResConfTypeDef {
 	uint8_t AverageHumidity;
 	uint8_t AverageTemperature;
@@ -72,20 +80,36 @@ typedef struct __HTS221_CtrlReg1TypeDef {
 #define HTS221_RATE_7Hz        0x02
 #define HTS221_RATE_12_5Hz     0x03
 
+/* CTRL_REG2: start a conversion in HTS221_ONE_SHOT mode. */
+#define HTS221_ONE_SHOT_START  0x01
+
+/* CTRL_REG3: data ready signal on the DRDY pin. */
+#define HTS221_DRDY_ENABLE     0x04
+
+/* Raw output registers, HUMIDITY_OUT_L to TEMP_OUT_H in one read. */
+typedef struct __HTS221_SampleTypeDef {
+	int16_t Humidity;
+	int16_t Temperature;
+} HTS221_SampleTypeDef;
+
+/* Linear conversion of one output register: the reading at count Zero is
+   Offset, and each count adds Slope. Offset and Slope are Q16 hundredths
+   of the unit. */
+typedef struct __HTS221_ConversionTypeDef {
+	int32_t Offset;
+	int32_t Slope;
+	int16_t Zero;
+} HTS221_ConversionTypeDef;
+
 typedef struct __HTS221_CalibTypeDef {
-	float H0_rH;
-	float H1_rH;
-	float T0_degC;
-	float T1_degC;
-	int16_t H0_T0_OUT;
-	int16_t H1_T0_OUT;
-	int16_t T0_OUT;
-	int16_t T1_OUT;
+	HTS221_ConversionTypeDef Temperature;  /* To centi-degC */
+	HTS221_ConversionTypeDef Humidity;     /* To centi-%rH */
 } HTS221_CalibTypeDef;
 
 /**
  * Calibration values stored on the sensor
  * These are required to interpolate the sensor readings into physical units.
+ * The interpolation is worked out once, when the calibration is read.
  */
 extern HTS221_CalibTypeDef hts221_calib;
 
@@ -95,10 +119,14 @@ uint8_t hts221_ready();
 Devices_StatusTypeDef hts221_read_calib(HTS221_CalibTypeDef* calib);
 Devices_StatusTypeDef hts221_res_conf(HTS221_ResConfTypeDef* config);
 Devices_StatusTypeDef hts221_setup(HTS221_CtrlReg1TypeDef* config);
+Devices_StatusTypeDef hts221_start();
 int16_t hts221_read_temp();
 int16_t hts221_read_hum();
 float hts221_read_temp_C();
 float hts221_read_hum_rel();
+Devices_StatusTypeDef hts221_read_sample(HTS221_SampleTypeDef* sample);
+int16_t hts221_temp_cC(int16_t temp);
+int16_t hts221_hum_crH(int16_t hum);
 
 #ifndef I2C_AAI
 /**
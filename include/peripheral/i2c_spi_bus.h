@@ -51,6 +51,21 @@ typedef struct {
 	uint8_t value;
 } RegisterTuple16_8;
 
+/**
+ * Register tables for i2c_runs16_8() are byte arrays of runs. Each run is
+ * REGISTER_RUN16(address, count) followed by count 8-bit values for
+ * consecutive 16-bit addresses, and the table ends with REGISTER_END.
+ * The count comes first so the address and values can be sent as one
+ * auto-increment write straight from the table.
+ */
+#define REGISTER_RUN16(address, count) (count), ((address) >> 8), ((address) & 0xFF)
+#define REGISTER_END 0x00
+
+/* I2C clock speeds. Devices run at I2C_CLOCK_DEFAULT unless set otherwise
+   with i2c_device_speed(). */
+#define I2C_CLOCK_DEFAULT 30000
+#define I2C_CLOCK_FAST    400000
+
 /* SPI functions */
 uint8_t spi_take();
 void spi_give();
@@ -62,11 +77,13 @@ Devices_StatusTypeDef spi_write8_8(SPI_HandleTypeDef* hspi, uint8_t address, uin
 
 /* I2C functions */
 void i2c_bus_init();
+Devices_StatusTypeDef i2c_device_speed(uint8_t device, uint32_t clockSpeed);
 Devices_StatusTypeDef i2c_read8(uint8_t device, uint8_t address, uint8_t* data, uint8_t length);
 Devices_StatusTypeDef i2c_read16(uint8_t device, uint16_t address, uint8_t* data, uint8_t length);
 Devices_StatusTypeDef i2c_write8_8(uint8_t device, uint8_t address, uint8_t data);
 Devices_StatusTypeDef i2c_write16_8(uint8_t device, uint16_t address, uint8_t data);
 Devices_StatusTypeDef i2c_array16_8(uint8_t device, RegisterTuple16_8* array);
+Devices_StatusTypeDef i2c_runs16_8(uint8_t device, const uint8_t* table);
 
 #ifdef __cplusplus
 }
@@ -21,6 +21,8 @@ extern "C" {
 #define LPS331_WHO_AM_I        0x0F
 #define LPS331_RES_CONF        0x10
 #define LPS331_CTRL_REG_1      0x20
+#define LPS331_CTRL_REG_2      0x21
+#define LPS331_CTRL_REG_3      0x22
 #define LPS331_PRESS_OUT_XL    0x28
 #define LPS331_PRESS_OUT_L     0x29
 #define LPS331_PRESS_OUT_H     0x2A
@@ -30,6 +32,12 @@ extern "C" {
 /* Contents of the WHO_AM_I register */
 #define LPS331_WHO_I_AM        0xBB
 
+/* INT1 output, wired to an EXTI line. It goes high when a conversion is
+   ready and low once the output registers are read. */
+#define LPS331_DRDY_PORT       GPIOA
+#define LPS331_DRDY_PIN        GPIO_PIN_0
+#define LPS331_DRDY_IRQn       EXTI0_IRQn
+
 typedef struct {
 	uint8_t AveragePressure;
 	uint8_t AverageTemperature;
@@ -89,14 +97,36 @@ typedef struct __LPS331_CtrlReg1TypeDef {
 #define LPS331_SPI_MODE_4WIRE  0x00
 #define LPS331_SPI_MODE_3WIRE  0x01
 
+/* CTRL_REG2: start a conversion in LPS331_ONE_SHOT mode. */
+#define LPS331_ONE_SHOT_START  0x01
+
+/* CTRL_REG3: data ready signal on INT1. */
+#define LPS331_INT1_DRDY       0x04
+
+/* Output scales: 480 counts per degC from 42.5 degC, and 4096 counts per
+   mbar. Temperature is converted to centi-degC with a Q16 slope, and
+   pressure to Pa, which is 100/4096 = 25/1024 of a count. */
+#define LPS331_TEMP_OFFSET_cC  4250
+#define LPS331_TEMP_SLOPE_Q16  ((100 << 16) / 480)
+
+/* Raw output registers, PRESS_OUT_XL to TEMP_OUT_H in one read. */
+typedef struct __LPS331_SampleTypeDef {
+	int32_t Pressure;
+	int16_t Temperature;
+} LPS331_SampleTypeDef;
+
 uint8_t lps331_who_am_i();
 uint8_t lps331_init();
 Devices_StatusTypeDef lps331_res_conf(LPS331_ResConfTypeDef* config);
 Devices_StatusTypeDef lps331_setup(LPS331_CtrlReg1TypeDef* config);
+Devices_StatusTypeDef lps331_start();
 int16_t lps331_read_temp();
 int32_t lps331_read_pres();
 float lps331_read_temp_C();
 float lps331_read_pres_mbar();
+Devices_StatusTypeDef lps331_read_sample(LPS331_SampleTypeDef* sample);
+int16_t lps331_temp_cC(int16_t value);
+int32_t lps331_pres_Pa(int32_t value);
 
 #ifndef I2C_AAI
 /**
@@ -0,0 +1,156 @@
+/**
+ * Circular record log kept in a preallocated file on the SD card.
+ *
+ * The container file is created once at its full size and never resized.
+ * Its sectors are located with f_getextents() and then accessed directly,
+ * so appending and reclaiming records are plain sector writes that never
+ * touch the directory entry or the FAT.
+ *
+ * Layout, in sectors of the container file:
+ *   0, 1  checkpoint A and B, written alternately
+ *   2..   time index, one RingIndexEntry per RLOG_INDEX_BLOCK of data
+ *   ..    data area, used as a circular byte stream of records
+ *
+ * Each record is a RingRecordHeader followed by its payload. Headers are
+ * 4-byte aligned and never straddle a sector; the writer pads to the next
+ * sector instead. Records started with rlog_begin_aligned() are padded so
+ * the payload lines up with the sectors, and readers skip the zero
+ * padding. A record is valid when its magic, sequence number and CRC-32
+ * match, so after a reset the head is recovered by scanning forward from
+ * the last checkpoint. The tail only moves in rlog_consume(), which also
+ * writes a checkpoint.
+ *
+ * The time index is a slot per block of the data area, naming the record
+ * that covers the first byte of the block. Slots are filled as the head
+ * passes each block, so they are in sequence order around the ring and
+ * rlog_seek() can binary search them. Records that have been consumed but
+ * not yet overwritten can still be found this way, and rlog_rewind() moves
+ * the tail back to them to have them read again. An aborted record clears
+ * the slots it filled, as they lie past the head once it is rolled back.
+ *
+ * The log does no locking of its own. Callers hold the SPI bus with
+ * spi_take() around every call, which also serialises the writer and
+ * reader tasks.
+ */
+
+#ifndef _RING_LOG_H_
+#define _RING_LOG_H_
+
+#include <stm32f4xx.h>
+#include <stm32f4xx_hal_conf.h>
+
+#include <fat_sl.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Error codes for API functions. */
+#define RLOG_OK      0
+#define RLOG_ERROR   1
+#define RLOG_FULL    2
+#define RLOG_EMPTY   3
+
+/* Record types. */
+#define RLOG_TYPE_SAMPLE 0x01      /* A packed block of samples, or SampleRecords */
+#define RLOG_TYPE_JPEG   0x02
+#define RLOG_TYPE_SAME   0x03      /* A frame matching a stored image */
+#define RLOG_TYPE_THUMB  0x04      /* 1/8 scale PGM of a stored image */
+
+/* Record flags. */
+#define RLOG_FLAG_ALIGNED 0x01     /* Payload lined up with the sectors */
+
+/* Maximum number of fragments the container file may be split into. */
+#define RLOG_MAX_EXTENTS 8
+
+/* Data area bytes covered by each time index slot (a multiple of 512). */
+#define RLOG_INDEX_BLOCK 4096
+
+/* Header stored in front of every record payload. */
+typedef struct __attribute__((packed)) _RingRecordHeader {
+	uint16_t Magic;
+	uint8_t Type;
+	uint8_t Flags;
+	uint32_t Sequence;
+	uint32_t TickCount;
+	uint32_t Length;
+	uint32_t Crc;
+} RingRecordHeader;
+
+/* A record located by rlog_next(). */
+typedef struct _RingRecord {
+	RingRecordHeader Header;
+	uint32_t Offset;           /* Data area offset of the payload */
+} RingRecord;
+
+/* Position of a record in the log. */
+typedef struct _RingCursor {
+	uint32_t Offset;
+	uint32_t Sequence;
+} RingCursor;
+
+/* Time index slot. */
+typedef struct _RingIndexEntry {
+	uint32_t TickCount;
+	uint32_t Offset;           /* Data area offset of the record header */
+	uint32_t Sequence;
+} RingIndexEntry;
+
+typedef struct _RingLog {
+	F_EXTENT Extents[RLOG_MAX_EXTENTS];
+	uint8_t ExtentCount;
+	uint8_t Mounted;
+	uint8_t Writing;           /* A record is open for rlog_write() */
+	uint8_t IndexDirty;        /* IndexBuffer differs from the card */
+	uint32_t DataSector;       /* First sector of the data area */
+	uint32_t Capacity;         /* Size of the data area in bytes */
+	uint32_t IndexSlots;       /* Number of time index slots */
+	uint32_t Generation;       /* Number of checkpoints written */
+	uint32_t Head;             /* Offset where the next byte is written */
+	uint32_t HeadSequence;     /* Sequence number of the next record */
+	uint32_t Tail;             /* Offset of the oldest record */
+	uint32_t TailSequence;     /* Sequence number of the oldest record */
+	uint32_t Start;            /* Head when the open record was begun */
+	uint32_t Record;           /* Offset of the open record header */
+	uint32_t RecordCrc;        /* Running CRC of the open record */
+	RingRecordHeader Open;     /* Header of the open record */
+	RingIndexEntry Current;    /* Index slot for blocks the head enters */
+	uint32_t BufferSector;     /* Data area sector held in Buffer */
+	uint32_t ScratchSector;    /* Container sector held in Scratch */
+	uint32_t IndexSector;      /* Container sector held in IndexBuffer */
+	uint8_t Buffer[F_SECTOR_SIZE];  /* Head sector, not yet complete */
+	uint8_t Scratch[F_SECTOR_SIZE]; /* Read and read-modify-write buffer */
+	uint8_t IndexBuffer[F_SECTOR_SIZE]; /* Time index sector being filled */
+} RingLog;
+
+/* Container API */
+uint8_t rlog_open(RingLog* log, const char* name, uint32_t sectors);
+uint8_t rlog_reset(RingLog* log);
+uint8_t rlog_checkpoint(RingLog* log);
+uint8_t rlog_flush(RingLog* log);
+uint32_t rlog_used(RingLog* log);
+
+/* Writer API */
+uint8_t rlog_begin(RingLog* log, uint8_t type, uint32_t tickCount);
+uint8_t rlog_begin_aligned(RingLog* log, uint8_t type, uint32_t tickCount, uint32_t lead);
+uint8_t rlog_write(RingLog* log, const void* data, uint32_t length);
+uint8_t rlog_end(RingLog* log);
+uint8_t rlog_abort(RingLog* log);
+uint8_t rlog_append(RingLog* log, uint8_t type, uint32_t tickCount, const void* data, uint32_t length);
+
+/* Reader API */
+void rlog_cursor(RingLog* log, RingCursor* cursor);
+uint8_t rlog_next(RingLog* log, RingCursor* cursor, RingRecord* record);
+uint8_t rlog_read(RingLog* log, RingRecord* record, uint32_t offset, void* data, uint32_t length);
+uint8_t rlog_consume(RingLog* log, RingCursor* cursor);
+uint8_t rlog_seek(RingLog* log, uint32_t tickCount, RingCursor* cursor);
+uint8_t rlog_rewind(RingLog* log, uint32_t tickCount);
+
+/* CRC-32 as used by the log, also used for the records inside it. */
+uint32_t rlog_crc32(uint32_t crc, const void* data, uint32_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _RING_LOG_H_ */
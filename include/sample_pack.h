@@ -0,0 +1,83 @@
+/**
+ * Compression of sample batches, after the Gorilla time series encoding.
+ *
+ * A packed block starts with a 4-byte header and ends with a CRC-32 (as
+ * zlib) of everything before it:
+ *   0     SAMPLE_PACK_VERSION, so blocks and SampleRecords can share a
+ *         stream and be told apart by their first byte
+ *   1     number of samples
+ *   2, 3  length of the whole block, little endian
+ *   4..   bit stream, most significant bit first, zero padded to a byte
+ *
+ * Each sample in the bit stream is:
+ *   tick      delta of delta of TickCount, so samples at a steady rate
+ *             cost one bit
+ *   missing   0 if the same channels are missing as in the last sample,
+ *             else 1 and the 4 SAMPLE_MISSING_* bits
+ *   values    for each channel that is present, in the order of
+ *             SampleRecord, the change since that channel's last value
+ *
+ * Signed numbers are zigzag coded and stored in the first of four widths
+ * that holds them, behind a prefix of 0, 10, 110, 1110 or 1111; the last
+ * is a full 32 bits. The first sample is coded against a state of zeros.
+ * The readings are fixed point, so the changes are exact integers and
+ * there is no need for the XOR coding Gorilla uses for floats.
+ *
+ * The encoder keeps the last sample and the last tick delta, and nothing
+ * else, so samples are added one at a time into a buffer of the caller's.
+ */
+
+#ifndef _SAMPLE_PACK_H_
+#define _SAMPLE_PACK_H_
+
+#include <stm32f4xx.h>
+#include <stm32f4xx_hal_conf.h>
+
+#include <sample_ring.h>
+#include <sample_record.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Follows SAMPLE_RECORD_VERSION. */
+#define SAMPLE_PACK_VERSION 2
+
+/* Error codes for API functions. */
+#define SAMPLE_PACK_OK   0
+#define SAMPLE_PACK_FULL 1
+
+/* Channels coded for each sample. */
+#define SAMPLE_PACK_CHANNELS 4
+
+/* Widths of the first three sizes of tick and value codes. */
+#define SAMPLE_PACK_TICK_WIDTHS  7, 9, 12
+#define SAMPLE_PACK_VALUE_WIDTHS 4, 8, 16
+
+/* Header and CRC bytes, and the most bytes one sample can take:
+   1 + 4 bits of missing, and 4 + 32 bits for the tick and each value. */
+#define SAMPLE_PACK_OVERHEAD   8
+#define SAMPLE_PACK_MAX_SAMPLE 24
+#define SAMPLE_PACK_LENGTH(count) (SAMPLE_PACK_OVERHEAD + (count) * SAMPLE_PACK_MAX_SAMPLE)
+
+typedef struct _SamplePack {
+	uint8_t* Buffer;
+	uint16_t Capacity;
+	uint16_t Length;           /* Whole bytes written, header included */
+	uint8_t BitCount;          /* Bits used in Buffer[Length] */
+	uint8_t Count;
+	uint8_t Missing;           /* SAMPLE_MISSING_* bits of the last sample */
+	uint32_t Tick;
+	uint32_t TickDelta;
+	int32_t Values[SAMPLE_PACK_CHANNELS];
+} SamplePack;
+
+void sample_pack_begin(SamplePack* pack, uint8_t* buffer, uint16_t capacity);
+uint8_t sample_pack_add(SamplePack* pack, const Sample* sample);
+uint16_t sample_pack_end(SamplePack* pack);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SAMPLE_PACK_H_ */
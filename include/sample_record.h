@@ -0,0 +1,54 @@
+/**
+ * Fixed layout binary form of a sample, as stored in the data log and
+ * uploaded to the server.
+ *
+ * Records are little endian and 20 bytes long, with every field on its
+ * natural alignment. Version comes first so a reader can tell the layout
+ * before it trusts the rest. Crc is the CRC-32 (as zlib) of the 16 bytes
+ * before it. A channel that could not be read has its bit set in Missing
+ * and its value left as 0.
+ *
+ * The data log keeps a batch of records, back to back, in each
+ * RLOG_TYPE_SAMPLE record. tools/sample_decode.py turns them back into
+ * the DATA:{...} lines the server used to receive.
+ */
+
+#ifndef _SAMPLE_RECORD_H_
+#define _SAMPLE_RECORD_H_
+
+#include <stm32f4xx.h>
+#include <stm32f4xx_hal_conf.h>
+
+#include <sample_ring.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Layout version. Any change to SampleRecord needs a new one. */
+#define SAMPLE_RECORD_VERSION 1
+
+/* Bits of Missing. */
+#define SAMPLE_MISSING_LPS331_TEMP 0x01
+#define SAMPLE_MISSING_LPS331_PRES 0x02
+#define SAMPLE_MISSING_HTS221_TEMP 0x04
+#define SAMPLE_MISSING_HTS221_HUM  0x08
+
+typedef struct __attribute__((packed)) _SampleRecord {
+	uint8_t Version;
+	uint8_t Missing;
+	int16_t LPS331Temperature;  /* Hundredths of a degC */
+	uint32_t TickCount;
+	int32_t LPS331Pressure;     /* Pa */
+	int16_t HTS221Temperature;  /* Hundredths of a degC */
+	int16_t HTS221Humidity;     /* Hundredths of a %rH */
+	uint32_t Crc;
+} SampleRecord;
+
+void sample_record_encode(SampleRecord* record, const Sample* sample);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SAMPLE_RECORD_H_ */
@@ -0,0 +1,93 @@
+/**
+ * Ring of sensor samples passed from one producer task to one consumer
+ * task without locks.
+ *
+ * Head and Tail count samples put and taken since the ring was set up, and
+ * wrap at 2^32. Only the producer writes Head and only the consumer writes
+ * Tail, so each side reads the other's index and never needs a critical
+ * section. A sample is copied into its slot before Head is advanced past
+ * it, with a barrier between, so the consumer never sees a half written
+ * sample. The capacity is a power of two so that the slot is the index
+ * masked, even as the indices wrap.
+ *
+ * When the ring is full the policy decides what happens:
+ *   SAMPLE_RING_OVERWRITE  the producer writes over the oldest sample. The
+ *                          consumer notices that it has been lapped and
+ *                          skips ahead. One slot is kept free for the
+ *                          sample being written, so the ring holds one
+ *                          less than its capacity.
+ *   SAMPLE_RING_DECIMATE   once the ring is SAMPLE_RING_HIGH_WATER full,
+ *                          only one sample in Decimation is kept, so the
+ *                          ring covers a longer time more thinly. Samples
+ *                          that arrive when it is full are dropped.
+ *   SAMPLE_RING_BLOCK      the producer waits for the consumer to make
+ *                          room, and drops the sample if it runs out of
+ *                          time.
+ *
+ * Dropped is only written by the producer and Overwritten only by the
+ * consumer.
+ */
+
+#ifndef _SAMPLE_RING_H_
+#define _SAMPLE_RING_H_
+
+#include <stm32f4xx.h>
+#include <stm32f4xx_hal_conf.h>
+
+#include "FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Error codes for API functions. */
+#define SAMPLE_RING_OK      0
+#define SAMPLE_RING_ERROR   1
+#define SAMPLE_RING_DROPPED 2
+
+/* Overflow policies. */
+#define SAMPLE_RING_OVERWRITE 0
+#define SAMPLE_RING_DECIMATE  1
+#define SAMPLE_RING_BLOCK     2
+
+/* Fill, in percent, at which SAMPLE_RING_DECIMATE starts thinning. */
+#define SAMPLE_RING_HIGH_WATER 75
+
+/* Interval at which a blocked producer checks for room. */
+#define SAMPLE_RING_POLL_MS 10
+
+/* A reading of the sensors. SAMPLE_NO_READING marks a value that could
+   not be read. */
+typedef struct _Sample {
+	TickType_t TickCount;
+	int32_t LPS331Pressure;     /* Pa */
+	int16_t LPS331Temperature;  /* Hundredths of a degC */
+	int16_t HTS221Temperature;  /* Hundredths of a degC */
+	int16_t HTS221Humidity;     /* Hundredths of a %rH */
+} Sample;
+
+#define SAMPLE_NO_READING INT16_MIN
+
+typedef struct _SampleRing {
+	Sample* Buffer;
+	uint32_t Capacity;         /* A power of two */
+	uint8_t Policy;
+	uint8_t Decimation;        /* SAMPLE_RING_DECIMATE keeps 1 in this many */
+	uint8_t Skipped;           /* Samples since the last one kept */
+	volatile uint32_t Head;    /* Samples put */
+	volatile uint32_t Tail;    /* Samples taken or skipped */
+	volatile uint32_t Dropped;
+	volatile uint32_t Overwritten;
+} SampleRing;
+
+uint8_t sample_ring_init(SampleRing* ring, Sample* buffer, uint32_t capacity, uint8_t policy, uint8_t decimation);
+uint8_t sample_ring_put(SampleRing* ring, const Sample* sample, TickType_t wait);
+uint32_t sample_ring_get(SampleRing* ring, Sample* samples, uint32_t count);
+uint32_t sample_ring_count(SampleRing* ring);
+uint8_t sample_ring_latest(SampleRing* ring, Sample* sample);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SAMPLE_RING_H_ */
@@ -13,36 +13,111 @@
 #include "FreeRTOS.h"
 #include "task.h"
 
+#include <ring_log.h>
+#include <task/sampler_task.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-typedef struct _Sample {
-	TickType_t TickCount;
-	float LPS331Temperature;
-	float LPS331Pressure;
-	float HTS221Temperature;
-	float HTS221Humidity;
-} Sample;
-
-typedef struct _SampleBuffer {
-	Sample Buffer[64];
-	uint8_t Count;
-} SampleBuffer;
+/* Deadline and timing statistics of a periodic activity. Lateness is the
+   time from the deadline to the start of the activity. */
+typedef struct _Activity {
+	TickType_t Deadline;
+	TickType_t Period;
+	uint32_t Runs;
+	uint32_t Overruns;         /* Whole periods skipped */
+	TickType_t MaxLateness;
+	uint32_t TotalLateness;
+} Activity;
 
 #define MIN(a,b) ((a)<(b)?(a):(b))
 
 #define CAMERA_TASK_NAME "CAMR"
 #define CAMERA_TASK_STACK_SIZE 2048
 
-#define SAMPLE_RATE_MS 5000
 #define IMAGE_RATE_MS 30000
 
-#define BURST_READ_LENGTH 128
+/* Samples moved from the sample ring to the data log in each record, and
+   the interval between flushes, which normally fills one record. */
+#define SAMPLE_FLUSH_BATCH 16
+#define SAMPLE_FLUSH_MS (SAMPLE_FLUSH_BATCH * SAMPLE_RATE_MS)
+
+/* Interval between checks on an image that is exposing or uploading. */
+#define CAPTURE_POLL_MS 100
+
+/* Interval between reports of the activity timing statistics. */
+#define SCHEDULE_REPORT_MS (10 * 60 * 1000)
+
+/* Frames captured one after another on each trigger, up to
+   ARDUCAM_MAX_FRAMES. Each frame is stored as its own image. */
+#define CAMERA_BURST_FRAMES 1
+
+/* Longest exposure before a capture is abandoned. */
+#define CAPTURE_TIMEOUT_MS 5000
+
+/* Time the Skywire task has to pick up an image before it is taken back
+   and stored on the SD card. */
+#define LIVE_CLAIM_MS 1000
+
+/* Region of the field to capture, in percent of the full frame. Narrow
+   this to the roadway band for the camera's mounting. */
+#define CAMERA_ROI_LEFT   0
+#define CAMERA_ROI_TOP    0
+#define CAMERA_ROI_WIDTH  100
+#define CAMERA_ROI_HEIGHT 100
+
+/* A frame is only stored when at least SCENE_CHANGE_CELLS cells of its
+   signature differ from the last stored image by more than
+   SCENE_CHANGE_LEVEL grey levels, after allowing for a change in overall
+   brightness. An image is stored at least every SCENE_KEYFRAME_MS. */
+#define SCENE_CHANGE_LEVEL 8
+#define SCENE_CHANGE_CELLS 2
+#define SCENE_KEYFRAME_MS (30 * 60 * 1000)
+
+/* JPEG size the quantisation scale is adjusted to hold, and the band
+   around it that is left alone. */
+#define IMAGE_TARGET_BYTES 40960
+#define IMAGE_TARGET_TOLERANCE_PERCENT 10
+
+/* Image store fill, in percent, below a profile's band before stepping up. */
+#define PROFILE_HYSTERESIS_PERCENT 5
+
+/* Metadata inserted after the SOI marker of each image: an APP9 segment
+   holding the identifier, then a JSON object with the tick count, the
+   newest sensor reading and the capture settings. */
+#define IMAGE_METADATA_APP    9
+#define IMAGE_METADATA_ID     "META"
+#define IMAGE_METADATA_LENGTH 192
+
+/* Camera FIFO bytes read per burst, a whole number of SD sectors. */
+#define CAPTURE_BURST_LENGTH (4 * F_SECTOR_SIZE)
+
+/* Container files for samples and images, preallocated on first boot. */
+#define DATA_LOG_NAME "data.rlg"
+#define DATA_LOG_SECTORS 8192
+#define IMAGE_STORE_NAME "dcim.pak"
+#define IMAGE_STORE_SECTORS 65536
+#define THUMB_STORE_NAME "thmb.pak"
+#define THUMB_STORE_SECTORS 8192
+
+/* Build with -DCLEAN_SD_CARD to discard the contents of the data log, image
+   store and thumbnail store at boot. Off by default, so that records kept
+   across a reset are recovered and still uploaded. */
+
+/* Samples are written to the data log as packed blocks if defined, and as
+   SampleRecords otherwise. */
+#define PACK_SAMPLES
+
+/* Samples, images and thumbnails waiting to be uploaded. */
+extern RingLog dataLog;
+extern RingLog imageStore;
+extern RingLog thumbStore;
 
-/* Program will delete DATA.LOG and JPG files at boot if defined. */
-#define CLEAN_SD_CARD
+/* Stored images that went without a thumbnail. */
+extern uint32_t thumbnailsSkipped;
 
+uint16_t camera_image_metadata(uint8_t* segment, TickType_t tickCount);
 void camera_task(void * pvParameters);
 
 #ifdef __cplusplus
@@ -0,0 +1,71 @@
+/**
+ * I2C task
+ *
+ * Owns the I2C bus. Other tasks queue requests and block until their own
+ * request completes, while the transfers run on interrupts.
+ */
+
+#ifndef _I2C_TASK_H_
+#define _I2C_TASK_H_
+
+#include <stm32f4xx.h>
+#include <stm32f4xx_hal_conf.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+#include <peripheral/i2c_spi_bus.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define I2C_TASK_NAME "I2CM"
+#define I2C_TASK_STACK_SIZE 256
+
+/* Requests waiting for the bus. */
+#define I2C_QUEUE_LENGTH 8
+
+/* Longest a single transfer may hold the bus before it is reset. A 256
+   byte transfer takes under 80 ms at I2C_CLOCK_DEFAULT. */
+#define I2C_TRANSFER_TIMEOUT_MS 100
+
+/* Devices that can be given their own clock speed. */
+#define I2C_MAX_DEVICE_SPEEDS 4
+
+/* Transfers in the batches built by the register table helpers. */
+#define I2C_BATCH_LENGTH 16
+
+/**
+ * A write of WriteLength bytes followed by a read of ReadLength bytes from
+ * one device. Either may be empty. The read is a separate transaction
+ * after a stop, as the OV5642 (SCCB) does not accept a repeated start.
+ */
+typedef struct _I2C_Transfer {
+	uint8_t Device;
+	const uint8_t* Write;
+	uint16_t WriteLength;
+	uint8_t* Read;
+	uint16_t ReadLength;
+} I2C_Transfer;
+
+/* A batch of transfers, run in order until one fails. */
+typedef struct _I2C_Request {
+	I2C_Transfer* Transfers;
+	uint8_t Count;
+	TaskHandle_t Task;         /* Notified once Status is set */
+	Devices_StatusTypeDef Status;
+} I2C_Request;
+
+/* Pointers to requests, owned by the tasks waiting on them. */
+extern QueueHandle_t xI2cQueue;
+
+Devices_StatusTypeDef i2c_transact(I2C_Transfer* transfers, uint8_t count);
+void i2c_task(void * pvParameters);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _I2C_TASK_H_ */
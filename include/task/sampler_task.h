@@ -0,0 +1,63 @@
+/**
+ * Sampler task
+ *
+ * Starts a conversion on each sensor every SAMPLE_RATE_MS and reads the
+ * results when the data ready interrupts say they are done.
+ */
+
+#ifndef _SAMPLER_TASK_H_
+#define _SAMPLER_TASK_H_
+
+#include <stm32f4xx.h>
+#include <stm32f4xx_hal_conf.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+#include <sample_ring.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SAMPLER_TASK_NAME "SAMP"
+#define SAMPLER_TASK_STACK_SIZE 384
+
+/* Time between conversions. The sensors are idle in between. */
+#define SAMPLE_RATE_MS 5000
+
+/* Longest wait for a conversion. A sensor that has not signalled by then
+   is read anyway, in case its data ready line is not connected. */
+#define SAMPLE_DRDY_TIMEOUT_MS 1500
+
+/* Samples waiting to be stored by the camera task: 128 is over 10
+   minutes at SAMPLE_RATE_MS. The policy is one of the SAMPLE_RING_*
+   overflow policies, and a producer under SAMPLE_RING_BLOCK gives up on a
+   sample after SAMPLE_BLOCK_MS. */
+#define SAMPLE_RING_CAPACITY   128
+#define SAMPLE_RING_POLICY     SAMPLE_RING_DECIMATE
+#define SAMPLE_RING_DECIMATION 4
+#define SAMPLE_BLOCK_MS        (SAMPLE_RATE_MS / 2)
+
+/* Bits queued by the data ready interrupts, one item per edge. They are
+   queued rather than notified, as i2c_transact() waits on the task's
+   notification for the I2C task. */
+#define SAMPLE_DRDY_LPS331 0x01
+#define SAMPLE_DRDY_HTS221 0x02
+#define SAMPLE_DRDY_ALL    (SAMPLE_DRDY_LPS331 | SAMPLE_DRDY_HTS221)
+#define SAMPLE_DRDY_QUEUE_LENGTH 4
+
+/* Samples from the sampler task, taken by the camera task. */
+extern SampleRing sampleRing;
+
+/* Samples finished by a timeout rather than on data ready. */
+extern uint32_t sampleDrdyMissed;
+
+void sampler_task(void * pvParameters);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SAMPLER_TASK_H_ */
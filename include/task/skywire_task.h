@@ -12,6 +12,10 @@
 
 #include "FreeRTOS.h"
 #include "task.h"
+#include "queue.h"
+
+#include <ring_log.h>
+#include <task/camera_task.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -22,12 +26,59 @@ extern "C" {
 
 #define NGROK_TUNNEL "35942d70.ngrok.io"
 
-/* An item to be POSTed to the server. */
-typedef struct _Attachment {
-	char name[64];
-	uint32_t length;
-	struct _Attachment* next;
-} Attachment;
+/* Maximum number of sample records, images and thumbnails sent in one
+   POST. Each sample record holds up to SAMPLE_FLUSH_BATCH samples. */
+#define UPLOAD_MAX_RECORDS 16
+#define UPLOAD_MAX_IMAGES 4
+#define UPLOAD_MAX_THUMBNAILS 8
+
+/* Attachments holding the sample records of a POST, and the SAME lines
+   logged for unchanged scenes. */
+#define SAMPLE_ATTACHMENT "samples.bin"
+#define SAME_ATTACHMENT "same.txt"
+
+/* Time between uploads. */
+#define UPLOAD_INTERVAL_MS 30000
+
+/* Longest span the server may ask to have uploaded again, with a
+   RESEND=<seconds> line ahead of the SL line in its response. */
+#define RESEND_MAX_S 3600
+
+/* Camera FIFO bytes read per burst when streaming an image live. The first
+   burst must hold the JPEG headers. */
+#define LIVE_BURST_LENGTH 1024
+
+/* A run of records taken from the tail of a log. */
+typedef struct _ManifestRun {
+	RingCursor start;
+	RingCursor end;
+	uint16_t count;
+} ManifestRun;
+
+/* Records to be POSTed to the server. */
+typedef struct _Manifest {
+	ManifestRun samples;
+	ManifestRun images;
+	ManifestRun thumbnails;
+	uint32_t length;           /* Length of the SAMPLE_ATTACHMENT */
+	uint32_t sameLength;       /* Length of the SAME_ATTACHMENT */
+} Manifest;
+
+/* An image waiting in the camera FIFO to be streamed to the server. */
+typedef struct _LiveImage {
+	TickType_t TickCount;
+	uint32_t Length;           /* FIFO length, including the dummy byte */
+	uint16_t MetadataLength;
+	uint8_t Metadata[IMAGE_METADATA_LENGTH];  /* Segment to insert after SOI */
+} LiveImage;
+
+/* Set while the Skywire task is idle and waiting on xLiveQueue. */
+extern volatile uint8_t liveWaiting;
+
+/* Images handed from the camera task, and the length of each image that
+   was uploaded (0 if the camera should store it instead). */
+extern QueueHandle_t xLiveQueue;
+extern QueueHandle_t xLiveResultQueue;
 
 void skywire_task(void * pvParameters);
 
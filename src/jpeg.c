@@ -0,0 +1,561 @@
+#include <jpeg.h>
+#include <string.h>
+
+/**
+ * Check that the buffer starts with the SOI marker.
+ */
+uint8_t
+jpeg_check_soi(const uint8_t* buffer, uint32_t length) {
+	return length >= 2 && buffer[0] == JPEG_MARKER && buffer[1] == JPEG_SOI;
+}
+
+/**
+ * Walk the marker segments from SOI to the end of the SOS header.
+ * Returns the offset of the first entropy coded byte, or 0 if the headers
+ * do not fit in the buffer. Tables may contain FF D9, so scanning for EOI
+ * should start from here.
+ */
+uint32_t
+jpeg_header_length(const uint8_t* buffer, uint32_t length) {
+	if (!jpeg_check_soi(buffer, length)) {
+		return 0;
+	}
+
+	uint32_t position = 2;
+	while (position + 4 <= length) {
+		if (buffer[position] != JPEG_MARKER) {
+			return 0;
+		}
+		uint8_t marker = buffer[position + 1];
+		if (marker == JPEG_MARKER) {
+			/* Fill byte. */
+			position++;
+			continue;
+		}
+		if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) {
+			/* Markers without a length. */
+			position += 2;
+			continue;
+		}
+
+		uint16_t segment = (buffer[position + 2] << 8) | buffer[position + 3];
+		position += 2 + segment;
+		if (marker == JPEG_SOS) {
+			return (position <= length) ? position : 0;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Fill in the marker and length field of a segment whose payload of the
+ * given length has been written at buffer + 4.
+ * Returns the length of the whole segment.
+ */
+uint32_t
+jpeg_segment(uint8_t* buffer, uint8_t marker, uint16_t length) {
+	buffer[0] = JPEG_MARKER;
+	buffer[1] = marker;
+	buffer[2] = (length + 2) >> 8;
+	buffer[3] = (length + 2) & 0xFF;
+	return length + 4;
+}
+
+/**
+ * Find a marker in the next part of a stream.
+ * Returns the number of bytes up to and including the marker, or 0 if it
+ * is not in this buffer. A trailing 0xFF is remembered for the next call.
+ *
+ * Most of the data is free of 0xFF, so it is tested a word at a time and
+ * only words holding a 0xFF byte are looked at closely.
+ */
+static uint32_t
+jpeg_find_marker(JpegScanner* scanner, const uint8_t* buffer, uint32_t length, uint8_t marker) {
+	uint32_t i = 0;
+
+	if (length == 0) {
+		return 0;
+	}
+	if (scanner->Pending && buffer[0] == marker) {
+		scanner->Pending = 0;
+		return 1;
+	}
+	scanner->Pending = 0;
+
+	while (i < length) {
+		/* Skip whole words without a 0xFF byte. */
+		if (((uintptr_t)(buffer + i) & 3) == 0) {
+			while (i + 4 <= length) {
+				uint32_t inverse = ~*(const uint32_t*)(buffer + i);
+				if (((inverse - 0x01010101) & ~inverse & 0x80808080) != 0) {
+					break;
+				}
+				i += 4;
+			}
+			if (i >= length) {
+				break;
+			}
+		}
+
+		if (buffer[i] == JPEG_MARKER) {
+			if (i + 1 == length) {
+				scanner->Pending = 1;
+				return 0;
+			}
+			if (buffer[i + 1] == marker) {
+				return i + 2;
+			}
+		}
+		i++;
+	}
+	return 0;
+}
+
+/**
+ * Find the EOI marker in the next part of the entropy coded data.
+ * Returns the number of bytes up to and including EOI, or 0 if it is not
+ * in this buffer.
+ */
+uint32_t
+jpeg_find_eoi(JpegScanner* scanner, const uint8_t* buffer, uint32_t length) {
+	return jpeg_find_marker(scanner, buffer, length, JPEG_EOI);
+}
+
+/**
+ * Find the SOI marker that starts the next image in a stream of frames.
+ * Returns the number of bytes up to and including SOI, or 0 if it is not
+ * in this buffer. A return of 1 means the 0xFF ended the previous buffer.
+ */
+uint32_t
+jpeg_find_soi(JpegScanner* scanner, const uint8_t* buffer, uint32_t length) {
+	return jpeg_find_marker(scanner, buffer, length, JPEG_SOI);
+}
+
+/* Scene signature ---------------------------------------------------------- */
+
+/**
+ * Build a Huffman table from the code counts and values of a DHT segment.
+ */
+static void
+jpeg_dc_table(JpegHuffman* table, const uint8_t* counts, const uint8_t* values, uint16_t total) {
+	uint32_t code = 0;
+	uint16_t k = 0;
+	for (uint8_t l = 1; l <= 16; ++l) {
+		table->ValuePointer[l] = k;
+		table->MinCode[l] = code;
+		code += counts[l - 1];
+		k += counts[l - 1];
+		table->MaxCode[l] = counts[l - 1] ? (int32_t)code - 1 : -1;
+		code <<= 1;
+	}
+	memcpy(table->Values, values, total);
+}
+
+/**
+ * Parse the headers of a baseline JPEG and prepare to decode its scan.
+ * Returns the offset of the first entropy coded byte, or 0 if the headers
+ * do not fit in the buffer or the image cannot be decoded. The decoder is
+ * left in JPEG_DC_FAILED in that case.
+ */
+uint32_t
+jpeg_dc_begin(JpegDcDecoder* decoder, const uint8_t* buffer, uint32_t length) {
+	memset(decoder, 0, sizeof(JpegDcDecoder));
+	decoder->State = JPEG_DC_FAILED;
+	if (!jpeg_check_soi(buffer, length)) {
+		return 0;
+	}
+
+	uint8_t hMax = 1, vMax = 1;
+	uint16_t width = 0, height = 0;
+	uint32_t position = 2;
+	while (position + 4 <= length) {
+		if (buffer[position] != JPEG_MARKER) {
+			return 0;
+		}
+		uint8_t marker = buffer[position + 1];
+		if (marker == JPEG_MARKER) {
+			position++;
+			continue;
+		}
+		uint16_t segment = (buffer[position + 2] << 8) | buffer[position + 3];
+		const uint8_t* p = buffer + position + 4;
+		const uint8_t* end = buffer + position + 2 + segment;
+		if (segment < 2 || position + 2 + segment > length) {
+			return 0;
+		}
+
+		switch (marker) {
+		case JPEG_DQT:
+			while (p < end) {
+				uint8_t precision = p[0] >> 4;
+				decoder->QuantDc[p[0] & 3] = precision ? ((p[1] << 8) | p[2]) : p[1];
+				p += 1 + 64 * (precision + 1);
+			}
+			break;
+
+		case JPEG_DHT:
+			while (p + 17 <= end) {
+				uint16_t total = 0;
+				for (uint8_t i = 0; i < 16; ++i) {
+					total += p[1 + i];
+				}
+				if ((p[0] & 0x0F) > 1 || total > 256 || p + 17 + total > end) {
+					return 0;
+				}
+				JpegHuffman* table = (p[0] >> 4) ? &decoder->Ac[p[0] & 1] : &decoder->Dc[p[0] & 1];
+				jpeg_dc_table(table, p + 1, p + 17, total);
+				p += 17 + total;
+			}
+			break;
+
+		case JPEG_SOF0:
+		case JPEG_SOF1:
+			height = (p[1] << 8) | p[2];
+			width = (p[3] << 8) | p[4];
+			decoder->ComponentCount = p[5];
+			if (decoder->ComponentCount != 1 && decoder->ComponentCount != 3) {
+				return 0;
+			}
+			for (uint8_t i = 0; i < decoder->ComponentCount; ++i) {
+				JpegComponent* component = &decoder->Components[i];
+				component->Id = p[6 + 3 * i];
+				component->H = p[7 + 3 * i] >> 4;
+				component->V = p[7 + 3 * i] & 0x0F;
+				component->QuantTable = p[8 + 3 * i] & 3;
+				if (component->H == 0 || component->V == 0) {
+					return 0;
+				}
+				hMax = (component->H > hMax) ? component->H : hMax;
+				vMax = (component->V > vMax) ? component->V : vMax;
+			}
+			break;
+
+		case JPEG_DRI:
+			decoder->RestartInterval = (p[0] << 8) | p[1];
+			break;
+
+		case JPEG_SOS:
+			/* Only a single scan holding every component is decoded. */
+			if (width == 0 || p[0] != decoder->ComponentCount) {
+				return 0;
+			}
+			for (uint8_t i = 0; i < p[0]; ++i) {
+				JpegComponent* component = &decoder->Components[i];
+				if (component->Id != p[1 + 2 * i]) {
+					return 0;
+				}
+				component->DcTable = (p[2 + 2 * i] >> 4) & 1;
+				component->AcTable = p[2 + 2 * i] & 1;
+			}
+			if (decoder->ComponentCount == 1) {
+				/* A single component scan is not interleaved. */
+				decoder->Components[0].H = decoder->Components[0].V = 1;
+				hMax = vMax = 1;
+			}
+			decoder->McusX = (width + 8 * hMax - 1) / (8 * hMax);
+			decoder->McusY = (height + 8 * vMax - 1) / (8 * vMax);
+			if (   decoder->McusX * decoder->Components[0].H <= JPEG_THUMBNAIL_WIDTH
+				&& decoder->Components[0].V <= JPEG_THUMBNAIL_ROWS) {
+				decoder->ThumbnailWidth = (width + 7) / 8;
+				decoder->ThumbnailHeight = (height + 7) / 8;
+			}
+			decoder->State = JPEG_DC_DECODING;
+			return position + 2 + segment;
+
+		default:
+			if (marker >= 0xC2 && marker <= 0xCF && marker != JPEG_DHT && marker != 0xC8 && marker != 0xCC) {
+				/* Progressive, lossless and arithmetic coding. */
+				return 0;
+			}
+			break;
+		}
+		position += 2 + segment;
+	}
+	return 0;
+}
+
+/**
+ * Number of entropy coded bytes available to the decoder.
+ */
+static uint32_t
+jpeg_dc_available(JpegDcDecoder* decoder) {
+	return (decoder->CarryLength - decoder->CarryPosition)
+			+ (decoder->DataLength - decoder->DataPosition);
+}
+
+/**
+ * Look at the byte at an offset from the next one without using it.
+ * Returns -1 past the end of the data.
+ */
+static int16_t
+jpeg_dc_peek(JpegDcDecoder* decoder, uint32_t offset) {
+	uint32_t carried = decoder->CarryLength - decoder->CarryPosition;
+	if (offset < carried) {
+		return decoder->Carry[decoder->CarryPosition + offset];
+	}
+	offset = decoder->DataPosition + (offset - carried);
+	return (offset < decoder->DataLength) ? decoder->Data[offset] : -1;
+}
+
+/**
+ * Use up bytes of entropy coded data.
+ */
+static void
+jpeg_dc_skip(JpegDcDecoder* decoder, uint32_t count) {
+	uint32_t carried = decoder->CarryLength - decoder->CarryPosition;
+	if (count <= carried) {
+		decoder->CarryPosition += count;
+		return;
+	}
+	decoder->CarryPosition = decoder->CarryLength;
+	decoder->DataPosition += count - carried;
+}
+
+/**
+ * Load at least count bits from the entropy coded data, removing byte
+ * stuffing. A marker or the end of the data gives zero bits, as T.81
+ * F.2.2.5 suggests.
+ */
+static void
+jpeg_dc_fill(JpegDcDecoder* decoder, uint8_t count) {
+	while (decoder->BitCount < count) {
+		int16_t byte = decoder->Marker ? 0 : jpeg_dc_peek(decoder, 0);
+		if (byte == JPEG_MARKER) {
+			if (jpeg_dc_peek(decoder, 1) != 0x00) {
+				decoder->Marker = 1;
+				byte = 0;
+			} else {
+				jpeg_dc_skip(decoder, 2);
+			}
+		} else if (byte < 0) {
+			decoder->Marker = 1;
+			byte = 0;
+		} else if (!decoder->Marker) {
+			jpeg_dc_skip(decoder, 1);
+		}
+		decoder->Bits = (decoder->Bits << 8) | byte;
+		decoder->BitCount += 8;
+	}
+}
+
+/**
+ * Read bits from the entropy coded data.
+ */
+static uint16_t
+jpeg_dc_bits(JpegDcDecoder* decoder, uint8_t count) {
+	jpeg_dc_fill(decoder, count);
+	decoder->BitCount -= count;
+	return (decoder->Bits >> decoder->BitCount) & ((1 << count) - 1);
+}
+
+/**
+ * Decode one Huffman coded value. Returns -1 for an invalid code.
+ * The longest possible code is loaded at once and compared a length at a
+ * time, then only the bits of the code found are used up.
+ */
+static int16_t
+jpeg_dc_huffman(JpegDcDecoder* decoder, const JpegHuffman* table) {
+	jpeg_dc_fill(decoder, 16);
+	uint32_t window = decoder->Bits >> (decoder->BitCount - 16);
+	for (uint8_t l = 1; l <= 16; ++l) {
+		int32_t code = (window >> (16 - l)) & ((1 << l) - 1);
+		if (code <= table->MaxCode[l]) {
+			decoder->BitCount -= l;
+			return table->Values[table->ValuePointer[l] + code - table->MinCode[l]];
+		}
+	}
+	return -1;
+}
+
+/**
+ * Decode one block, skipping the AC coefficients.
+ * Returns the dequantised DC coefficient, which is eight times the mean
+ * sample value less 128.
+ */
+static int32_t
+jpeg_dc_block(JpegDcDecoder* decoder, JpegComponent* component) {
+	int16_t size = jpeg_dc_huffman(decoder, &decoder->Dc[component->DcTable]);
+	if (size < 0 || size > 11) {
+		decoder->State = JPEG_DC_FAILED;
+		return 0;
+	}
+	if (size > 0) {
+		int16_t difference = jpeg_dc_bits(decoder, size);
+		if (difference < (1 << (size - 1))) {
+			difference -= (1 << size) - 1;
+		}
+		component->Predictor += difference;
+	}
+
+	for (uint8_t k = 1; k < 64; ) {
+		int16_t symbol = jpeg_dc_huffman(decoder, &decoder->Ac[component->AcTable]);
+		if (symbol < 0) {
+			decoder->State = JPEG_DC_FAILED;
+			return 0;
+		}
+		if ((symbol & 0x0F) == 0) {
+			if (symbol != 0xF0) {
+				break;             /* End of block */
+			}
+			k += 16;
+		} else {
+			jpeg_dc_bits(decoder, symbol & 0x0F);
+			k += (symbol >> 4) + 1;
+		}
+	}
+	return (int32_t)component->Predictor * decoder->QuantDc[component->QuantTable];
+}
+
+/**
+ * Move past the RST marker at the end of a restart interval.
+ */
+static void
+jpeg_dc_restart(JpegDcDecoder* decoder) {
+	decoder->Bits = decoder->BitCount = 0;
+	decoder->Marker = 0;
+	for (;;) {
+		int16_t byte = jpeg_dc_peek(decoder, 0);
+		int16_t next = jpeg_dc_peek(decoder, 1);
+		if (byte < 0 || next < 0) {
+			decoder->State = JPEG_DC_FAILED;
+			return;
+		}
+		if (byte == JPEG_MARKER && next >= JPEG_RST0 && next <= JPEG_RST7) {
+			jpeg_dc_skip(decoder, 2);
+			break;
+		}
+		jpeg_dc_skip(decoder, 1);
+	}
+	for (uint8_t i = 0; i < decoder->ComponentCount; ++i) {
+		decoder->Components[i].Predictor = 0;
+	}
+}
+
+/**
+ * Pass the thumbnail rows of a completed MCU row to the row output,
+ * leaving out any rows past the bottom of the image.
+ */
+static void
+jpeg_dc_rows(JpegDcDecoder* decoder) {
+	for (uint8_t row = 0; row < decoder->Components[0].V; ++row) {
+		if (decoder->ThumbnailRow < decoder->ThumbnailHeight) {
+			decoder->RowOutput(decoder->RowContext, decoder->Rows[row], decoder->ThumbnailWidth);
+			decoder->ThumbnailRow++;
+		}
+	}
+}
+
+/**
+ * Decode the next part of the entropy coded data, accumulating the luma DC
+ * of each MCU into the cell of the signature grid it falls in. The luma DC
+ * of each block is also a pixel of a 1/8 scale thumbnail, which is passed
+ * to the row output an MCU row at a time. MCUs are only decoded while
+ * JPEG_CARRY_LENGTH bytes are available, and the rest is carried to the
+ * next call, unless this is the last part of the image.
+ */
+void
+jpeg_dc_decode(JpegDcDecoder* decoder, const uint8_t* buffer, uint32_t length, uint8_t last) {
+	uint32_t mcus = (uint32_t)decoder->McusX * decoder->McusY;
+	decoder->Data = buffer;
+	decoder->DataLength = length;
+	decoder->DataPosition = 0;
+
+	while (   decoder->State == JPEG_DC_DECODING
+		   && (last || jpeg_dc_available(decoder) >= JPEG_CARRY_LENGTH)) {
+		if (   decoder->RestartInterval != 0 && decoder->Mcu != 0
+			&& decoder->Mcu % decoder->RestartInterval == 0) {
+			jpeg_dc_restart(decoder);
+		}
+
+		uint32_t x = decoder->Mcu % decoder->McusX;
+		uint32_t y = decoder->Mcu / decoder->McusX;
+		uint16_t cell = (y * JPEG_SIGNATURE_GRID / decoder->McusY) * JPEG_SIGNATURE_GRID
+				+ (x * JPEG_SIGNATURE_GRID / decoder->McusX);
+		for (uint8_t i = 0; i < decoder->ComponentCount; ++i) {
+			JpegComponent* component = &decoder->Components[i];
+			for (uint8_t block = 0; block < component->H * component->V; ++block) {
+				int32_t dc = jpeg_dc_block(decoder, component);
+				if (i == 0) {
+					decoder->Sums[cell] += dc;
+					decoder->Counts[cell]++;
+					if (decoder->ThumbnailWidth != 0) {
+						/* The DC is eight times the block mean less 128,
+						   rounded to the nearest level. */
+						int32_t level = ((dc + 4) >> 3) + 128;
+						decoder->Rows[block / component->H][x * component->H + block % component->H] =
+								(level < 0) ? 0 : (level > 255) ? 255 : level;
+					}
+				}
+			}
+		}
+
+		if (   decoder->State == JPEG_DC_DECODING && decoder->RowOutput != NULL
+			&& decoder->ThumbnailWidth != 0 && x == decoder->McusX - 1U) {
+			jpeg_dc_rows(decoder);
+		}
+		if (decoder->State == JPEG_DC_DECODING && ++decoder->Mcu == mcus) {
+			decoder->State = JPEG_DC_DONE;
+		}
+		if (   decoder->State == JPEG_DC_DECODING
+			&& decoder->Marker && jpeg_dc_available(decoder) == 0) {
+			/* Ran out of data part way through an MCU. */
+			decoder->State = JPEG_DC_FAILED;
+		}
+	}
+
+	/* Carry the unused bytes to the next call. */
+	uint32_t carried = decoder->CarryLength - decoder->CarryPosition;
+	uint32_t remaining = decoder->DataLength - decoder->DataPosition;
+	if (decoder->State == JPEG_DC_DECODING && carried + remaining <= JPEG_CARRY_LENGTH) {
+		memmove(decoder->Carry, decoder->Carry + decoder->CarryPosition, carried);
+		memcpy(decoder->Carry + carried, buffer + decoder->DataPosition, remaining);
+		decoder->CarryLength = carried + remaining;
+		decoder->CarryPosition = 0;
+	} else if (decoder->State == JPEG_DC_DECODING) {
+		decoder->State = JPEG_DC_FAILED;
+	}
+	decoder->Data = NULL;
+	decoder->DataLength = decoder->DataPosition = 0;
+}
+
+/**
+ * Reduce a decoded image to its signature, the mean luma of each cell of
+ * a JPEG_SIGNATURE_GRID square grid over the image. Returns 0 if the image
+ * was not decoded completely.
+ */
+uint8_t
+jpeg_dc_signature(JpegDcDecoder* decoder, uint8_t* signature) {
+	if (decoder->State != JPEG_DC_DONE) {
+		return 0;
+	}
+	for (uint8_t i = 0; i < JPEG_SIGNATURE_CELLS; ++i) {
+		int32_t level = 0;
+		if (decoder->Counts[i] != 0) {
+			level = decoder->Sums[i] / (8 * (int32_t)decoder->Counts[i]) + 128;
+		}
+		signature[i] = (level < 0) ? 0 : (level > 255) ? 255 : level;
+	}
+	return 1;
+}
+
+/**
+ * Count the cells that differ between two signatures by more than the
+ * threshold, after removing any change in overall brightness.
+ */
+uint8_t
+jpeg_signature_compare(const uint8_t* a, const uint8_t* b, uint8_t threshold) {
+	int32_t shift = 0;
+	for (uint8_t i = 0; i < JPEG_SIGNATURE_CELLS; ++i) {
+		shift += (int32_t)a[i] - b[i];
+	}
+	shift /= JPEG_SIGNATURE_CELLS;
+
+	uint8_t changed = 0;
+	for (uint8_t i = 0; i < JPEG_SIGNATURE_CELLS; ++i) {
+		int32_t difference = (int32_t)a[i] - b[i] - shift;
+		if (difference > threshold || difference < -threshold) {
+			changed++;
+		}
+	}
+	return changed;
+}
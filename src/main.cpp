@@ -14,11 +14,14 @@
 #include <task/beacon_task.h>
 #include <task/camera_task.h>
 #include <task/receive_task.h>
+#include <task/i2c_task.h>
+#include <task/sampler_task.h>
 
 /* Enable or disable tasks for development. */
 #define SKYWIRE_TASK 0
 #define BEACON_TASK 1
 #define CAMERA_TASK 0
+#define SAMPLER_TASK 0
 #define RECEIVE_TASK 0
 
 void
@@ -31,6 +34,16 @@ setup_task(void * pvParameters) {
 	trace_printf("initialize SPI bus\n");
 	spi_bus_init();
 
+	/* Start the I2C task before any task that uses the sensors. It sleeps
+	   while transfers run, so it can sit above the other tasks. */
+	trace_printf("starting I2C task\n");
+	xTaskCreate(i2c_task,
+			I2C_TASK_NAME,
+			I2C_TASK_STACK_SIZE,
+			(void *)NULL,
+			tskIDLE_PRIORITY + 1,
+			NULL);
+
 	#if BEACON_TASK
 	trace_printf("starting beacon task\n");
 	xTaskCreate(beacon_task,
@@ -41,6 +54,16 @@ setup_task(void * pvParameters) {
 			NULL);
 	#endif
 
+	#if SAMPLER_TASK
+	trace_printf("starting sampler task\n");
+	xTaskCreate(sampler_task,
+			SAMPLER_TASK_NAME,
+			SAMPLER_TASK_STACK_SIZE,
+			(void *)NULL,
+			tskIDLE_PRIORITY + 1,
+			NULL);
+	#endif
+
 	#if CAMERA_TASK
 	trace_printf("starting camera task\n");
 	xTaskCreate(camera_task,
@@ -3,6 +3,16 @@
 #include "diag/Trace.h"
 #include "FreeRTOS.h"
 #include "task.h"
+#include <string.h>
+
+/* Profile the OV5642 registers hold, or OV5642_PROFILE_NONE if unknown. */
+static uint8_t ov5642Profile = OV5642_PROFILE_NONE;
+
+/* Values written to ov5642_profile_registers, valid with ov5642Profile. */
+static uint8_t ov5642Registers[OV5642_PROFILE_REGISTERS];
+
+/* Region of the field the OV5642 outputs. */
+static OV5642_Window ov5642Window = { 0, 0, 100, 100 };
 
 /* ArduChip ----------------------------------------------------------------- */
 
@@ -93,6 +103,25 @@ arducam_setup() {
 	return DEVICES_OK;
 }
 
+/**
+ * Set the number of frames captured into the FIFO on each trigger, from 1
+ * to ARDUCAM_MAX_FRAMES. The frames follow one another in the FIFO.
+ */
+Devices_StatusTypeDef
+arducam_set_frames(uint8_t frames) {
+	if (frames < 1 || frames > ARDUCAM_MAX_FRAMES) {
+		return DEVICES_ERROR;
+	}
+
+	spi_select(SLAVE_ARDUCAM);
+	if (spi_write8_8(&hspi, ARDUCHIP_CCR, CCR_FRAMES(frames)) != DEVICES_OK) {
+		spi_release(SLAVE_ARDUCAM);
+		return DEVICES_ERROR;
+	}
+	spi_release(SLAVE_ARDUCAM);
+	return DEVICES_OK;
+}
+
 /**
  * Initiate a JPEG image capture.
  */
@@ -175,33 +204,57 @@ arducam_low_power_remove(){
 	return DEVICES_OK;
 }
 
+/**
+ * Check whether the capture has finished writing to the FIFO buffer.
+ * A single status read, so the SPI bus can be shared during the exposure.
+ */
+Devices_StatusTypeDef
+arducam_capture_done(uint8_t* done) {
+	uint8_t value;
+
+	spi_select(SLAVE_ARDUCAM);
+	if (spi_read8(&hspi, ARDUCHIP_STATUS, &value, 1) != DEVICES_OK) {
+		spi_release(SLAVE_ARDUCAM);
+		return DEVICES_ERROR;
+	}
+	spi_release(SLAVE_ARDUCAM);
+
+	*done = ((value & STATUS_FIFO_DONE_MASK) == STATUS_FIFO_DONE_MASK);
+	return DEVICES_OK;
+}
+
 /**
  * Wait for the capture flag to be asserted and return the size of the data
  * written to the FIFO buffer.
  */
 Devices_StatusTypeDef
 arducam_wait_capture(uint32_t* capture_length) {
-	uint8_t value;
+	uint8_t done;
 
 	/* Poll the FIFO write done flag. */
 	for(;;) {
-		spi_select(SLAVE_ARDUCAM);
-
-		if (spi_read8(&hspi, ARDUCHIP_STATUS, &value, 1) != DEVICES_OK) {
-			spi_release(SLAVE_ARDUCAM);
+		if (arducam_capture_done(&done) != DEVICES_OK) {
 			return DEVICES_ERROR;
 		}
 
 		/* Break when FIFO done is asserted. */
-		if ((value & STATUS_FIFO_DONE_MASK) == STATUS_FIFO_DONE_MASK) {
-			spi_release(SLAVE_ARDUCAM);
+		if (done) {
 			break;
 		}
 
-		spi_release(SLAVE_ARDUCAM);
 		vTaskDelay(10);
 	}
 
+	return arducam_capture_length(capture_length);
+}
+
+/**
+ * Return the size of the data written to the FIFO buffer.
+ */
+Devices_StatusTypeDef
+arducam_capture_length(uint32_t* capture_length) {
+	uint8_t value;
+
 	/* Get the FIFO write size. */
 	spi_select(SLAVE_ARDUCAM);
 	if (spi_read8(&hspi, ARDUCHIP_FIFO_WRITE_0, &value, 1) != DEVICES_OK) {
@@ -274,6 +327,20 @@ arducam_burst_read(uint8_t* buffer, uint16_t length) {
 	return DEVICES_OK;
 }
 
+/**
+ * Reset the FIFO read pointer so the capture can be read out again.
+ */
+Devices_StatusTypeDef
+arducam_fifo_rewind() {
+	spi_select(SLAVE_ARDUCAM);
+	if (spi_write8_8(&hspi, ARDUCHIP_FIFO_CR, FIFO_RDPTR_RST_MASK) != DEVICES_OK) {
+		spi_release(SLAVE_ARDUCAM);
+		return DEVICES_ERROR;
+	}
+	spi_release(SLAVE_ARDUCAM);
+	return DEVICES_OK;
+}
+
 /* OV5642 I2C --------------------------------------------------------------- */
 
 /**
@@ -302,6 +369,11 @@ ov5642_init() {
 		goto not_present;
 	}
 
+	/* The register tables are long, so talk to the sensor at full speed. */
+	if (i2c_device_speed(OV5642_ADDRESS_W, I2C_CLOCK_FAST) != DEVICES_OK) {
+		goto not_ready;
+	}
+
 	/* Configure the CMOS sensor for JPEG capture.
 	 * TODO Start in low power mode and change modes later.
 	 */
@@ -322,37 +394,209 @@ not_ready:
 }
 
 /**
- * Configure the OV5642 for JPEG capture.
+ * Configure the OV5642 for JPEG capture in OV5642_PROFILE_DEFAULT.
+ * The register tables are written one write per run of consecutive
+ * registers.
  */
 Devices_StatusTypeDef
 ov5642_setup() {
+	Devices_StatusTypeDef result = DEVICES_ERROR;
+
 	// Perform a software reset of the camera sensor.
 	if (i2c_write16_8(OV5642_ADDRESS_W, 0x3008, 0x80) != DEVICES_OK) {
-		return DEVICES_ERROR;
+		goto error;
 	}
 
 	vTaskDelay(100);
 
 	// Initialize the registers of the camera sensor.
-	if (i2c_array16_8(OV5642_ADDRESS_W, ov5642_dvp_fmt_global_init) != DEVICES_OK) {
-		return DEVICES_ERROR;
+	if (i2c_runs16_8(OV5642_ADDRESS_W, ov5642_dvp_fmt_global_init) != DEVICES_OK) {
+		goto error;
 	}
 
 	vTaskDelay(100);
 
-	if (i2c_array16_8(OV5642_ADDRESS_W, ov5642_dvp_fmt_jpeg_qvga) != DEVICES_OK) {
+	if (i2c_runs16_8(OV5642_ADDRESS_W, ov5642_dvp_fmt_jpeg_qvga) != DEVICES_OK) {
+		goto error;
+	}
+
+	result = DEVICES_OK;
+
+	/* Fall through and clean up. */
+error:
+	ov5642Profile = OV5642_PROFILE_NONE;
+	if (result != DEVICES_OK) {
+		return result;
+	}
+	return ov5642_set_profile(OV5642_PROFILE_DEFAULT);
+}
+
+/**
+ * Read a 16-bit field from a set of profile register values.
+ */
+static uint16_t
+ov5642_get16(const uint8_t* values, uint8_t index) {
+	return (values[index] << 8) | values[index + 1];
+}
+
+/**
+ * Write a 16-bit field to a set of profile register values.
+ */
+static void
+ov5642_put16(uint8_t* values, uint8_t index, uint16_t value) {
+	values[index] = value >> 8;
+	values[index + 1] = value & 0xFF;
+}
+
+/**
+ * Write the registers for a profile cropped to the current window.
+ * Only the registers whose values differ from those last written are sent,
+ * with consecutive registers sent as one run.
+ */
+static Devices_StatusTypeDef
+ov5642_apply(OV5642_Profile profile) {
+	uint8_t values[OV5642_PROFILE_REGISTERS];
+	memcpy(values, ov5642_profiles[profile], OV5642_PROFILE_REGISTERS);
+
+	/* Crop the sensor window and shrink the output size in proportion,
+	   so the scale of the image is the same as over the full field. */
+	uint32_t width = ov5642_get16(values, OV5642_PROFILE_WINDOW_W);
+	uint32_t height = ov5642_get16(values, OV5642_PROFILE_WINDOW_H);
+	uint32_t outputWidth = ov5642_get16(values, OV5642_PROFILE_OUTPUT_W) * ov5642Window.Width / 100;
+	uint32_t outputHeight = ov5642_get16(values, OV5642_PROFILE_OUTPUT_H) * ov5642Window.Height / 100;
+	ov5642_put16(values, OV5642_PROFILE_WINDOW_X,
+			ov5642_get16(values, OV5642_PROFILE_WINDOW_X) + ((width * ov5642Window.Left / 100) & ~1));
+	ov5642_put16(values, OV5642_PROFILE_WINDOW_Y,
+			ov5642_get16(values, OV5642_PROFILE_WINDOW_Y) + ((height * ov5642Window.Top / 100) & ~1));
+	width = (width * ov5642Window.Width / 100) & ~1;
+	height = (height * ov5642Window.Height / 100) & ~1;
+	ov5642_put16(values, OV5642_PROFILE_WINDOW_W, width);
+	ov5642_put16(values, OV5642_PROFILE_WINDOW_H, height);
+	ov5642_put16(values, OV5642_PROFILE_AVERAGE_W, width);
+	ov5642_put16(values, OV5642_PROFILE_AVERAGE_H, height);
+
+	/* Whole JPEG blocks. */
+	ov5642_put16(values, OV5642_PROFILE_OUTPUT_W, (outputWidth >= 16) ? (outputWidth & ~15) : 16);
+	ov5642_put16(values, OV5642_PROFILE_OUTPUT_H, (outputHeight >= 8) ? (outputHeight & ~7) : 8);
+
+	/* A window change keeps the quantisation scale. */
+	if (profile == ov5642Profile) {
+		values[OV5642_PROFILE_QSCALE] = ov5642Registers[OV5642_PROFILE_QSCALE];
+	}
+
+	/* Build a register run table holding the changes. */
+	const uint8_t* current = (ov5642Profile != OV5642_PROFILE_NONE) ? ov5642Registers : NULL;
+	uint8_t table[4 * OV5642_PROFILE_REGISTERS + 1];
+	uint8_t* run = NULL;
+	uint8_t length = 0;
+	for (uint8_t i = 0; i < OV5642_PROFILE_REGISTERS; ++i) {
+		if (current != NULL && current[i] == values[i]) {
+			run = NULL;
+			continue;
+		}
+		if (   run == NULL
+			|| ov5642_profile_registers[i] != ov5642_profile_registers[i - 1] + 1) {
+			/* Start a new run. */
+			run = &table[length];
+			table[length++] = 0;
+			table[length++] = ov5642_profile_registers[i] >> 8;
+			table[length++] = ov5642_profile_registers[i] & 0xFF;
+		}
+		table[length++] = values[i];
+		run[0]++;
+	}
+	table[length] = REGISTER_END;
+
+	Devices_StatusTypeDef result = i2c_runs16_8(OV5642_ADDRESS_W, table);
+
+	/* A failed write leaves the registers unknown. */
+	if (result == DEVICES_OK) {
+		memcpy(ov5642Registers, values, OV5642_PROFILE_REGISTERS);
+		ov5642Profile = profile;
+	} else {
+		ov5642Profile = OV5642_PROFILE_NONE;
+	}
+	return result;
+}
+
+/**
+ * Switch the OV5642 to another capture profile.
+ * The quantisation scale starts from the profile's value.
+ */
+Devices_StatusTypeDef
+ov5642_set_profile(OV5642_Profile profile) {
+	if (profile >= OV5642_PROFILE_COUNT) {
 		return DEVICES_ERROR;
 	}
+	if (profile == ov5642Profile) {
+		return DEVICES_OK;
+	}
+	return ov5642_apply(profile);
+}
 
-	if (i2c_array16_8(OV5642_ADDRESS_W, ov5642_res_1080P) != DEVICES_OK) {
+/**
+ * Restrict the OV5642 output to a region of the field.
+ * The sensor reads out only the window, which shortens the FIFO readout and
+ * the JPEG. Exposure is metered over the window too. If the sensor is not
+ * set up yet, the window is applied by the next ov5642_set_profile().
+ */
+Devices_StatusTypeDef
+ov5642_set_window(const OV5642_Window* window) {
+	if (   window->Width == 0 || window->Left + window->Width > 100
+		|| window->Height == 0 || window->Top + window->Height > 100) {
 		return DEVICES_ERROR;
 	}
 
-	if (i2c_write16_8(OV5642_ADDRESS_W, 0x4407, 0x0C) != DEVICES_OK) {
+	ov5642Window = *window;
+	if (ov5642Profile == OV5642_PROFILE_NONE) {
+		return DEVICES_OK;
+	}
+	return ov5642_apply(ov5642Profile);
+}
+
+/**
+ * Return the profile the OV5642 is configured for.
+ */
+OV5642_Profile
+ov5642_get_profile() {
+	return ov5642Profile;
+}
+
+/**
+ * Set the JPEG quantisation scale, from OV5642_QSCALE_MIN for the finest
+ * quantisation to OV5642_QSCALE_MAX for the smallest images.
+ */
+Devices_StatusTypeDef
+ov5642_set_qscale(uint8_t qscale) {
+	if (ov5642Profile == OV5642_PROFILE_NONE) {
 		return DEVICES_ERROR;
 	}
+	if (qscale < OV5642_QSCALE_MIN) {
+		qscale = OV5642_QSCALE_MIN;
+	} else if (qscale > OV5642_QSCALE_MAX) {
+		qscale = OV5642_QSCALE_MAX;
+	}
+	if (qscale == ov5642Registers[OV5642_PROFILE_QSCALE]) {
+		return DEVICES_OK;
+	}
 
+	if (i2c_write16_8(OV5642_ADDRESS_W, OV5642_QSCALE, qscale) != DEVICES_OK) {
+		ov5642Profile = OV5642_PROFILE_NONE;
+		return DEVICES_ERROR;
+	}
+	ov5642Registers[OV5642_PROFILE_QSCALE] = qscale;
 	return DEVICES_OK;
 }
 
+/**
+ * Return the JPEG quantisation scale, or 0 if it is unknown.
+ */
+uint8_t
+ov5642_get_qscale() {
+	if (ov5642Profile == OV5642_PROFILE_NONE) {
+		return 0;
+	}
+	return ov5642Registers[OV5642_PROFILE_QSCALE];
+}
+
 
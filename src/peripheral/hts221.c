@@ -40,14 +40,17 @@ hts221_init() {
 		goto not_ready;
 	}
 
-	/* Configure the data rate and power status. */
+	/* Convert only when started, and signal each result on DRDY. */
 	HTS221_CtrlReg1TypeDef ctrl_reg_1 = { 0 };
 	ctrl_reg_1.PowerDown = HTS221_POWER_UP;
-	ctrl_reg_1.OutputDataRate = HTS221_RATE_1Hz;
+	ctrl_reg_1.OutputDataRate = HTS221_ONE_SHOT;
 	ctrl_reg_1.BlockDataUpdate = HTS221_BDU_ENABLE;
 	if (hts221_setup(&ctrl_reg_1) != DEVICES_OK) {
 		goto not_ready;
 	}
+	if (i2c_write8_8(HTS221_ADDRESS_W, HTS221_CTRL_REG_3, HTS221_DRDY_ENABLE) != DEVICES_OK) {
+		goto not_ready;
+	}
 
 	trace_printf("hts221: ready\n");
 	return 1;
@@ -61,6 +64,34 @@ not_ready:
 	return 0;
 }
 
+/**
+ * Set up the line through two calibration points, with the readings y0 and
+ * y1 in Q16 hundredths at the counts x0 and x1.
+ */
+static void
+hts221_conversion(HTS221_ConversionTypeDef* conversion, int32_t y0, int32_t y1, int16_t x0, int16_t x1) {
+	conversion->Offset = y0;
+	conversion->Zero = x0;
+	conversion->Slope = (x1 != x0) ? (int32_t)(((int64_t)y1 - y0) / (x1 - x0)) : 0;
+}
+
+/**
+ * Interpolate a count along a conversion line, rounded to the nearest
+ * hundredth. INT16_MIN is left free to mark a failed read.
+ */
+static int16_t
+hts221_convert(HTS221_ConversionTypeDef* conversion, int16_t value) {
+	int64_t q16 = conversion->Offset + (int64_t)conversion->Slope * (value - conversion->Zero);
+	int32_t result = (int32_t)((q16 + (1 << 15)) >> 16);
+	if (result > INT16_MAX) {
+		return INT16_MAX;
+	}
+	if (result <= INT16_MIN) {
+		return INT16_MIN + 1;
+	}
+	return result;
+}
+
 /**
  * Retrieve the calibration data from the sensor.
  * This is required to interpolate the physical units from the sensor values.
@@ -73,14 +104,20 @@ hts221_read_calib(HTS221_CalibTypeDef* calib) {
 		return DEVICES_ERROR;
 	}
 
-	calib->H0_rH = (float)buffer[0] / 2.0;
-	calib->H1_rH = (float)buffer[1] / 2.0;
-	calib->T0_degC = (float)(buffer[2] + ((buffer[5] & 0x3) << 8)) / 8.0;
-	calib->T1_degC = (float)(buffer[3] + ((buffer[5] & 0xC) << 6)) / 8.0;
-	calib->H0_T0_OUT = *(int16_t*)&buffer[6];
-	calib->H1_T0_OUT = *(int16_t*)&buffer[10];
-	calib->T0_OUT = *(int16_t*)&buffer[12];
-	calib->T1_OUT = *(int16_t*)&buffer[14];
+	/* Humidity points are in 1/2 %rH and temperature points in 1/8 degC. */
+	int32_t H0_rH_x2 = buffer[0];
+	int32_t H1_rH_x2 = buffer[1];
+	int32_t T0_degC_x8 = buffer[2] + ((buffer[5] & 0x3) << 8);
+	int32_t T1_degC_x8 = buffer[3] + ((buffer[5] & 0xC) << 6);
+	int16_t H0_T0_OUT = (int16_t)(buffer[6] | (buffer[7] << 8));
+	int16_t H1_T0_OUT = (int16_t)(buffer[10] | (buffer[11] << 8));
+	int16_t T0_OUT = (int16_t)(buffer[12] | (buffer[13] << 8));
+	int16_t T1_OUT = (int16_t)(buffer[14] | (buffer[15] << 8));
+
+	hts221_conversion(&calib->Humidity,
+			H0_rH_x2 * ((100 << 16) / 2), H1_rH_x2 * ((100 << 16) / 2), H0_T0_OUT, H1_T0_OUT);
+	hts221_conversion(&calib->Temperature,
+			T0_degC_x8 * ((100 << 16) / 8), T1_degC_x8 * ((100 << 16) / 8), T0_OUT, T1_OUT);
 
 	return DEVICES_OK;
 }
@@ -112,6 +149,14 @@ hts221_setup(HTS221_CtrlReg1TypeDef* config) {
 	return i2c_write8_8(HTS221_ADDRESS_W, HTS221_CTRL_REG_1, ctrl_reg_1);
 }
 
+/**
+ * Start a conversion. DRDY goes high when it is ready to read.
+ */
+Devices_StatusTypeDef
+hts221_start() {
+	return i2c_write8_8(HTS221_ADDRESS_W, HTS221_CTRL_REG_2, HTS221_ONE_SHOT_START);
+}
+
 /**
  * Read the temperature register from the sensor.
  */
@@ -136,6 +181,39 @@ hts221_read_hum() {
 	return buffer;
 }
 
+/**
+ * Read the humidity and temperature registers from the sensor.
+ * The registers are in order, so one auto-incremented read takes both
+ * values from the same conversion.
+ */
+Devices_StatusTypeDef
+hts221_read_sample(HTS221_SampleTypeDef* sample) {
+	uint8_t buffer[4];
+	if (i2c_read8(HTS221_ADDRESS_R, I2C_AAI(HTS221_HUMIDITY_OUT_L), buffer, 4) != DEVICES_OK) {
+		return DEVICES_ERROR;
+	}
+	sample->Humidity = (int16_t)(buffer[0] | (buffer[1] << 8));
+	sample->Temperature = (int16_t)(buffer[2] | (buffer[3] << 8));
+	return DEVICES_OK;
+}
+
+/**
+ * Convert a temperature register value to hundredths of a degree Celsius.
+ */
+int16_t
+hts221_temp_cC(int16_t temp) {
+	return hts221_convert(&hts221_calib.Temperature, temp);
+}
+
+/**
+ * Convert a humidity register value to hundredths of a percent relative
+ * humidity.
+ */
+int16_t
+hts221_hum_crH(int16_t hum) {
+	return hts221_convert(&hts221_calib.Humidity, hum);
+}
+
 /**
  * Read the temperature in degrees Celsius.
  */
@@ -145,11 +223,7 @@ hts221_read_temp_C() {
 	if (temp == INT16_MIN) {
 		return NAN;
 	}
-
-	/* Interpolate the temperature */
-	HTS221_CalibTypeDef* c = &hts221_calib;
-	return c->T0_degC + (float)(c->T1_degC - c->T0_degC) *
-			((float)(temp - c->T0_OUT) / (float)(c->T1_OUT - c->T0_OUT));
+	return hts221_temp_cC(temp) / 100.0f;
 }
 
 /**
@@ -161,9 +235,5 @@ hts221_read_hum_rel() {
 	if (hum == INT16_MIN) {
 		return NAN;
 	}
-
-	/* Interpolate the humidity */
-	HTS221_CalibTypeDef* c = &hts221_calib;
-	return c->H0_rH + (float)(c->H1_rH - c->H0_rH) *
-			((float)(hum - c->H0_T0_OUT) / (float)(c->H1_T0_OUT - c->H0_T0_OUT));
+	return hts221_hum_crH(hum) / 100.0f;
 }
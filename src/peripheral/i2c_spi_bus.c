@@ -3,6 +3,7 @@
 #include <peripheral/hts221.h>
 #include <peripheral/lps331.h>
 #include <peripheral/stlm75.h>
+#include <task/i2c_task.h>
 #include "diag/Trace.h"
 
 SemaphoreHandle_t xSpiSemaphore = NULL;
@@ -119,7 +120,7 @@ spi_write8_8(SPI_HandleTypeDef* hspi, uint8_t address, uint8_t data) {
 /* I2C ---------------------------------------------------------------------- */
 
 /**
- * Setup the I2C peripheral.
+ * Setup the I2C peripheral and the queue of requests for the I2C task.
  */
 void
 i2c_bus_init() {
@@ -128,7 +129,7 @@ i2c_bus_init() {
 	hi2c.Instance = I2C1;
 	hi2c.State = HAL_I2C_STATE_RESET;
 	hi2c.Init.AddressingMode = I2C_ADDRESSINGMODE_7BIT;
-	hi2c.Init.ClockSpeed = 30000;
+	hi2c.Init.ClockSpeed = I2C_CLOCK_DEFAULT;
 	hi2c.Init.DutyCycle = I2C_DUTYCYCLE_2;
 	hi2c.Init.OwnAddress1 = 0;
 	hi2c.Init.DualAddressMode = I2C_DUALADDRESS_DISABLE;
@@ -139,6 +140,8 @@ i2c_bus_init() {
 		trace_printf("HAL I2C setup failed\n");
 		return;
 	}
+
+	xI2cQueue = xQueueCreate(I2C_QUEUE_LENGTH, sizeof(I2C_Request*));
 }
 
 /**
@@ -146,17 +149,9 @@ i2c_bus_init() {
  */
 Devices_StatusTypeDef
 i2c_read8(uint8_t device, uint8_t address, uint8_t* data, uint8_t length) {
-	/* Indicate the start address of the read. */
-	if (HAL_I2C_Master_Transmit(&hi2c, device, &address, 1, 1000) != HAL_OK) {
-		return DEVICES_ERROR;
-	}
-
-	/* Read the desired number of bytes. */
-	if (HAL_I2C_Master_Receive(&hi2c, device, data, length, 1000) != HAL_OK) {
-		return DEVICES_ERROR;
-	}
-
-	return DEVICES_OK;
+	/* Indicate the start address of the read, then read the bytes. */
+	I2C_Transfer transfer = { device, &address, 1, data, length };
+	return i2c_transact(&transfer, 1);
 }
 
 /**
@@ -164,19 +159,10 @@ i2c_read8(uint8_t device, uint8_t address, uint8_t* data, uint8_t length) {
  */
 Devices_StatusTypeDef
 i2c_read16(uint8_t device, uint16_t address, uint8_t* data, uint8_t length) {
-	/* Indicate the start address of the read. */
-	//address = ((address & 0xFF00) >> 8) | ((address & 0xFF) << 8);
-	address = __builtin_bswap16(address);
-	if (HAL_I2C_Master_Transmit(&hi2c, device, (uint8_t*)&address, 2, 1000) != HAL_OK) {
-		return DEVICES_ERROR;
-	}
-
-	/* Read the desired number of bytes. */
-	if (HAL_I2C_Master_Receive(&hi2c, device, data, length, 1000) != HAL_OK) {
-		return DEVICES_ERROR;
-	}
-
-	return DEVICES_OK;
+	/* Indicate the start address of the read, then read the bytes. */
+	uint8_t output[2] = { (address & 0xFF00) >> 8, (address & 0xFF) };
+	I2C_Transfer transfer = { device, output, 2, data, length };
+	return i2c_transact(&transfer, 1);
 }
 
 /**
@@ -186,10 +172,8 @@ Devices_StatusTypeDef
 i2c_write8_8(uint8_t device, uint8_t address, uint8_t data) {
 	/* Write the address and data. */
 	uint8_t buffer[2] = { address, data };
-	if (HAL_I2C_Master_Transmit(&hi2c, device, buffer, 2, 1000) != HAL_OK) {
-		return DEVICES_ERROR;
-	}
-	return DEVICES_OK;
+	I2C_Transfer transfer = { device, buffer, 2, NULL, 0 };
+	return i2c_transact(&transfer, 1);
 }
 
 /**
@@ -199,23 +183,59 @@ Devices_StatusTypeDef
 i2c_write16_8(uint8_t device, uint16_t address, uint8_t data) {
 	/* Write the address and data. */
 	uint8_t output[3] = { (address & 0xFF00) >> 8, (address & 0xFF), data };
-	if (HAL_I2C_Master_Transmit(&hi2c, device, output, 3, 1000) != HAL_OK) {
-		return DEVICES_ERROR;
-	}
-	return DEVICES_OK;
+	I2C_Transfer transfer = { device, output, 3, NULL, 0 };
+	return i2c_transact(&transfer, 1);
 }
 
 /**
  * Helper method to write an array of 8-bit values to 16-bit addresses.
+ * Up to I2C_BATCH_LENGTH writes are queued as one request.
  */
 Devices_StatusTypeDef
 i2c_array16_8(uint8_t device, RegisterTuple16_8* array) {
-	while(array->address != 0xFFFF) {
-		if (i2c_write16_8(device, array->address, array->value) != DEVICES_OK) {
-			return DEVICES_ERROR;
-		}
+	uint8_t output[I2C_BATCH_LENGTH][3];
+	I2C_Transfer batch[I2C_BATCH_LENGTH];
+	uint8_t count = 0;
+
+	while (array->address != 0xFFFF) {
+		output[count][0] = (array->address & 0xFF00) >> 8;
+		output[count][1] = array->address & 0xFF;
+		output[count][2] = array->value;
+		batch[count] = (I2C_Transfer){ device, output[count], 3, NULL, 0 };
 		++array;
+
+		if (++count == I2C_BATCH_LENGTH || array->address == 0xFFFF) {
+			if (i2c_transact(batch, count) != DEVICES_OK) {
+				return DEVICES_ERROR;
+			}
+			count = 0;
+		}
 	}
 	return DEVICES_OK;
 }
 
+/**
+ * Helper method to write a table of register runs to 16-bit addresses.
+ * Each run is sent as a single write, relying on the device to increment
+ * the register address after each value, and up to I2C_BATCH_LENGTH runs
+ * are queued as one request.
+ */
+Devices_StatusTypeDef
+i2c_runs16_8(uint8_t device, const uint8_t* table) {
+	I2C_Transfer batch[I2C_BATCH_LENGTH];
+	uint8_t count = 0;
+
+	while (*table != REGISTER_END) {
+		uint8_t length = *table++;
+		batch[count++] = (I2C_Transfer){ device, table, 2 + length, NULL, 0 };
+		table += 2 + length;
+
+		if (count == I2C_BATCH_LENGTH || *table == REGISTER_END) {
+			if (i2c_transact(batch, count) != DEVICES_OK) {
+				return DEVICES_ERROR;
+			}
+			count = 0;
+		}
+	}
+	return DEVICES_OK;
+}
@@ -33,14 +33,17 @@ lps331_init() {
 		goto not_ready;
 	}
 
-	/* Configure the data rate and power status. */
+	/* Convert only when started, and signal each result on INT1. */
 	LPS331_CtrlReg1TypeDef lps331_ctrl1 = { 0 };
 	lps331_ctrl1.PowerDown = LPS331_POWER_UP;
-	lps331_ctrl1.OutputDataRate = LPS331_RATE_1_1;
+	lps331_ctrl1.OutputDataRate = LPS331_ONE_SHOT;
 	lps331_ctrl1.BlockDataUpdate = LPS331_BDU_ENABLE;
 	if (lps331_setup(&lps331_ctrl1) != DEVICES_OK) {
 		goto not_ready;
 	}
+	if (i2c_write8_8(LPS331_ADDRESS, LPS331_CTRL_REG_3, LPS331_INT1_DRDY) != DEVICES_OK) {
+		goto not_ready;
+	}
 
 	trace_printf("lps331: ready\n");
 	return 1;
@@ -84,6 +87,14 @@ lps331_setup(LPS331_CtrlReg1TypeDef* config) {
 	return i2c_write8_8(LPS331_ADDRESS, LPS331_CTRL_REG_1, ctrl_reg_1);
 }
 
+/**
+ * Start a conversion. INT1 goes high when it is ready to read.
+ */
+Devices_StatusTypeDef
+lps331_start() {
+	return i2c_write8_8(LPS331_ADDRESS, LPS331_CTRL_REG_2, LPS331_ONE_SHOT_START);
+}
+
 /**
  * Read the temperature register from the sensor.
  */
@@ -108,6 +119,38 @@ lps331_read_pres() {
 	return buffer;
 }
 
+/**
+ * Read the pressure and temperature registers from the sensor.
+ * The registers are in order, so one auto-incremented read takes both
+ * values from the same conversion.
+ */
+Devices_StatusTypeDef
+lps331_read_sample(LPS331_SampleTypeDef* sample) {
+	uint8_t buffer[5];
+	if (i2c_read8(LPS331_ADDRESS, I2C_AAI(LPS331_PRESS_OUT_XL), buffer, 5) != DEVICES_OK) {
+		return DEVICES_ERROR;
+	}
+	sample->Pressure = buffer[0] | (buffer[1] << 8) | ((int32_t)buffer[2] << 16);
+	sample->Temperature = (int16_t)(buffer[3] | (buffer[4] << 8));
+	return DEVICES_OK;
+}
+
+/**
+ * Convert a temperature register value to hundredths of a degree Celsius.
+ */
+int16_t
+lps331_temp_cC(int16_t value) {
+	return LPS331_TEMP_OFFSET_cC + ((value * LPS331_TEMP_SLOPE_Q16 + (1 << 15)) >> 16);
+}
+
+/**
+ * Convert a pressure register value to pascals.
+ */
+int32_t
+lps331_pres_Pa(int32_t value) {
+	return (value * 25 + (1 << 9)) >> 10;
+}
+
 /**
  * Read the temperature in degrees Celsius.
  */
@@ -117,8 +160,7 @@ lps331_read_temp_C() {
 	if (value == INT16_MIN) {
 		return NAN;
 	}
-	return 42.5 + ((float)value / 480.0);
-
+	return lps331_temp_cC(value) / 100.0f;
 }
 
 /**
@@ -130,5 +172,5 @@ lps331_read_pres_mbar() {
 	if (value == INT32_MIN) {
 		return NAN;
 	}
-	return (float)value / 4096.0;
+	return lps331_pres_Pa(value) / 100.0f;
 }
@@ -0,0 +1,904 @@
+#include <ring_log.h>
+#include <stddef.h>
+#include <string.h>
+
+#ifndef MIN
+#define MIN(a,b) ((a)<(b)?(a):(b))
+#endif
+
+/* Identifies a record header in the data area. */
+#define RLOG_RECORD_MAGIC 0x5247
+
+/* Identifies a checkpoint sector, and its layout version. */
+#define RLOG_CHECKPOINT_MAGIC   0x474F4C52
+#define RLOG_CHECKPOINT_VERSION 2
+
+/* Sectors reserved at the start of the container for checkpoints. */
+#define RLOG_CHECKPOINT_SECTORS 2
+
+/* Time index slots held in one sector. */
+#define RLOG_INDEX_PER_SECTOR (F_SECTOR_SIZE / sizeof(RingIndexEntry))
+
+/* No data area sector is held in a buffer. */
+#define RLOG_NO_SECTOR 0xFFFFFFFF
+
+/* Head and tail state saved in the checkpoint sectors. */
+typedef struct _RingCheckpoint {
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t Capacity;
+	uint32_t Generation;
+	uint32_t Head;
+	uint32_t HeadSequence;
+	uint32_t Tail;
+	uint32_t TailSequence;
+	uint32_t Crc;
+} RingCheckpoint;
+
+/* CRC-32 (reflected 0xEDB88320) four bits at a time. */
+static const uint32_t crc32_nibble[16] = {
+	0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+	0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+	0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+	0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+/**
+ * Update a running CRC-32. Start with 0xFFFFFFFF and invert the result.
+ */
+uint32_t
+rlog_crc32(uint32_t crc, const void* data, uint32_t length) {
+	const uint8_t* p = (const uint8_t*)data;
+	while (length--) {
+		crc ^= *p++;
+		crc = (crc >> 4) ^ crc32_nibble[crc & 0x0F];
+		crc = (crc >> 4) ^ crc32_nibble[crc & 0x0F];
+	}
+	return crc;
+}
+
+/**
+ * Translate a sector of the container file to a volume sector.
+ */
+static uint8_t
+rlog_physical(RingLog* log, uint32_t sector, unsigned long* physical) {
+	for (uint8_t i = 0; i < log->ExtentCount; ++i) {
+		if (sector < log->Extents[i].count) {
+			*physical = log->Extents[i].sector + sector;
+			return RLOG_OK;
+		}
+		sector -= log->Extents[i].count;
+	}
+	return RLOG_ERROR;
+}
+
+/**
+ * Read or write a sector of the container file, bypassing the file system.
+ */
+static uint8_t
+rlog_readsector(RingLog* log, uint32_t sector, uint8_t* buffer) {
+	unsigned long physical;
+	if (   rlog_physical(log, sector, &physical) != RLOG_OK
+		|| f_readsector(buffer, physical) != F_NO_ERROR) {
+		return RLOG_ERROR;
+	}
+	return RLOG_OK;
+}
+
+static uint8_t
+rlog_writesector(RingLog* log, uint32_t sector, uint8_t* buffer) {
+	unsigned long physical;
+	if (   rlog_physical(log, sector, &physical) != RLOG_OK
+		|| f_writesector(buffer, physical) != F_NO_ERROR) {
+		return RLOG_ERROR;
+	}
+	return RLOG_OK;
+}
+
+/**
+ * Fetch a container sector into the read cache.
+ */
+static uint8_t
+rlog_readcached(RingLog* log, uint32_t sector) {
+	if (sector != log->ScratchSector) {
+		log->ScratchSector = RLOG_NO_SECTOR;
+		if (rlog_readsector(log, sector, log->Scratch) != RLOG_OK) {
+			return RLOG_ERROR;
+		}
+		log->ScratchSector = sector;
+	}
+	return RLOG_OK;
+}
+
+/**
+ * Write a data area sector, keeping the read cache coherent.
+ */
+static uint8_t
+rlog_writedata(RingLog* log, uint32_t sector, uint8_t* buffer) {
+	sector += log->DataSector;
+	if (sector == log->ScratchSector && buffer != log->Scratch) {
+		log->ScratchSector = RLOG_NO_SECTOR;
+	}
+	return rlog_writesector(log, sector, buffer);
+}
+
+/**
+ * Fetch a data area sector into the read cache.
+ */
+static uint8_t
+rlog_readdata(RingLog* log, uint32_t sector) {
+	return rlog_readcached(log, log->DataSector + sector);
+}
+
+/**
+ * Write the time index sector being filled, if it has changed.
+ */
+static uint8_t
+rlog_flushindex(RingLog* log) {
+	if (log->IndexDirty) {
+		if (log->IndexSector == log->ScratchSector) {
+			log->ScratchSector = RLOG_NO_SECTOR;
+		}
+		if (rlog_writesector(log, log->IndexSector, log->IndexBuffer) != RLOG_OK) {
+			return RLOG_ERROR;
+		}
+		log->IndexDirty = 0;
+	}
+	return RLOG_OK;
+}
+
+/**
+ * Point the time index slot for a block at the current record.
+ */
+static uint8_t
+rlog_setindex(RingLog* log, uint32_t block) {
+	uint32_t sector = RLOG_CHECKPOINT_SECTORS + block / RLOG_INDEX_PER_SECTOR;
+	if (sector != log->IndexSector) {
+		if (rlog_flushindex(log) != RLOG_OK) {
+			return RLOG_ERROR;
+		}
+		log->IndexSector = RLOG_NO_SECTOR;
+		if (rlog_readsector(log, sector, log->IndexBuffer) != RLOG_OK) {
+			return RLOG_ERROR;
+		}
+		log->IndexSector = sector;
+	}
+	memcpy(log->IndexBuffer + (block % RLOG_INDEX_PER_SECTOR) * sizeof(RingIndexEntry),
+			&log->Current, sizeof(RingIndexEntry));
+	log->IndexDirty = 1;
+	return RLOG_OK;
+}
+
+/**
+ * Point the time index slots for the blocks that start within length bytes
+ * of an offset at the current record.
+ */
+static uint8_t
+rlog_setindexes(RingLog* log, uint32_t offset, uint32_t length) {
+	uint32_t block = (offset + RLOG_INDEX_BLOCK - 1) / RLOG_INDEX_BLOCK;
+	for (uint32_t i = 0; i < log->IndexSlots; ++i, ++block) {
+		block %= log->IndexSlots;
+		if ((block * RLOG_INDEX_BLOCK - offset + log->Capacity) % log->Capacity >= length) {
+			break;
+		}
+		if (rlog_setindex(log, block) != RLOG_OK) {
+			return RLOG_ERROR;
+		}
+	}
+	return RLOG_OK;
+}
+
+/**
+ * Read a time index slot.
+ */
+static uint8_t
+rlog_getindex(RingLog* log, uint32_t block, RingIndexEntry* entry) {
+	uint32_t sector = RLOG_CHECKPOINT_SECTORS + block / RLOG_INDEX_PER_SECTOR;
+	uint8_t* buffer = log->IndexBuffer;
+	if (sector != log->IndexSector) {
+		if (rlog_readcached(log, sector) != RLOG_OK) {
+			return RLOG_ERROR;
+		}
+		buffer = log->Scratch;
+	}
+	memcpy(entry, buffer + (block % RLOG_INDEX_PER_SECTOR) * sizeof(RingIndexEntry),
+			sizeof(RingIndexEntry));
+	return RLOG_OK;
+}
+
+/**
+ * Round an offset up to where the next record header may start.
+ * Headers are word aligned and never straddle a sector.
+ */
+static uint32_t
+rlog_align(RingLog* log, uint32_t offset) {
+	offset = (offset + 3) & ~3UL;
+	uint32_t room = F_SECTOR_SIZE - (offset % F_SECTOR_SIZE);
+	if (room < sizeof(RingRecordHeader)) {
+		offset += room;
+	}
+	return offset % log->Capacity;
+}
+
+/**
+ * Copy bytes out of the data area, wrapping at the end.
+ * The head sector is served from the write buffer.
+ */
+static uint8_t
+rlog_get(RingLog* log, uint32_t offset, void* data, uint32_t length) {
+	uint8_t* p = (uint8_t*)data;
+	while (length > 0) {
+		uint32_t sector = offset / F_SECTOR_SIZE;
+		uint32_t start = offset % F_SECTOR_SIZE;
+		uint32_t count = MIN(length, F_SECTOR_SIZE - start);
+
+		if (sector == log->BufferSector) {
+			memcpy(p, log->Buffer + start, count);
+		} else {
+			if (rlog_readdata(log, sector) != RLOG_OK) {
+				return RLOG_ERROR;
+			}
+			memcpy(p, log->Scratch + start, count);
+		}
+
+		p += count;
+		length -= count;
+		offset = (offset + count) % log->Capacity;
+	}
+	return RLOG_OK;
+}
+
+/**
+ * Load the head sector into the write buffer, dropping anything past the head.
+ * When the tail sits further on in the same sector its records are kept,
+ * since the whole buffer is written back each time.
+ */
+static uint8_t
+rlog_loadhead(RingLog* log) {
+	uint32_t sector = log->Head / F_SECTOR_SIZE;
+	uint32_t start = log->Head % F_SECTOR_SIZE;
+	uint32_t end = F_SECTOR_SIZE;
+	if (log->Tail > log->Head && log->Tail / F_SECTOR_SIZE == sector) {
+		end = log->Tail % F_SECTOR_SIZE;
+	}
+
+	if (sector != log->BufferSector) {
+		log->BufferSector = RLOG_NO_SECTOR;
+		if (start != 0 || end != F_SECTOR_SIZE) {
+			/* Any sector behind the buffer was written out when it filled. */
+			if (rlog_readdata(log, sector) != RLOG_OK) {
+				return RLOG_ERROR;
+			}
+			memcpy(log->Buffer, log->Scratch, F_SECTOR_SIZE);
+		}
+		log->BufferSector = sector;
+	}
+	memset(log->Buffer + start, 0, end - start);
+	return RLOG_OK;
+}
+
+/**
+ * Copy bytes into the head sector, writing it out when it fills.
+ */
+static uint8_t
+rlog_put(RingLog* log, const void* data, uint32_t length) {
+	const uint8_t* p = (const uint8_t*)data;
+
+	/* Never let the head catch up with the tail. */
+	if (length >= log->Capacity - rlog_used(log)) {
+		return RLOG_FULL;
+	}
+
+	while (length > 0) {
+		uint32_t start = log->Head % F_SECTOR_SIZE;
+		uint32_t count = MIN(length, F_SECTOR_SIZE - start);
+
+		/* Entering a new block - index the record it starts in. */
+		if (   log->Head % RLOG_INDEX_BLOCK == 0
+			&& rlog_setindex(log, log->Head / RLOG_INDEX_BLOCK) != RLOG_OK) {
+			return RLOG_ERROR;
+		}
+
+		/* Whole sectors from the caller go straight to the card. */
+		if (start == 0 && count == F_SECTOR_SIZE && p != NULL) {
+			if (rlog_writedata(log, log->Head / F_SECTOR_SIZE, (uint8_t*)p) != RLOG_OK) {
+				return RLOG_ERROR;
+			}
+			p += count;
+			length -= count;
+			log->Head = (log->Head + count) % log->Capacity;
+			log->BufferSector = RLOG_NO_SECTOR;
+			continue;
+		}
+		if (log->BufferSector == RLOG_NO_SECTOR && rlog_loadhead(log) != RLOG_OK) {
+			return RLOG_ERROR;
+		}
+
+		if (p != NULL) {
+			memcpy(log->Buffer + start, p, count);
+			p += count;
+		} else {
+			memset(log->Buffer + start, 0, count);
+		}
+		length -= count;
+		log->Head += count;
+
+		if (log->Head % F_SECTOR_SIZE == 0) {
+			if (rlog_writedata(log, log->BufferSector, log->Buffer) != RLOG_OK) {
+				return RLOG_ERROR;
+			}
+			log->Head %= log->Capacity;
+			if (rlog_loadhead(log) != RLOG_OK) {
+				return RLOG_ERROR;
+			}
+		}
+	}
+	if (log->BufferSector == RLOG_NO_SECTOR) {
+		return rlog_loadhead(log);
+	}
+	return RLOG_OK;
+}
+
+/**
+ * Check the record header at or just after the given offset.
+ * Zero padding in front of a sector aligned record is skipped and the
+ * offset updated. The payload CRC is only verified if requested.
+ */
+static uint8_t
+rlog_check(RingLog* log, uint32_t* offsetp, uint32_t sequence, RingRecordHeader* header, uint8_t verify) {
+	uint32_t offset = *offsetp;
+	for (uint32_t skipped = 0; ; skipped += 4) {
+		if (rlog_get(log, offset, header, sizeof(RingRecordHeader)) != RLOG_OK) {
+			return RLOG_ERROR;
+		}
+		if (header->Magic != 0 || skipped >= F_SECTOR_SIZE) {
+			break;
+		}
+		offset = rlog_align(log, offset + 4);
+	}
+	*offsetp = offset;
+	if (   header->Magic != RLOG_RECORD_MAGIC
+		|| header->Sequence != sequence
+		|| header->Length >= log->Capacity - sizeof(RingRecordHeader)) {
+		return RLOG_ERROR;
+	}
+	if (!verify) {
+		return RLOG_OK;
+	}
+
+	/* CRC covers the payload, then the header with a zero CRC field. */
+	uint32_t crc = 0xFFFFFFFF;
+	uint32_t position = (offset + sizeof(RingRecordHeader)) % log->Capacity;
+	uint32_t remaining = header->Length;
+	uint8_t chunk[64];
+	while (remaining > 0) {
+		uint32_t count = MIN(remaining, sizeof(chunk));
+		if (rlog_get(log, position, chunk, count) != RLOG_OK) {
+			return RLOG_ERROR;
+		}
+		crc = rlog_crc32(crc, chunk, count);
+		position = (position + count) % log->Capacity;
+		remaining -= count;
+	}
+	RingRecordHeader copy = *header;
+	copy.Crc = 0;
+	crc = ~rlog_crc32(crc, &copy, sizeof(copy));
+
+	return (crc == header->Crc) ? RLOG_OK : RLOG_ERROR;
+}
+
+/**
+ * Read the newest valid checkpoint.
+ */
+static uint8_t
+rlog_loadcheckpoint(RingLog* log) {
+	uint8_t found = 0;
+	for (uint32_t i = 0; i < RLOG_CHECKPOINT_SECTORS; ++i) {
+		RingCheckpoint checkpoint;
+		if (rlog_readsector(log, i, log->Scratch) != RLOG_OK) {
+			continue;
+		}
+		memcpy(&checkpoint, log->Scratch, sizeof(checkpoint));
+		if (   checkpoint.Magic != RLOG_CHECKPOINT_MAGIC
+			|| checkpoint.Version != RLOG_CHECKPOINT_VERSION
+			|| checkpoint.Capacity != log->Capacity
+			|| checkpoint.Head >= log->Capacity
+			|| checkpoint.Tail >= log->Capacity
+			|| ~rlog_crc32(0xFFFFFFFF, &checkpoint, offsetof(RingCheckpoint, Crc)) != checkpoint.Crc) {
+			continue;
+		}
+		if (!found || (int32_t)(checkpoint.Generation - log->Generation) > 0) {
+			log->Generation = checkpoint.Generation;
+			log->Head = checkpoint.Head;
+			log->HeadSequence = checkpoint.HeadSequence;
+			log->Tail = checkpoint.Tail;
+			log->TailSequence = checkpoint.TailSequence;
+			found = 1;
+		}
+	}
+	log->ScratchSector = RLOG_NO_SECTOR;
+	return found ? RLOG_OK : RLOG_ERROR;
+}
+
+/**
+ * Move the head past any complete records written after the last checkpoint.
+ */
+static uint8_t
+rlog_recover(RingLog* log) {
+	RingRecordHeader header;
+	for (;;) {
+		uint32_t offset = rlog_align(log, log->Head);
+		if (rlog_check(log, &offset, log->HeadSequence, &header, 1) != RLOG_OK) {
+			break;
+		}
+
+		/* The record must fit in the free space or it is from an older lap. */
+		uint32_t end = (offset + sizeof(RingRecordHeader) + header.Length) % log->Capacity;
+		uint32_t size = (end - log->Head + log->Capacity) % log->Capacity;
+		if (size == 0 || size >= log->Capacity - rlog_used(log)) {
+			break;
+		}
+
+		/* Rebuild index slots for the blocks this record covers. */
+		log->Current.TickCount = header.TickCount;
+		log->Current.Offset = offset;
+		log->Current.Sequence = header.Sequence;
+		if (rlog_setindexes(log, log->Head, size) != RLOG_OK) {
+			return RLOG_ERROR;
+		}
+
+		log->Head = end;
+		log->HeadSequence++;
+	}
+	return rlog_loadhead(log);
+}
+
+/**
+ * Open the container file, creating and preallocating it if it does not
+ * exist at the requested size. The volume must already be mounted.
+ */
+uint8_t
+rlog_open(RingLog* log, const char* name, uint32_t sectors) {
+	memset(log, 0, sizeof(RingLog));
+	log->BufferSector = RLOG_NO_SECTOR;
+	log->ScratchSector = RLOG_NO_SECTOR;
+	log->IndexSector = RLOG_NO_SECTOR;
+
+	/* Split the container between the time index and the data area. */
+	if (sectors <= RLOG_CHECKPOINT_SECTORS) {
+		return RLOG_ERROR;
+	}
+	uint32_t available = sectors - RLOG_CHECKPOINT_SECTORS;
+	uint32_t blocks = (available + RLOG_INDEX_BLOCK / F_SECTOR_SIZE - 1) / (RLOG_INDEX_BLOCK / F_SECTOR_SIZE);
+	uint32_t indexSectors = (blocks + RLOG_INDEX_PER_SECTOR - 1) / RLOG_INDEX_PER_SECTOR;
+	if (available <= indexSectors) {
+		return RLOG_ERROR;
+	}
+	log->DataSector = RLOG_CHECKPOINT_SECTORS + indexSectors;
+	log->Capacity = (available - indexSectors) * F_SECTOR_SIZE;
+	log->IndexSlots = (log->Capacity + RLOG_INDEX_BLOCK - 1) / RLOG_INDEX_BLOCK;
+
+	/* Create the container once; seeking past the end zero-fills it. */
+	uint8_t created = 0;
+	long size = (long)sectors * F_SECTOR_SIZE;
+	if (f_filelength(name) != size) {
+		(void)f_delete(name);
+		F_FILE* pxFile = f_open(name, "w");
+		if (pxFile == NULL) {
+			return RLOG_ERROR;
+		}
+		unsigned char result = f_seek(pxFile, size, F_SEEK_SET);
+		if (f_close(pxFile) != F_NO_ERROR || result != F_NO_ERROR) {
+			return RLOG_ERROR;
+		}
+		created = 1;
+	}
+
+	/* Locate the sectors of the container. */
+	unsigned char count;
+	if (f_getextents(name, log->Extents, RLOG_MAX_EXTENTS, &count) != F_NO_ERROR) {
+		return RLOG_ERROR;
+	}
+	log->ExtentCount = count;
+	log->Mounted = 1;
+
+	if (created || rlog_loadcheckpoint(log) != RLOG_OK) {
+		log->Head = log->Tail = 0;
+		log->HeadSequence = log->TailSequence = 1;
+		if (rlog_loadhead(log) != RLOG_OK) {
+			return RLOG_ERROR;
+		}
+		return rlog_checkpoint(log);
+	}
+	return rlog_recover(log);
+}
+
+/**
+ * Discard every record in the log.
+ * Sequence numbers keep counting so stale records are never revived.
+ */
+uint8_t
+rlog_reset(RingLog* log) {
+	if (log->Writing) {
+		rlog_abort(log);
+	}
+	log->Tail = log->Head;
+	log->TailSequence = log->HeadSequence;
+	return rlog_checkpoint(log);
+}
+
+/**
+ * Save the head and tail to the older checkpoint sector.
+ * Pending head data and index slots are flushed first so the checkpoint
+ * never points past them.
+ */
+uint8_t
+rlog_checkpoint(RingLog* log) {
+	if (   rlog_flush(log)      != RLOG_OK
+		|| rlog_flushindex(log) != RLOG_OK) {
+		return RLOG_ERROR;
+	}
+
+	RingCheckpoint checkpoint;
+	checkpoint.Magic = RLOG_CHECKPOINT_MAGIC;
+	checkpoint.Version = RLOG_CHECKPOINT_VERSION;
+	checkpoint.Capacity = log->Capacity;
+	checkpoint.Generation = log->Generation + 1;
+	checkpoint.Head = log->Writing ? log->Record : log->Head;
+	checkpoint.HeadSequence = log->HeadSequence;
+	checkpoint.Tail = log->Tail;
+	checkpoint.TailSequence = log->TailSequence;
+	checkpoint.Crc = ~rlog_crc32(0xFFFFFFFF, &checkpoint, offsetof(RingCheckpoint, Crc));
+
+	log->ScratchSector = RLOG_NO_SECTOR;
+	memset(log->Scratch, 0, F_SECTOR_SIZE);
+	memcpy(log->Scratch, &checkpoint, sizeof(checkpoint));
+	if (rlog_writesector(log, checkpoint.Generation % RLOG_CHECKPOINT_SECTORS, log->Scratch) != RLOG_OK) {
+		return RLOG_ERROR;
+	}
+	log->Generation = checkpoint.Generation;
+	return RLOG_OK;
+}
+
+/**
+ * Write the partially filled head sector to the card.
+ */
+uint8_t
+rlog_flush(RingLog* log) {
+	if (!log->Mounted) {
+		return RLOG_ERROR;
+	}
+	if (log->Head % F_SECTOR_SIZE == 0) {
+		/* Nothing in the buffer yet. */
+		return RLOG_OK;
+	}
+	return rlog_writedata(log, log->BufferSector, log->Buffer);
+}
+
+/**
+ * Number of bytes in use between the tail and the head.
+ */
+uint32_t
+rlog_used(RingLog* log) {
+	return (log->Head - log->Tail + log->Capacity) % log->Capacity;
+}
+
+/**
+ * Start a new record with its header at the given offset.
+ * The header is written as zeros and filled in by rlog_end().
+ */
+static uint8_t
+rlog_start(RingLog* log, uint8_t type, uint8_t flags, uint32_t tickCount, uint32_t offset) {
+	/* Pad to the header position. */
+	uint32_t start = log->Head;
+	log->Start = start;
+	log->Current.TickCount = tickCount;
+	log->Current.Offset = offset;
+	log->Current.Sequence = log->HeadSequence;
+	uint32_t pad = (offset - log->Head + log->Capacity) % log->Capacity;
+	uint8_t result = rlog_put(log, NULL, pad);
+	if (result == RLOG_OK) {
+		log->Record = log->Head;
+		result = rlog_put(log, NULL, sizeof(RingRecordHeader));
+	}
+	if (result != RLOG_OK) {
+		log->Head = start;
+		rlog_loadhead(log);
+		return result;
+	}
+
+	memset(&log->Open, 0, sizeof(RingRecordHeader));
+	log->Open.Magic = RLOG_RECORD_MAGIC;
+	log->Open.Type = type;
+	log->Open.Flags = flags;
+	log->Open.Sequence = log->HeadSequence;
+	log->Open.TickCount = tickCount;
+	log->RecordCrc = 0xFFFFFFFF;
+	log->Writing = 1;
+	return RLOG_OK;
+}
+
+/**
+ * Start a new record at the head.
+ */
+uint8_t
+rlog_begin(RingLog* log, uint8_t type, uint32_t tickCount) {
+	if (!log->Mounted || log->Writing) {
+		return RLOG_ERROR;
+	}
+	return rlog_start(log, type, 0, tickCount, rlog_align(log, log->Head));
+}
+
+/**
+ * Start a new record whose payload, after the first lead bytes, begins on
+ * a sector boundary. Whole sectors passed to rlog_write() then go to the
+ * card without a copy. The lead is a multiple of four and leaves room for
+ * the header in the sector before.
+ */
+uint8_t
+rlog_begin_aligned(RingLog* log, uint8_t type, uint32_t tickCount, uint32_t lead) {
+	if (   !log->Mounted || log->Writing
+		|| lead % 4 != 0 || lead > F_SECTOR_SIZE - sizeof(RingRecordHeader)) {
+		return RLOG_ERROR;
+	}
+	uint32_t offset = rlog_align(log, log->Head) + sizeof(RingRecordHeader) + lead;
+	offset = (offset + F_SECTOR_SIZE - 1) / F_SECTOR_SIZE * F_SECTOR_SIZE - lead;
+	return rlog_start(log, type, RLOG_FLAG_ALIGNED, tickCount, offset - sizeof(RingRecordHeader));
+}
+
+/**
+ * Append payload bytes to the open record.
+ * On RLOG_FULL the record is abandoned and the head is rolled back.
+ */
+uint8_t
+rlog_write(RingLog* log, const void* data, uint32_t length) {
+	if (!log->Writing) {
+		return RLOG_ERROR;
+	}
+	uint8_t result = rlog_put(log, data, length);
+	if (result != RLOG_OK) {
+		rlog_abort(log);
+		return result;
+	}
+	log->RecordCrc = rlog_crc32(log->RecordCrc, data, length);
+	log->Open.Length += length;
+	return RLOG_OK;
+}
+
+/**
+ * Complete the open record by filling in its header.
+ */
+uint8_t
+rlog_end(RingLog* log) {
+	if (!log->Writing) {
+		return RLOG_ERROR;
+	}
+
+	log->Open.Crc = 0;
+	log->Open.Crc = ~rlog_crc32(log->RecordCrc, &log->Open, sizeof(RingRecordHeader));
+
+	uint32_t sector = log->Record / F_SECTOR_SIZE;
+	uint32_t start = log->Record % F_SECTOR_SIZE;
+	if (sector == log->BufferSector) {
+		memcpy(log->Buffer + start, &log->Open, sizeof(RingRecordHeader));
+	} else {
+		/* The header sector has already gone out; patch it in place. */
+		if (rlog_readdata(log, sector) != RLOG_OK) {
+			rlog_abort(log);
+			return RLOG_ERROR;
+		}
+		memcpy(log->Scratch + start, &log->Open, sizeof(RingRecordHeader));
+		if (rlog_writedata(log, sector, log->Scratch) != RLOG_OK) {
+			log->ScratchSector = RLOG_NO_SECTOR;
+			rlog_abort(log);
+			return RLOG_ERROR;
+		}
+	}
+
+	log->HeadSequence++;
+	log->Writing = 0;
+	return RLOG_OK;
+}
+
+/**
+ * Abandon the open record and move the head back to where it started.
+ * The index slots the record filled are cleared. Left naming it, they
+ * would pass for the next record, which takes the same sequence number,
+ * and sit past the head where rlog_seek() expects overwritten slots.
+ */
+uint8_t
+rlog_abort(RingLog* log) {
+	if (!log->Writing) {
+		return RLOG_ERROR;
+	}
+	log->Writing = 0;
+	uint32_t length = (log->Head - log->Start + log->Capacity) % log->Capacity;
+	log->Head = log->Start;
+	memset(&log->Current, 0, sizeof(RingIndexEntry));
+	uint8_t result = rlog_setindexes(log, log->Start, length);
+	if (rlog_loadhead(log) != RLOG_OK) {
+		return RLOG_ERROR;
+	}
+	return result;
+}
+
+/**
+ * Append a complete record.
+ */
+uint8_t
+rlog_append(RingLog* log, uint8_t type, uint32_t tickCount, const void* data, uint32_t length) {
+	uint8_t result;
+	if (   (result = rlog_begin(log, type, tickCount)) != RLOG_OK
+		|| (result = rlog_write(log, data, length))    != RLOG_OK) {
+		return result;
+	}
+	return rlog_end(log);
+}
+
+/**
+ * Position a cursor at the oldest record.
+ */
+void
+rlog_cursor(RingLog* log, RingCursor* cursor) {
+	cursor->Offset = log->Tail;
+	cursor->Sequence = log->TailSequence;
+}
+
+/**
+ * Read the header of the record at the cursor and advance past it.
+ * Returns RLOG_EMPTY once the cursor reaches the last completed record.
+ */
+uint8_t
+rlog_next(RingLog* log, RingCursor* cursor, RingRecord* record) {
+	if (!log->Mounted) {
+		return RLOG_ERROR;
+	}
+	if (cursor->Sequence == log->HeadSequence) {
+		return RLOG_EMPTY;
+	}
+
+	uint32_t offset = rlog_align(log, cursor->Offset);
+	if (rlog_check(log, &offset, cursor->Sequence, &record->Header, 0) != RLOG_OK) {
+		return RLOG_ERROR;
+	}
+	record->Offset = (offset + sizeof(RingRecordHeader)) % log->Capacity;
+	cursor->Offset = (record->Offset + record->Header.Length) % log->Capacity;
+	cursor->Sequence++;
+	return RLOG_OK;
+}
+
+/**
+ * Copy part of a record payload.
+ */
+uint8_t
+rlog_read(RingLog* log, RingRecord* record, uint32_t offset, void* data, uint32_t length) {
+	if (offset > record->Header.Length || length > record->Header.Length - offset) {
+		return RLOG_ERROR;
+	}
+	return rlog_get(log, (record->Offset + offset) % log->Capacity, data, length);
+}
+
+/**
+ * Release every record before the cursor and save the new tail.
+ */
+uint8_t
+rlog_consume(RingLog* log, RingCursor* cursor) {
+	if (!log->Mounted) {
+		return RLOG_ERROR;
+	}
+	log->Tail = cursor->Offset;
+	log->TailSequence = cursor->Sequence;
+	return rlog_checkpoint(log);
+}
+
+/**
+ * Check whether a time index slot names a record that can still be read.
+ * Slots for the open record are accepted; they sort after everything else.
+ */
+static uint8_t
+rlog_validindex(RingLog* log, RingIndexEntry* entry) {
+	RingRecordHeader header;
+	uint32_t offset = entry->Offset;
+	if (entry->Sequence == 0 || entry->Offset >= log->Capacity) {
+		return 0;
+	}
+	if (entry->Sequence == log->HeadSequence) {
+		return 1;
+	}
+	return (int32_t)(entry->Sequence - log->HeadSequence) < 0
+		&& rlog_check(log, &offset, entry->Sequence, &header, 0) == RLOG_OK;
+}
+
+/**
+ * Position a cursor at the first record stamped at or after the given tick.
+ * The search covers records already consumed that have not been overwritten,
+ * so rlog_consume() with the result rewinds the tail for a re-upload.
+ * Returns RLOG_EMPTY if no record is that recent.
+ */
+uint8_t
+rlog_seek(RingLog* log, uint32_t tickCount, RingCursor* cursor) {
+	if (!log->Mounted) {
+		return RLOG_ERROR;
+	}
+
+	/* Slots in ring order, oldest first, start after the head block. */
+	RingIndexEntry entry;
+	uint32_t base = log->Head / RLOG_INDEX_BLOCK + 1;
+	uint32_t lo = 0, hi = log->IndexSlots - 1;
+
+	/* Slots whose record has been overwritten all come first. */
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+		if (rlog_getindex(log, (base + mid) % log->IndexSlots, &entry) != RLOG_OK) {
+			return RLOG_ERROR;
+		}
+		if (rlog_validindex(log, &entry)) {
+			hi = mid;
+		} else {
+			lo = mid + 1;
+		}
+	}
+
+	/* Find the last slot stamped before the tick. */
+	rlog_cursor(log, cursor);
+	uint32_t first = lo;
+	hi = log->IndexSlots;
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+		if (rlog_getindex(log, (base + mid) % log->IndexSlots, &entry) != RLOG_OK) {
+			return RLOG_ERROR;
+		}
+		if (   entry.Sequence != log->HeadSequence
+			&& (int32_t)(entry.TickCount - tickCount) < 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	uint32_t slot = (lo > first) ? lo - 1 : first;
+	if (rlog_getindex(log, (base + slot) % log->IndexSlots, &entry) != RLOG_OK) {
+		return RLOG_ERROR;
+	}
+
+	/* When the log is near full the slot covering the tail may have been
+	   overwritten, and the first valid slot name a record past the tail.
+	   The live records before it are found from the tail. */
+	if (   rlog_validindex(log, &entry) && entry.Sequence != log->HeadSequence
+		&& (lo > first || (int32_t)(entry.Sequence - log->TailSequence) < 0)) {
+		cursor->Offset = entry.Offset;
+		cursor->Sequence = entry.Sequence;
+	}
+
+	/* Walk forward to the exact record. */
+	RingRecord record;
+	for (;;) {
+		RingCursor next = *cursor;
+		uint8_t result = rlog_next(log, &next, &record);
+		if (result != RLOG_OK) {
+			return result;
+		}
+		if ((int32_t)(record.Header.TickCount - tickCount) >= 0) {
+			return RLOG_OK;
+		}
+		*cursor = next;
+	}
+}
+
+/**
+ * Move the tail back to the first record stamped at or after the given
+ * tick, so that records already consumed are read again. Records since
+ * overwritten are gone, and the tail never moves forward past records
+ * not yet consumed. Returns RLOG_EMPTY if the tail is left where it was.
+ */
+uint8_t
+rlog_rewind(RingLog* log, uint32_t tickCount) {
+	RingCursor cursor;
+	uint8_t result = rlog_seek(log, tickCount, &cursor);
+	if (result != RLOG_OK) {
+		return result;
+	}
+	if ((int32_t)(cursor.Sequence - log->TailSequence) >= 0) {
+		return RLOG_EMPTY;
+	}
+	return rlog_consume(log, &cursor);
+}
@@ -0,0 +1,160 @@
+#include <sample_pack.h>
+#include <ring_log.h>
+
+/* The header is written by sample_pack_end(), once the block is done. */
+#define SAMPLE_PACK_HEADER 4
+
+static const uint8_t tickWidths[] = { SAMPLE_PACK_TICK_WIDTHS };
+static const uint8_t valueWidths[] = { SAMPLE_PACK_VALUE_WIDTHS };
+
+/**
+ * Append the low count bits of value to the bit stream, most significant
+ * first. The caller makes sure there is room.
+ */
+static void
+pack_bits(SamplePack* pack, uint32_t value, uint8_t count) {
+	while (count > 0) {
+		uint8_t room = 8 - pack->BitCount;
+		uint8_t take = (count < room) ? count : room;
+		uint8_t bits = (value >> (count - take)) & ((1 << take) - 1);
+
+		pack->Buffer[pack->Length] |= bits << (room - take);
+		pack->BitCount += take;
+		count -= take;
+
+		if (pack->BitCount == 8) {
+			pack->Length++;
+			pack->BitCount = 0;
+			pack->Buffer[pack->Length] = 0;
+		}
+	}
+}
+
+/**
+ * Append a signed number in the smallest of the widths that holds it
+ * once zigzag coded, or in 32 bits if none does.
+ */
+static void
+pack_number(SamplePack* pack, int32_t number, const uint8_t widths[3]) {
+	uint32_t zigzag = ((uint32_t)number << 1) ^ (uint32_t)(number >> 31);
+	uint8_t size;
+
+	if (zigzag == 0) {
+		pack_bits(pack, 0, 1);
+		return;
+	}
+
+	for (size = 0; size < 3; size++) {
+		if (zigzag < (1UL << widths[size])) {
+			/* Prefix of size + 1 ones and a zero. */
+			pack_bits(pack, (1 << (size + 2)) - 2, size + 2);
+			pack_bits(pack, zigzag, widths[size]);
+			return;
+		}
+	}
+
+	pack_bits(pack, 0x0F, 4);
+	pack_bits(pack, zigzag, 32);
+}
+
+/**
+ * Start an empty block in buffer, which must hold at least
+ * SAMPLE_PACK_LENGTH(1) bytes.
+ */
+void
+sample_pack_begin(SamplePack* pack, uint8_t* buffer, uint16_t capacity) {
+	uint8_t channel;
+
+	pack->Buffer = buffer;
+	pack->Capacity = capacity;
+	pack->Length = SAMPLE_PACK_HEADER;
+	pack->BitCount = 0;
+	pack->Count = 0;
+	pack->Missing = 0;
+	pack->Tick = 0;
+	pack->TickDelta = 0;
+	for (channel = 0; channel < SAMPLE_PACK_CHANNELS; channel++) {
+		pack->Values[channel] = 0;
+	}
+	pack->Buffer[pack->Length] = 0;
+}
+
+/**
+ * Add a sample to the block. Returns SAMPLE_PACK_FULL, and leaves the
+ * block as it was, if a sample might not fit.
+ */
+uint8_t
+sample_pack_add(SamplePack* pack, const Sample* sample) {
+	int32_t values[SAMPLE_PACK_CHANNELS];
+	uint8_t missing = 0;
+	uint8_t channel;
+	uint32_t delta;
+
+	if (pack->Count == UINT8_MAX ||
+		pack->Length + 1 + SAMPLE_PACK_MAX_SAMPLE + 4 > pack->Capacity) {
+		return SAMPLE_PACK_FULL;
+	}
+
+	/* In the order of the SAMPLE_MISSING_* bits. */
+	values[0] = sample->LPS331Temperature;
+	values[1] = sample->LPS331Pressure;
+	values[2] = sample->HTS221Temperature;
+	values[3] = sample->HTS221Humidity;
+	for (channel = 0; channel < SAMPLE_PACK_CHANNELS; channel++) {
+		if (values[channel] == SAMPLE_NO_READING) {
+			missing |= 1 << channel;
+		}
+	}
+
+	delta = sample->TickCount - pack->Tick;
+	pack_number(pack, (int32_t)(delta - pack->TickDelta), tickWidths);
+	pack->Tick = sample->TickCount;
+	pack->TickDelta = delta;
+
+	if (missing == pack->Missing) {
+		pack_bits(pack, 0, 1);
+	} else {
+		pack_bits(pack, 0x10 | missing, 5);
+		pack->Missing = missing;
+	}
+
+	/* A missing channel keeps its last value to code the next one against. */
+	for (channel = 0; channel < SAMPLE_PACK_CHANNELS; channel++) {
+		if (missing & (1 << channel)) {
+			continue;
+		}
+		pack_number(pack, (int32_t)((uint32_t)values[channel] - (uint32_t)pack->Values[channel]), valueWidths);
+		pack->Values[channel] = values[channel];
+	}
+
+	pack->Count++;
+	return SAMPLE_PACK_OK;
+}
+
+/**
+ * Finish the block with its header and CRC. Returns its length in bytes.
+ */
+uint16_t
+sample_pack_end(SamplePack* pack) {
+	uint16_t length;
+	uint32_t crc;
+
+	/* Keep the padding of a partly used last byte. */
+	if (pack->BitCount > 0) {
+		pack->Length++;
+		pack->BitCount = 0;
+	}
+
+	length = pack->Length + 4;
+	pack->Buffer[0] = SAMPLE_PACK_VERSION;
+	pack->Buffer[1] = pack->Count;
+	pack->Buffer[2] = length & 0xFF;
+	pack->Buffer[3] = length >> 8;
+
+	crc = ~rlog_crc32(0xFFFFFFFF, pack->Buffer, pack->Length);
+	pack->Buffer[pack->Length + 0] = crc & 0xFF;
+	pack->Buffer[pack->Length + 1] = (crc >> 8) & 0xFF;
+	pack->Buffer[pack->Length + 2] = (crc >> 16) & 0xFF;
+	pack->Buffer[pack->Length + 3] = crc >> 24;
+	return length;
+}
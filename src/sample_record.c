@@ -0,0 +1,39 @@
+#include <sample_record.h>
+#include <ring_log.h>
+#include <stddef.h>
+
+/* The layout is shared with tools/sample_decode.py. */
+_Static_assert(sizeof(SampleRecord) == 20, "SampleRecord layout changed");
+
+/**
+ * Fill in a record from a sample.
+ */
+void
+sample_record_encode(SampleRecord* record, const Sample* sample) {
+	record->Version = SAMPLE_RECORD_VERSION;
+	record->Missing = 0;
+	record->TickCount = sample->TickCount;
+
+	record->LPS331Temperature = sample->LPS331Temperature;
+	if (sample->LPS331Temperature == SAMPLE_NO_READING) {
+		record->Missing |= SAMPLE_MISSING_LPS331_TEMP;
+		record->LPS331Temperature = 0;
+	}
+	record->LPS331Pressure = sample->LPS331Pressure;
+	if (sample->LPS331Pressure == SAMPLE_NO_READING) {
+		record->Missing |= SAMPLE_MISSING_LPS331_PRES;
+		record->LPS331Pressure = 0;
+	}
+	record->HTS221Temperature = sample->HTS221Temperature;
+	if (sample->HTS221Temperature == SAMPLE_NO_READING) {
+		record->Missing |= SAMPLE_MISSING_HTS221_TEMP;
+		record->HTS221Temperature = 0;
+	}
+	record->HTS221Humidity = sample->HTS221Humidity;
+	if (sample->HTS221Humidity == SAMPLE_NO_READING) {
+		record->Missing |= SAMPLE_MISSING_HTS221_HUM;
+		record->HTS221Humidity = 0;
+	}
+
+	record->Crc = ~rlog_crc32(0xFFFFFFFF, record, offsetof(SampleRecord, Crc));
+}
@@ -0,0 +1,151 @@
+#include <sample_ring.h>
+#include "task.h"
+
+/* Orders the sample copy against the index update on the other side. */
+#define SAMPLE_RING_BARRIER() __sync_synchronize()
+
+/**
+ * Set up an empty ring over a buffer of capacity samples.
+ * The capacity must be a power of two, and at least 2.
+ */
+uint8_t
+sample_ring_init(SampleRing* ring, Sample* buffer, uint32_t capacity, uint8_t policy, uint8_t decimation) {
+	if (capacity < 2 || (capacity & (capacity - 1)) != 0 || decimation == 0) {
+		return SAMPLE_RING_ERROR;
+	}
+
+	ring->Buffer = buffer;
+	ring->Capacity = capacity;
+	ring->Policy = policy;
+	ring->Decimation = decimation;
+	ring->Skipped = 0;
+	ring->Head = 0;
+	ring->Tail = 0;
+	ring->Dropped = 0;
+	ring->Overwritten = 0;
+	return SAMPLE_RING_OK;
+}
+
+/**
+ * Number of samples waiting to be taken.
+ */
+uint32_t
+sample_ring_count(SampleRing* ring) {
+	uint32_t count = ring->Head - ring->Tail;
+	if (count > ring->Capacity - 1 && ring->Policy == SAMPLE_RING_OVERWRITE) {
+		return ring->Capacity - 1;
+	}
+	return count;
+}
+
+/**
+ * Put a sample in the ring. Called by the producer only.
+ * Returns SAMPLE_RING_DROPPED if the policy left the sample out, after
+ * waiting up to wait ticks for room under SAMPLE_RING_BLOCK.
+ */
+uint8_t
+sample_ring_put(SampleRing* ring, const Sample* sample, TickType_t wait) {
+	uint32_t head = ring->Head;
+	uint32_t used = head - ring->Tail;
+
+	switch (ring->Policy) {
+	case SAMPLE_RING_DECIMATE:
+		if (used >= ring->Capacity) {
+			goto dropped;
+		}
+		if (used * 100 >= ring->Capacity * SAMPLE_RING_HIGH_WATER) {
+			if (++ring->Skipped < ring->Decimation) {
+				goto dropped;
+			}
+		}
+		ring->Skipped = 0;
+		break;
+
+	case SAMPLE_RING_BLOCK:
+		while (used >= ring->Capacity) {
+			if (wait == 0) {
+				goto dropped;
+			}
+			TickType_t delay = (wait < SAMPLE_RING_POLL_MS) ? wait : SAMPLE_RING_POLL_MS;
+			vTaskDelay(delay);
+			wait -= delay;
+			used = head - ring->Tail;
+		}
+		break;
+
+	default:
+		/* SAMPLE_RING_OVERWRITE never refuses a sample. */
+		break;
+	}
+
+	/* Fill the slot before the consumer can see it. */
+	SAMPLE_RING_BARRIER();
+	ring->Buffer[head & (ring->Capacity - 1)] = *sample;
+	SAMPLE_RING_BARRIER();
+	ring->Head = head + 1;
+	return SAMPLE_RING_OK;
+
+dropped:
+	ring->Dropped++;
+	return SAMPLE_RING_DROPPED;
+}
+
+/**
+ * Take up to count of the oldest samples from the ring. Called by the
+ * consumer only. Returns the number taken.
+ */
+uint32_t
+sample_ring_get(SampleRing* ring, Sample* samples, uint32_t count) {
+	uint32_t taken = 0;
+	uint32_t tail = ring->Tail;
+
+	while (taken < count) {
+		uint32_t head = ring->Head;
+		SAMPLE_RING_BARRIER();
+
+		/* When lapped, skip to the oldest slot the producer is not
+		   writing. Only possible under SAMPLE_RING_OVERWRITE. */
+		if (head - tail > ring->Capacity - 1 && ring->Policy == SAMPLE_RING_OVERWRITE) {
+			uint32_t oldest = head - (ring->Capacity - 1);
+			ring->Overwritten += oldest - tail;
+			tail = oldest;
+		}
+		if (head == tail) {
+			break;
+		}
+
+		samples[taken] = ring->Buffer[tail & (ring->Capacity - 1)];
+		SAMPLE_RING_BARRIER();
+
+		/* The producer may have come round to this slot during the copy. */
+		if (ring->Policy == SAMPLE_RING_OVERWRITE && ring->Head - tail > ring->Capacity - 1) {
+			continue;
+		}
+
+		tail++;
+		taken++;
+	}
+
+	/* Hand the slots back to the producer. */
+	ring->Tail = tail;
+	return taken;
+}
+
+/**
+ * Copy the newest sample put in the ring, whether or not it has been
+ * taken. Called by the consumer only. Returns 0 if there has been none.
+ */
+uint8_t
+sample_ring_latest(SampleRing* ring, Sample* sample) {
+	uint32_t head = ring->Head;
+	SAMPLE_RING_BARRIER();
+	if (head == 0) {
+		return 0;
+	}
+
+	*sample = ring->Buffer[(head - 1) & (ring->Capacity - 1)];
+	SAMPLE_RING_BARRIER();
+
+	/* The producer only reuses the slot after a whole lap. */
+	return (ring->Head - head) < ring->Capacity - 1;
+}
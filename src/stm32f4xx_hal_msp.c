@@ -273,6 +273,13 @@ HAL_I2C_MspInit(I2C_HandleTypeDef* hi2c) {
 		gpio_init.Pull = GPIO_PULLUP;
 		gpio_init.Alternate = GPIO_AF4_I2C1;
 		HAL_GPIO_Init(GPIOB, &gpio_init);
+
+		/* Transfers run on interrupts that wake the I2C task, so their
+		   priority must be below configMAX_SYSCALL_INTERRUPT_PRIORITY. */
+		HAL_NVIC_SetPriority(I2C1_EV_IRQn, 6, 0);
+		HAL_NVIC_SetPriority(I2C1_ER_IRQn, 6, 0);
+		HAL_NVIC_EnableIRQ(I2C1_EV_IRQn);
+		HAL_NVIC_EnableIRQ(I2C1_ER_IRQn);
 	}
 }
 
@@ -1,18 +1,47 @@
 #include <peripheral/arducam.h>
-#include <peripheral/lps331.h>
-#include <peripheral/hts221.h>
 #include <task/camera_task.h>
+#include <task/skywire_task.h>
 #include <fat_sl.h>
 #include <mdriver_spi_sd.h>
+#include <ring_log.h>
+#include <sample_record.h>
+#include <sample_pack.h>
+#include <jpeg.h>
 #include <FreeRTOS.h>
 #include <semphr.h>
+#include <stdio.h>
 #include <string.h>
 
 uint8_t arduCamInstalled = 0;
-SampleBuffer samples;
-uint16_t dcimIndex = 1;
+uint8_t arduCamLowPower = 0;
+RingLog dataLog;
+RingLog imageStore;
+RingLog thumbStore;
+
+/* FIFO data lands at captureBuffer + 1; the spare byte takes the dummy. */
+uint8_t captureBuffer[CAPTURE_BURST_LENGTH + 1];
+
+/* Signature of the last stored image, to detect unchanged scenes. */
+JpegDcDecoder sceneDecoder;
+uint8_t sceneReference[JPEG_SIGNATURE_CELLS];
+uint8_t sceneReferenceValid = 0;
+TickType_t sceneReferenceTick;
+uint32_t sceneReferenceSequence;
+
+/* Stored images that went without a thumbnail, and why the frame being
+   read has none. */
+uint32_t thumbnailsSkipped = 0;
+const char* thumbnailSkip = NULL;
+
+/* An image is exposing; the SPI bus is free until it is read out. */
+uint8_t captureActive = 0;
+TickType_t captureStarted;
 uint8_t gpio_regval = 0;
 
+/* The image in the FIFO has been handed to the Skywire task to stream. */
+uint8_t captureLive = 0;
+TickType_t liveStarted;
+
 
 /**
  * Initialize the peripherals and state for this task.
@@ -20,13 +49,18 @@ uint8_t gpio_regval = 0;
 uint8_t
 camera_task_setup() {
 	/* Initialize I2C peripherals for this task. */
+	OV5642_Window roi = { CAMERA_ROI_LEFT, CAMERA_ROI_TOP, CAMERA_ROI_WIDTH, CAMERA_ROI_HEIGHT };
+	if (ov5642_set_window(&roi) != DEVICES_OK) {
+		trace_printf("camera_task: invalid camera region of interest\n");
+	}
 	ov5642_init();
-	lps331_init();
-	hts221_init();
 
 	/* Intialize SPI peripherals for this task. */
 	spi_take();
 	arduCamInstalled = arducam_init();
+	if (arduCamInstalled && arducam_set_frames(CAMERA_BURST_FRAMES) != DEVICES_OK) {
+		trace_printf("camera_task: failed to set burst length\n");
+	}
 
 	/* Try to mount the SD card. */
 	if (fn_initvolume(mmc_spi_initfunc) != F_NO_ERROR) {
@@ -35,16 +69,29 @@ camera_task_setup() {
 		return 0;
 	}
 
+	/* Open the data log and image store, creating them on first boot. */
+	if (rlog_open(&dataLog, DATA_LOG_NAME, DATA_LOG_SECTORS) != RLOG_OK) {
+		trace_printf("camera_task: failed to open " DATA_LOG_NAME "\n");
+		spi_give();
+		return 0;
+	}
+	if (rlog_open(&imageStore, IMAGE_STORE_NAME, IMAGE_STORE_SECTORS) != RLOG_OK) {
+		trace_printf("camera_task: failed to open " IMAGE_STORE_NAME "\n");
+		arduCamInstalled = 0;
+	}
+	if (rlog_open(&thumbStore, THUMB_STORE_NAME, THUMB_STORE_SECTORS) != RLOG_OK) {
+		trace_printf("camera_task: failed to open " THUMB_STORE_NAME "\n");
+	}
+
 #ifdef CLEAN_SD_CARD
-	/* Delete DATA.LOG and JPG files from the SD card. */
+	/* Discard all records in the data log and image store. */
 	trace_printf("camera_task: cleaning SD card\n");
-	f_delete("DATA.LOG");
-	f_delete("file.txt");
-	F_FIND xFindStruct;
-	if (f_findfirst("*.JPG", &xFindStruct) == F_NO_ERROR) {
-		do {
-			f_delete(xFindStruct.filename);
-		} while (f_findnext(&xFindStruct) == F_NO_ERROR);
+	rlog_reset(&dataLog);
+	if (imageStore.Mounted) {
+		rlog_reset(&imageStore);
+	}
+	if (thumbStore.Mounted) {
+		rlog_reset(&thumbStore);
 	}
 #endif
 
@@ -53,39 +100,56 @@ camera_task_setup() {
 }
 
 /**
- * Open a handle to DATA.LOG.
+ * Format a reading held in hundredths as a decimal, or as null if there is
+ * no reading.
  */
-F_FILE*
-open_log() {
-	/* Open a handle to append to the data log. */
-	F_FILE* hLog = f_open("data.log", "a");
-	if (hLog == NULL) {
-		trace_printf("camera_task; failed to open data.log\n");
-	}
-	return hLog;
+int
+format_hundredths(char* buffer, uint8_t length, int32_t value) {
+	if (value == SAMPLE_NO_READING) {
+		return snprintf(buffer, length, "null");
+	}
+	uint32_t magnitude = (value < 0) ? -(uint32_t)value : (uint32_t)value;
+	return snprintf(buffer, length, "%s%lu.%02lu", (value < 0) ? "-" : "",
+			(unsigned long)(magnitude / 100), (unsigned long)(magnitude % 100));
 }
 
 /**
- * Capture a reading of the sensors into the sample buffer.
- * Write the sample buffer to the SD card if access is available.
+ * Format the readings of a sample as JSON members, in degC, mbar and %rH.
  */
-void
-capture_sample(TickType_t* lastReading) {
-	trace_printf("reading sensors\n");
-
-	F_FILE* pxLog = NULL;
+int
+format_readings(char* buffer, uint8_t length, Sample* sample) {
+	/* Room for the longest value, "-21474836.48". */
+	char lpsTemp[13], lpsPres[13], htsTemp[13], htsHum[13];
+	format_hundredths(lpsTemp, 13, sample->LPS331Temperature);
+	format_hundredths(lpsPres, 13, sample->LPS331Pressure);  /* 100 Pa to the mbar */
+	format_hundredths(htsTemp, 13, sample->HTS221Temperature);
+	format_hundredths(htsHum, 13, sample->HTS221Humidity);
+	return snprintf(buffer, length,
+			"\"lps331\":{\"temp\":%s,\"pres\":%s},"
+			"\"hts221\":{\"temp\":%s,\"hum\":%s}",
+			lpsTemp, lpsPres, htsTemp, htsHum);
+}
 
-	/* Record values from each sensor. */
-	Sample* sample = &samples.Buffer[samples.Count];
-	sample->TickCount = xTaskGetTickCount();
-	sample->LPS331Temperature = lps331_read_temp_C();
-	sample->LPS331Pressure = lps331_read_pres_mbar();
-	sample->HTS221Temperature = hts221_read_temp_C();
-	sample->HTS221Humidity = hts221_read_hum_rel();
+/**
+ * Flush the sample ring to the data log, if access to the SD card is
+ * available. Otherwise the samples wait in the ring. Each data log record
+ * holds up to SAMPLE_FLUSH_BATCH samples, as one packed block or as
+ * SampleRecords.
+ */
+void
+flush_samples() {
+	Sample batch[SAMPLE_FLUSH_BATCH];
+#ifdef PACK_SAMPLES
+	uint8_t block[SAMPLE_PACK_LENGTH(SAMPLE_FLUSH_BATCH)];
+	SamplePack pack;
+#else
+	SampleRecord records[SAMPLE_FLUSH_BATCH];
+#endif
+	uint32_t count;
 
-	/* Successfully collected a sample. */
-	*lastReading = sample->TickCount;
-	samples.Count++;
+	if (sample_ring_count(&sampleRing) == 0) {
+		return;
+	}
 
 	/* Try to obtain access to the SD card. */
 	if (!spi_take()) {
@@ -93,143 +157,686 @@ capture_sample(TickType_t* lastReading) {
 		return;
 	}
 
-	/* Open a handle to the data log. */
-	if ((pxLog = open_log()) == NULL) {
-		goto error;
+	while ((count = sample_ring_get(&sampleRing, batch, SAMPLE_FLUSH_BATCH)) > 0) {
+#ifdef PACK_SAMPLES
+		/* The block is sized to take the whole batch. */
+		sample_pack_begin(&pack, block, sizeof(block));
+		for (uint32_t i = 0; i < count; ++i) {
+			sample_pack_add(&pack, &batch[i]);
+		}
+		const void* payload = block;
+		uint32_t length = sample_pack_end(&pack);
+#else
+		for (uint32_t i = 0; i < count; ++i) {
+			sample_record_encode(&records[i], &batch[i]);
+		}
+		const void* payload = records;
+		uint32_t length = count * sizeof(SampleRecord);
+#endif
+
+		/* Write the batch to the data log. */
+		uint8_t result = rlog_append(&dataLog, RLOG_TYPE_SAMPLE, batch[0].TickCount,
+				payload, length);
+		if (result == RLOG_FULL) {
+			trace_printf("camera_task: data log full, %lu samples dropped\n", (unsigned long)count);
+		} else if (result != RLOG_OK) {
+			trace_printf("camera_task: write to data log failed\n");
+			goto error;
+		}
 	}
+	rlog_flush(&dataLog);
 
-	/* Write the samples to the data log. */
-	for (uint8_t i = 0; i < samples.Count; ++i) {
-		char* format =
-				"DATA:{\"tick\":%d,"
-				  "\"lps331\":{\"temp\":%.2f,\"pres\":%.2f},"
-				  "\"hts221\":{\"temp\":%.2f,\"hum\":%.2f}"
-				"}\n";
+	/* Fall through and clean up. */
+error:
+	spi_give();
+}
 
-		char buffer[128];
-		Sample* sample = &samples.Buffer[i];
-		int16_t wrote = snprintf(buffer, 128, format,
-				sample->TickCount,
-				sample->LPS331Temperature,
-				sample->LPS331Pressure,
-				sample->HTS221Temperature,
-				sample->HTS221Humidity);
+/**
+ * Trigger an image capture.
+ * The SPI bus is released again straight away so that samples can be
+ * written while the sensor exposes; poll_image() picks up the result.
+ */
+void
+start_image() {
+	if (!spi_take()) {
+		/* Need exclusive access to the SPI bus. */
+		return;
+	}
 
-		f_write(buffer, 1, wrote, pxLog);
+	/* Exit low power mode before taking an image. */
+	if (arduCamLowPower) {
+		if (arducam_low_power_remove() != DEVICES_OK) {
+			trace_printf("Error removing low power mode \n");
+			goto error;
+		}
+		arduCamLowPower = 0;
 	}
-	f_close(pxLog);
-	pxLog = NULL;
 
-	/* Reset the sample buffer. */
-	samples.Count = 0;
+	trace_printf("reading camera\n");
+
+	if (arducam_start_capture() != DEVICES_OK) {
+		trace_printf("camera_task: image capture failed\n");
+		goto error;
+	}
+	captureStarted = xTaskGetTickCount();
+	captureActive = 1;
 
 	/* Fall through and clean up. */
 error:
-	if (pxLog != NULL) { f_close(pxLog); };
 	spi_give();
 }
 
 /**
- * Find the next image name for a JPG capture.
+ * Build the metadata segment that is inserted after the SOI marker of an
+ * image, so that the image carries its own tick count, sensor reading and
+ * capture settings. The segment is padded with zeros to a multiple of four
+ * bytes so the image store can keep the rest of the image sector aligned.
+ * Returns the length of the segment.
  */
 uint16_t
-next_image_name(char* buffer, uint8_t length) {
-	F_FIND xFindStruct;
-	for (int i = dcimIndex; i < (dcimIndex + 100); ++i) {
-		snprintf(buffer, length, "dcim%d.jpg", i);
-		if (f_findfirst(buffer, &xFindStruct) == F_ERR_NOTFOUND) {
-			dcimIndex = i + 1;
-			return i;
-		}
+camera_image_metadata(uint8_t* segment, TickType_t tickCount) {
+	uint8_t* payload = segment + 4;
+	char* text = (char*)payload + sizeof(IMAGE_METADATA_ID);
+	uint16_t room = IMAGE_METADATA_LENGTH - 4 - sizeof(IMAGE_METADATA_ID);
+	memcpy(payload, IMAGE_METADATA_ID, sizeof(IMAGE_METADATA_ID));
+
+	int length = snprintf(text, room, "{\"tick\":%lu,\"profile\":%d,\"qscale\":%d",
+			(unsigned long)tickCount, ov5642_get_profile(), ov5642_get_qscale());
+	Sample latest;
+	if (sample_ring_latest(&sampleRing, &latest)) {
+		text[length++] = ',';
+		length += format_readings(text + length, room - length, &latest);
+	}
+	length += snprintf(text + length, room - length, "}");
+
+	/* The text always fits; the worst case is about 150 bytes. */
+	length += sizeof(IMAGE_METADATA_ID);
+	while (length % 4 != 0) {
+		payload[length++] = '\0';
 	}
-	return 0;
+	return jpeg_segment(segment, JPEG_APP0 + IMAGE_METADATA_APP, length);
 }
 
 /**
- * Capture an image from the camera to the SD card.
+ * Compare the signature of a frame with the last stored image.
+ * Returns 1 if the scene has changed or a keyframe is due.
+ */
+uint8_t
+camera_scene_changed(const uint8_t* signature, TickType_t tickCount) {
+	if (!sceneReferenceValid || (tickCount - sceneReferenceTick) >= SCENE_KEYFRAME_MS) {
+		return 1;
+	}
+	uint8_t cells = jpeg_signature_compare(signature, sceneReference, SCENE_CHANGE_LEVEL);
+	trace_printf("camera_task: %d cells changed\n", cells);
+	return cells >= SCENE_CHANGE_CELLS;
+}
+
+/**
+ * Log a frame that matches the last stored image in the data log.
  */
 void
-capture_image(TickType_t* lastCapture) {
-	F_FILE *pxJpg = NULL, *pxLog = NULL;
+camera_log_unchanged(TickType_t tickCount) {
+	char buffer[64];
+	int length = snprintf(buffer, 64, "SAME:{\"tick\":%lu,\"file\":\"dcim%lu.jpg\"}\n",
+			(unsigned long)tickCount, (unsigned long)sceneReferenceSequence);
+	if (rlog_append(&dataLog, RLOG_TYPE_SAME, tickCount, buffer, length) != RLOG_OK) {
+		trace_printf("camera_task: write to data log failed\n");
+	}
+	rlog_flush(&dataLog);
+}
 
-	if (!spi_take()) {
-		/* Need exclusive access to the SPI bus. */
+/**
+ * Append a row of the thumbnail being decoded to its record.
+ */
+void
+camera_thumbnail_row(void* context, const uint8_t* row, uint16_t width) {
+	/* A failed write abandons the record; later rows are then ignored. */
+	rlog_write((RingLog*)context, row, width);
+}
+
+/**
+ * Start a thumbnail record for the frame the scene decoder has just begun.
+ * The thumbnail is a binary PGM naming its image in a comment. The rows
+ * are appended as the frame is decoded, so only two rows are held in RAM.
+ *
+ * The decoder needs the headers of the frame in the burst its SOI marker
+ * is in, and a frame at most JPEG_THUMBNAIL_WIDTH blocks wide. Otherwise
+ * the reason is kept for camera_thumbnail_end().
+ */
+void
+camera_thumbnail_begin(TickType_t tickCount) {
+	thumbnailSkip = NULL;
+	if (!thumbStore.Mounted) {
+		return;
+	}
+	if (sceneDecoder.State != JPEG_DC_DECODING) {
+		thumbnailSkip = "headers not decoded";
+		return;
+	}
+	if (sceneDecoder.ThumbnailWidth == 0) {
+		thumbnailSkip = "image too wide";
+		return;
+	}
+	if (rlog_begin(&thumbStore, RLOG_TYPE_THUMB, tickCount) != RLOG_OK) {
+		thumbnailSkip = "thumbnail store not written";
 		return;
 	}
 
-	trace_printf("reading camera\n");
+	char header[48];
+	int length = snprintf(header, 48, "P5\n# dcim%lu.jpg\n%u %u\n255\n",
+			(unsigned long)imageStore.Open.Sequence,
+			sceneDecoder.ThumbnailWidth, sceneDecoder.ThumbnailHeight);
+	if (rlog_write(&thumbStore, header, length) == RLOG_OK) {
+		sceneDecoder.RowOutput = camera_thumbnail_row;
+		sceneDecoder.RowContext = &thumbStore;
+	}
+}
 
-	/* Trigger a new capture. */
-	uint32_t remainingBytes;
-	if (   arducam_start_capture()               != DEVICES_OK
-		|| arducam_wait_capture(&remainingBytes) != DEVICES_OK) {
-		trace_printf("camera_task: image capture failed\n");
-		goto error;
+/**
+ * Keep the thumbnail of a stored frame if the whole frame was decoded.
+ * A stored frame without one is counted in thumbnailsSkipped.
+ */
+void
+camera_thumbnail_end() {
+	if (thumbStore.Writing) {
+		if (   sceneDecoder.State != JPEG_DC_DONE
+			|| sceneDecoder.ThumbnailRow != sceneDecoder.ThumbnailHeight) {
+			rlog_abort(&thumbStore);
+			thumbnailSkip = "image not decoded";
+		} else if (   rlog_end(&thumbStore)   != RLOG_OK
+				   || rlog_flush(&thumbStore) != RLOG_OK) {
+			thumbnailSkip = "write to thumbnail store failed";
+		}
+	}
+	if (thumbnailSkip != NULL) {
+		thumbnailsSkipped++;
+		trace_printf("camera_task: no thumbnail, %s (%lu skipped)\n",
+				thumbnailSkip, (unsigned long)thumbnailsSkipped);
+		thumbnailSkip = NULL;
 	}
+}
 
-	/* Choose a file name for this image. */
-	char jpgName[32];
-	if (   !next_image_name(jpgName, 32)
-		|| (pxJpg = f_open(jpgName, "w")) == NULL) {
-		trace_printf("camera_task: open JPG failed\n");
-		goto error;
+/**
+ * Complete the image store record of a frame.
+ * A frame that matches the last stored image is dropped from the image
+ * store and logged in the data log instead.
+ */
+uint8_t
+store_frame(TickType_t tickCount, uint32_t frameLength) {
+	uint8_t result;
+	uint8_t signature[JPEG_SIGNATURE_CELLS];
+	uint8_t hasSignature = jpeg_dc_signature(&sceneDecoder, signature);
+	if (hasSignature && !camera_scene_changed(signature, tickCount)) {
+		trace_printf("camera_task: scene unchanged, %lu byte image not stored\n", frameLength);
+		rlog_abort(&imageStore);
+		if (thumbStore.Writing) {
+			rlog_abort(&thumbStore);
+		}
+		camera_log_unchanged(tickCount);
+		return RLOG_OK;
+	}
+
+	uint32_t sequence = imageStore.Open.Sequence;
+	if (   (result = rlog_end(&imageStore))   != RLOG_OK
+		|| (result = rlog_flush(&imageStore)) != RLOG_OK) {
+		return result;
+	}
+	trace_printf("camera_task: stored %lu byte image\n", frameLength);
+	camera_thumbnail_end();
+
+	/* Later frames are compared with this one. */
+	sceneReferenceValid = hasSignature;
+	if (hasSignature) {
+		memcpy(sceneReference, signature, JPEG_SIGNATURE_CELLS);
+		sceneReferenceTick = tickCount;
+		sceneReferenceSequence = sequence;
 	}
+	return RLOG_OK;
+}
 
-	/* Copy the JPG image from the camera flash to the SD card. */
-	uint8_t buffer[BURST_READ_LENGTH];
-	uint8_t length = MIN(remainingBytes, BURST_READ_LENGTH);
-	arducam_burst_read(buffer, length);
-	remainingBytes -= length + 1;
-	if (f_write(buffer + 1, 1, (length - 1), pxJpg) != (length - 1)) {
-		trace_printf("camera_task: write to JPG failed\n");
+/**
+ * Copy the completed frames from the camera to the SD card.
+ * Each JPG is appended to the image store as a single record, with a
+ * metadata segment inserted after its SOI marker.
+ * The caller holds the SPI bus.
+ *
+ * The FIFO is read in bursts of whole sectors. The first record is padded
+ * so the FIFO data starts on a sector boundary, so each burst is written
+ * to the card as it stands. Each frame in the FIFO is followed by
+ * padding, so the bursts are scanned for the EOI marker that ends a frame
+ * and the SOI marker that starts the next. Reading stops after
+ * CAMERA_BURST_FRAMES frames.
+ *
+ * The DC coefficients are decoded as the bursts go by to give a signature
+ * of the scene and a 1/8 scale thumbnail, which goes to the thumbnail
+ * store. A frame that matches the last stored image is dropped from the
+ * image store and logged in the data log instead.
+ *
+ * Returns the length of the first image, or 0 if it could not be read.
+ */
+uint32_t
+read_image() {
+	static const uint8_t soi[] = { JPEG_MARKER, JPEG_SOI };
+	uint8_t result = RLOG_OK;
+	uint32_t imageLength = 0;
+	TickType_t tickCount = xTaskGetTickCount();
+	uint32_t remainingBytes;
+	if (   arducam_capture_length(&remainingBytes) != DEVICES_OK
+		|| remainingBytes < 2) {
+		trace_printf("camera_task: image capture failed\n");
 		goto error;
 	}
-	for (uint16_t i = 0; remainingBytes > 0; ++i) {
-		uint8_t length = MIN(remainingBytes, BURST_READ_LENGTH);
-		arducam_burst_read(buffer, length);
+
+	/* Copy the JPG images from the camera FIFO to the SD card.
+	   The first byte read from the FIFO is a dummy. */
+	remainingBytes -= 1;
+	uint8_t* burst = captureBuffer;
+	uint8_t* data = captureBuffer + 1;
+	JpegScanner scanner = { 0 };
+	uint8_t metadata[IMAGE_METADATA_LENGTH];
+	uint16_t metadataLength = camera_image_metadata(metadata, tickCount);
+	uint8_t frames = 0;
+	uint8_t inFrame = 0;
+	uint32_t frameLength = 0;
+	uint32_t headerRemaining = 0;
+	while (remainingBytes > 0) {
+		uint16_t length = MIN(remainingBytes, CAPTURE_BURST_LENGTH);
+		if (arducam_burst_read(burst, (data + length) - burst) != DEVICES_OK) {
+			trace_printf("camera_task: FIFO read failed\n");
+			goto error;
+		}
 		remainingBytes -= length;
-		if (f_write(buffer, 1, length, pxJpg) != length) {
-			trace_printf("camera_task: write to JPG failed\n");
+		if (burst == captureBuffer && !jpeg_check_soi(data, length)) {
+			trace_printf("camera_task: FIFO does not hold a JPG image\n");
+			goto error;
+		}
+		burst = data;
+
+		uint32_t position = 0;
+		while (position < length) {
+			uint32_t start = position;
+			if (!inFrame) {
+				/* Look for the start of the next frame. */
+				uint32_t found = jpeg_find_soi(&scanner, data + position, length - position);
+				if (found == 0) {
+					break;
+				}
+				position += found;
+
+				/* Write SOI and the metadata segment, then copy the frame
+				   from just after its SOI. The FIFO data then falls on the
+				   same sector offsets it would have without the metadata. */
+				if (   (result = rlog_begin_aligned(&imageStore, RLOG_TYPE_JPEG, tickCount, metadataLength)) != RLOG_OK
+					|| (result = rlog_write(&imageStore, soi, 2))                                         != RLOG_OK
+					|| (result = rlog_write(&imageStore, metadata, metadataLength))                       != RLOG_OK) {
+					goto error;
+				}
+				frameLength = 2 + metadataLength;
+				start = position;
+
+				/* The tables may hold FF D9, so only the entropy coded data
+				   after the headers is scanned for EOI. The headers can only
+				   be read if the whole SOI marker is in this burst. */
+				uint32_t soiStart = (found == 1) ? position : position - 2;
+				uint32_t header = jpeg_dc_begin(&sceneDecoder, data + soiStart, length - soiStart);
+				camera_thumbnail_begin(tickCount);
+				if (   header == 0
+					&& (header = jpeg_header_length(data + soiStart, length - soiStart)) == 0) {
+					header = 2;
+				}
+				headerRemaining = header - 2;
+				inFrame = 1;
+			}
+
+			uint32_t skip = MIN(headerRemaining, length - position);
+			headerRemaining -= skip;
+			position += skip;
+			uint32_t end = jpeg_find_eoi(&scanner, data + position, length - position);
+			uint32_t next = (end != 0) ? position + end : length;
+			jpeg_dc_decode(&sceneDecoder, data + position, next - position,
+					end != 0 || remainingBytes == 0);
+			position = next;
+
+			if ((result = rlog_write(&imageStore, data + start, position - start)) != RLOG_OK) {
+				goto error;
+			}
+			frameLength += position - start;
+			if (end == 0) {
+				continue;
+			}
+
+			/* The frame is complete. */
+			inFrame = 0;
+			if ((result = store_frame(tickCount, frameLength)) != RLOG_OK) {
+				goto error;
+			}
+			if (frames++ == 0) {
+				imageLength = frameLength;
+			}
+			if (frames == CAMERA_BURST_FRAMES) {
+				remainingBytes = 0;
+				break;
+			}
+		}
+	}
+	if (inFrame) {
+		trace_printf("camera_task: JPG image has no EOI marker\n");
+		if ((result = store_frame(tickCount, frameLength)) != RLOG_OK) {
 			goto error;
 		}
+		if (frames++ == 0) {
+			imageLength = frameLength;
+		}
+	}
+	if (frames > 1) {
+		trace_printf("camera_task: read %d frames\n", frames);
 	}
-	f_close(pxJpg);
-	pxJpg = NULL;
 
-	/* Open a handle to the data log. */
-	if ((pxLog = open_log()) == NULL) {
-		goto error;
+	/* Fall through and clean up. */
+error:
+	if (result == RLOG_FULL) {
+		trace_printf("camera_task: image store full, image dropped\n");
+	} else if (result != RLOG_OK) {
+		trace_printf("camera_task: write to image store failed\n");
 	}
+	if (imageStore.Writing) { rlog_abort(&imageStore); imageLength = 0; };
+	if (thumbStore.Writing) { rlog_abort(&thumbStore); };
+	return (result == RLOG_OK) ? imageLength : 0;
+}
 
-	/* Write the JPG name to the log. */
-	TickType_t tickTime = xTaskGetTickCount();
-	int8_t wrote = snprintf(buffer, BURST_READ_LENGTH,
-			"FILE:{\"tick\":%d,\"file\":\"%s\"}\n",
-			tickTime, jpgName);
-	f_write(buffer, 1, wrote, pxLog);
+/**
+ * Adjust the JPEG quantisation scale to hold images near IMAGE_TARGET_BYTES.
+ * The image size falls roughly in inverse proportion to the scale, so the
+ * scale that would have hit the target is the current one times the ratio
+ * of the last size to the target. The next scale moves halfway there, which
+ * damps the swings of a changing scene. Sizes within
+ * IMAGE_TARGET_TOLERANCE_PERCENT of the target leave the scale alone.
+ */
+void
+camera_size_control(uint32_t imageLength) {
+	uint32_t qscale = ov5642_get_qscale();
+	uint32_t tolerance = IMAGE_TARGET_BYTES / 100 * IMAGE_TARGET_TOLERANCE_PERCENT;
+	if (   qscale == 0
+		|| (   imageLength + tolerance >= IMAGE_TARGET_BYTES
+			&& imageLength <= IMAGE_TARGET_BYTES + tolerance)) {
+		return;
+	}
 
-	f_close(pxLog);
-	pxLog = NULL;
+	uint32_t ideal = (qscale * imageLength + IMAGE_TARGET_BYTES / 2) / IMAGE_TARGET_BYTES;
+	uint32_t next = (qscale + ideal + 1) / 2;
+	if (next == qscale) {
+		/* Always take a step when out of tolerance. */
+		next = (imageLength > IMAGE_TARGET_BYTES) ? qscale + 1 : qscale - 1;
+	}
+	if (next < OV5642_QSCALE_MIN) {
+		next = OV5642_QSCALE_MIN;
+	} else if (next > OV5642_QSCALE_MAX) {
+		next = OV5642_QSCALE_MAX;
+	}
+	if (next == qscale) {
+		/* Already at the end of the range. */
+		return;
+	}
 
-	/* Successfully captured an image. */
-	*lastCapture = xTaskGetTickCount();
+	trace_printf("camera_task: %lu byte image, qscale %lu -> %lu\n", imageLength, qscale, next);
+	if (ov5642_set_qscale(next) != DEVICES_OK) {
+		trace_printf("camera_task: qscale change failed\n");
+	}
+}
 
-	/* Fall through and clean up. */
-error:
-	if (pxJpg != NULL) { f_close(pxJpg); };
-	if (pxLog != NULL) { f_close(pxLog); };
+/**
+ * Pick the capture profile for the next image.
+ * The image store holds the images not yet uploaded, so its fill level
+ * measures both the upload backlog and the space left for new images. The
+ * store is split into equal bands, one per profile, and a fuller store
+ * takes smaller images. If the cellular link cannot keep up, the backlog
+ * grows until the images are small enough for it to drain.
+ *
+ * Steps down to a smaller profile at once. Steps back up one profile at a
+ * time, and only once the fill is PROFILE_HYSTERESIS_PERCENT below the
+ * current band.
+ */
+OV5642_Profile
+camera_profile_policy() {
+	uint32_t fill = (uint32_t)(((uint64_t)rlog_used(&imageStore) * 100) / imageStore.Capacity);
+	uint32_t profile = MIN(fill * OV5642_PROFILE_COUNT / 100, OV5642_PROFILE_COUNT - 1);
+	uint32_t current = ov5642_get_profile();
+
+	if (current < OV5642_PROFILE_COUNT && profile < current) {
+		uint32_t band = current * 100 / OV5642_PROFILE_COUNT;
+		profile = (fill + PROFILE_HYSTERESIS_PERCENT < band) ? current - 1 : current;
+	}
+	return profile;
+}
+
+/**
+ * Hand a completed image to the Skywire task if it is waiting for one.
+ * The image stays in the FIFO and the camera stays awake until the Skywire
+ * task reports back. Only single frames are streamed. Returns 1 if the
+ * image was handed over.
+ */
+uint8_t
+offer_live_image() {
+	LiveImage live;
+	if (   CAMERA_BURST_FRAMES > 1
+		|| !liveWaiting
+		|| arducam_capture_length(&live.Length) != DEVICES_OK
+		|| live.Length < 2) {
+		return 0;
+	}
+
+	live.TickCount = xTaskGetTickCount();
+	live.MetadataLength = camera_image_metadata(live.Metadata, live.TickCount);
+	if (xQueueSend(xLiveQueue, (void*)&live, 0) != pdTRUE) {
+		return 0;
+	}
+	trace_printf("camera_task: streaming image live\n");
+	liveStarted = live.TickCount;
+	captureLive = 1;
+	return 1;
+}
+
+/**
+ * Choose the profile for the next image and put the camera into low power
+ * mode. The caller holds the SPI bus.
+ */
+void
+standby_camera() {
+	/* Choose the profile for the next image while the sensor is awake,
+	   so it has the whole interval to settle. */
+	OV5642_Profile profile = camera_profile_policy();
+	if (profile != ov5642_get_profile()) {
+		trace_printf("camera_task: switching to capture profile %d\n", profile);
+		if (ov5642_set_profile(profile) != DEVICES_OK) {
+			trace_printf("camera_task: capture profile change failed\n");
+		}
+	}
+
+	/* Put the camera into low power mode until the next image. */
+	if (arducam_low_power_set() != DEVICES_OK) {
+		trace_printf("Error setting low power mode \n");
+	} else {
+		trace_printf("Low power mode set \n");
+		arduCamLowPower = 1;
+	}
+}
+
+/**
+ * Check on the capture in progress with a single status read.
+ * Once the FIFO is complete, hand it to the Skywire task or read it out,
+ * and put the camera into low power mode. A capture that does not complete
+ * within CAPTURE_TIMEOUT_MS is abandoned and retried.
+ */
+void
+poll_image() {
+	if (!spi_take()) {
+		/* Try again on the next pass. */
+		return;
+	}
+
+	uint8_t done = 0;
+	if (arducam_capture_done(&done) != DEVICES_OK) {
+		trace_printf("camera_task: image capture failed\n");
+	} else if (done) {
+		if (offer_live_image()) {
+			/* The Skywire task reads the FIFO from here. */
+			spi_give();
+			return;
+		}
+		uint32_t imageLength = read_image();
+		if (imageLength > 0) {
+			camera_size_control(imageLength);
+		}
+	} else if ((xTaskGetTickCount() - captureStarted) >= CAPTURE_TIMEOUT_MS) {
+		trace_printf("camera_task: image capture timed out\n");
+	} else {
+		/* Still exposing. */
+		spi_give();
+		return;
+	}
+	captureActive = 0;
+
+	standby_camera();
+	spi_give();
+}
+
+/**
+ * Check on an image being streamed by the Skywire task.
+ * If the upload fails, or the Skywire task has not picked the image up
+ * within LIVE_CLAIM_MS, the FIFO is read out to the SD card instead.
+ */
+void
+poll_live() {
+	if (!spi_take()) {
+		/* The Skywire task is reading the FIFO. */
+		return;
+	}
+
+	uint32_t imageLength;
+	if (xQueueReceive(xLiveResultQueue, &imageLength, 0) != pdTRUE) {
+		/* Take the image back if it is still in the queue. */
+		LiveImage live;
+		if (   (xTaskGetTickCount() - liveStarted) < LIVE_CLAIM_MS
+			|| xQueueReceive(xLiveQueue, &live, 0) != pdTRUE) {
+			spi_give();
+			return;
+		}
+		imageLength = 0;
+	}
+	captureLive = 0;
+	captureActive = 0;
+
+	if (imageLength > 0) {
+		camera_size_control(imageLength);
+	} else {
+		trace_printf("camera_task: live upload failed, storing image\n");
+		if (arducam_fifo_rewind() != DEVICES_OK) {
+			trace_printf("camera_task: FIFO rewind failed\n");
+		} else if ((imageLength = read_image()) > 0) {
+			camera_size_control(imageLength);
+		}
+	}
+
+	standby_camera();
+	spi_give();
+}
+
+/**
+ * Write the directory entry and FAT mirror updates that the file system
+ * has deferred, if access to the SD card is available. Otherwise they
+ * wait for the next sync.
+ */
+void
+sync_card() {
+	if (!spi_take()) {
+		return;
+	}
+
+	uint8_t result = f_sync();
+	if (result != F_NO_ERROR) {
+		trace_printf("camera_task: f_sync failed (%u)\n", result);
+	}
 	spi_give();
 }
 
+/**
+ * Start an activity with its first deadline one period from now.
+ */
+void
+activity_init(Activity* activity, TickType_t now, TickType_t period) {
+	memset(activity, 0, sizeof(Activity));
+	activity->Period = period;
+	activity->Deadline = now + period;
+}
+
+/**
+ * Check whether an activity has reached its deadline.
+ */
+uint8_t
+activity_due(Activity* activity, TickType_t now) {
+	return (int32_t)(now - activity->Deadline) >= 0;
+}
+
+/**
+ * Record the start of a due activity and set its next deadline.
+ * Deadlines are a fixed period apart, so lateness does not accumulate. If
+ * whole periods have been missed they are skipped and counted as overruns.
+ */
+void
+activity_start(Activity* activity, TickType_t now) {
+	TickType_t lateness = now - activity->Deadline;
+	activity->Runs++;
+	activity->TotalLateness += lateness;
+	if (lateness > activity->MaxLateness) {
+		activity->MaxLateness = lateness;
+	}
+
+	activity->Deadline += activity->Period;
+	if (activity_due(activity, now)) {
+		uint32_t missed = (now - activity->Deadline) / activity->Period + 1;
+		activity->Overruns += missed;
+		activity->Deadline += missed * activity->Period;
+	}
+}
+
+/**
+ * Print the timing statistics of an activity and start them afresh.
+ */
+void
+activity_report(const char* name, Activity* activity) {
+	if (activity->Runs > 0) {
+		trace_printf("camera_task: %s runs %lu, late mean %lu max %lu ms, overruns %lu\n",
+				name,
+				(unsigned long)activity->Runs,
+				(unsigned long)(activity->TotalLateness / activity->Runs),
+				(unsigned long)activity->MaxLateness,
+				(unsigned long)activity->Overruns);
+	}
+	activity->Runs = 0;
+	activity->Overruns = 0;
+	activity->MaxLateness = 0;
+	activity->TotalLateness = 0;
+}
+
+/**
+ * Return whichever of two deadlines comes first.
+ */
+TickType_t
+earliest(TickType_t a, TickType_t b) {
+	return ((int32_t)(a - b) < 0) ? a : b;
+}
+
 /**
  * Record sensor data and capture images.
- * Activity is recorded to DATA.LOG to be picked up by the Skywire task.
+ * Activity is recorded to the data log to be picked up by the Skywire task.
+ *
+ * Storing samples and imaging run to fixed deadlines. Between them the task
+ * sleeps until the next deadline, waking every CAPTURE_POLL_MS only while
+ * an image is exposing or being uploaded.
  */
 void
 camera_task(void * pvParameters) {
 
-	int low_pow = 0;
-
 	/* Initialize the peripherals and state for this task. */
 	if (!camera_task_setup()) {
 		trace_printf("camera_task: setup failed\n");
@@ -240,50 +847,64 @@ camera_task(void * pvParameters) {
 	}
 
 	/* Initialize timing for capture sub-tasks. */
-	TickType_t lastReading, lastCapture;
-	lastReading = lastCapture = xTaskGetTickCount();
-
-	/* Initialize the sample buffer. */
-	samples.Count = 0;
+	TickType_t now = xTaskGetTickCount();
+	Activity sampling, imaging, syncing, reporting;
+	activity_init(&sampling, now, SAMPLE_FLUSH_MS);
+	activity_init(&imaging, now, IMAGE_RATE_MS);
+	activity_init(&syncing, now, F_SYNC_PERIOD_MS);
+	activity_init(&reporting, now, SCHEDULE_REPORT_MS);
 
 	for (;;) {
-		TickType_t currentTicks = xTaskGetTickCount();
+		now = xTaskGetTickCount();
 
-		if ((currentTicks - lastReading) >= SAMPLE_RATE_MS) {
-			capture_sample(&lastReading);
+		if (activity_due(&sampling, now)) {
+			activity_start(&sampling, now);
+			flush_samples();
 		}
 
 		//point at which image is captured from camera
 		if (arduCamInstalled) {
-			if ((currentTicks - lastCapture) >= IMAGE_RATE_MS) {
-				//if camera is currently in low power mode, exit low power mode before taking image
-				if (low_pow == 1){
-					if(arducam_low_power_remove() != DEVICES_OK){
-						trace_printf("Error removing low power mode \n");
-					}
-					else{
-						low_pow = 0;
-					}
+			if (captureLive) {
+				poll_live();
+			} else if (captureActive) {
+				poll_image();
+			} else if (activity_due(&imaging, now)) {
+				/* Retried on the next poll if the SPI bus is busy. */
+				start_image();
+				if (captureActive) {
+					activity_start(&imaging, captureStarted);
 				}
+			}
+		}
 
-				//only try taking image if low power has been properly disabled
-				if (low_pow == 0){
-					capture_image(&lastCapture);
-				}
+		/* Bound the crash-loss window of the file system's deferred
+		   updates, which are otherwise only written on a later close. */
+		if (activity_due(&syncing, now)) {
+			activity_start(&syncing, now);
+			sync_card();
+		}
 
-				//after image has been taken, put camera down into low-power mode
-				if (low_pow == 0){
-					if(arducam_low_power_set() != DEVICES_OK){
-						trace_printf("Error setting low power mode \n");
-					}
-					else{
-						trace_printf("Low power mode set \n");
-						low_pow = 1;
-					}
-				}
+		if (activity_due(&reporting, now)) {
+			activity_start(&reporting, now);
+			activity_report("sampling", &sampling);
+			activity_report("imaging", &imaging);
+			trace_printf("camera_task: samples dropped %lu, overwritten %lu, data ready missed %lu\n",
+					(unsigned long)sampleRing.Dropped,
+					(unsigned long)sampleRing.Overwritten,
+					(unsigned long)sampleDrdyMissed);
+		}
+
+		/* Sleep until the next deadline. */
+		TickType_t next = earliest(sampling.Deadline, reporting.Deadline);
+		next = earliest(next, syncing.Deadline);
+		if (arduCamInstalled) {
+			if (captureActive || captureLive || activity_due(&imaging, now)) {
+				next = earliest(next, now + CAPTURE_POLL_MS);
+			} else {
+				next = earliest(next, imaging.Deadline);
 			}
-			vTaskDelay(100);
 		}
+		vTaskDelayUntil(&now, next - now);
 	}
 
 }
@@ -0,0 +1,221 @@
+#include <task/i2c_task.h>
+#include "diag/Trace.h"
+
+QueueHandle_t xI2cQueue = NULL;
+
+/* Task notified by the I2C interrupts, and set by them if the transfer in
+   progress failed. */
+static TaskHandle_t xI2cTask = NULL;
+static volatile uint8_t i2cFailed;
+
+/* Clock speed of each device that does not use I2C_CLOCK_DEFAULT. */
+static struct {
+	uint8_t Device;
+	uint32_t ClockSpeed;
+} i2cSpeeds[I2C_MAX_DEVICE_SPEEDS];
+static uint8_t i2cSpeedCount;
+
+/**
+ * Set the clock speed used for a device. Transfers to devices that have
+ * not been set run at I2C_CLOCK_DEFAULT.
+ */
+Devices_StatusTypeDef
+i2c_device_speed(uint8_t device, uint32_t clockSpeed) {
+	uint8_t i;
+
+	device &= 0xFE;
+	taskENTER_CRITICAL();
+	for (i = 0; i < i2cSpeedCount && i2cSpeeds[i].Device != device; i++) {}
+	if (i == I2C_MAX_DEVICE_SPEEDS) {
+		taskEXIT_CRITICAL();
+		return DEVICES_ERROR;
+	}
+	i2cSpeeds[i].Device = device;
+	i2cSpeeds[i].ClockSpeed = clockSpeed;
+	if (i == i2cSpeedCount) {
+		i2cSpeedCount++;
+	}
+	taskEXIT_CRITICAL();
+	return DEVICES_OK;
+}
+
+/**
+ * Look up the clock speed of a device.
+ */
+static uint32_t
+i2c_speed_of(uint8_t device) {
+	uint32_t clockSpeed = I2C_CLOCK_DEFAULT;
+
+	device &= 0xFE;
+	taskENTER_CRITICAL();
+	for (uint8_t i = 0; i < i2cSpeedCount; i++) {
+		if (i2cSpeeds[i].Device == device) {
+			clockSpeed = i2cSpeeds[i].ClockSpeed;
+			break;
+		}
+	}
+	taskEXIT_CRITICAL();
+	return clockSpeed;
+}
+
+/**
+ * Queue a batch of transfers and block until the I2C task has run them.
+ * The transfers, and the buffers they point to, must stay valid until
+ * this returns. The I2C task answers on the calling task's notification,
+ * so tasks that call this must not be notified for anything else.
+ */
+Devices_StatusTypeDef
+i2c_transact(I2C_Transfer* transfers, uint8_t count) {
+	I2C_Request request = {
+		.Transfers = transfers,
+		.Count = count,
+		.Task = xTaskGetCurrentTaskHandle(),
+		.Status = DEVICES_ERROR
+	};
+	I2C_Request* pointer = &request;
+
+	if (xI2cQueue == NULL) {
+		return DEVICES_ERROR;
+	}
+
+	if (xQueueSend(xI2cQueue, &pointer, portMAX_DELAY) != pdTRUE) {
+		return DEVICES_ERROR;
+	}
+
+	/* Every request is answered, as each transfer has a timeout. */
+	ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+	return request.Status;
+}
+
+/**
+ * Reinitialize the peripheral after a transfer hung, and drop any
+ * notification from an interrupt that arrives late.
+ */
+static void
+i2c_reset() {
+	HAL_I2C_DeInit(&hi2c);
+	if (HAL_I2C_Init(&hi2c) != HAL_OK) {
+		trace_printf("i2c: reset failed\n");
+	}
+	ulTaskNotifyTake(pdTRUE, 0);
+}
+
+/**
+ * Wait for a transfer started on interrupts to finish.
+ */
+static Devices_StatusTypeDef
+i2c_wait(HAL_StatusTypeDef started) {
+	if (started != HAL_OK) {
+		return DEVICES_ERROR;
+	}
+
+	if (ulTaskNotifyTake(pdTRUE, I2C_TRANSFER_TIMEOUT_MS) == 0) {
+		trace_printf("i2c: transfer timed out\n");
+		i2c_reset();
+		return DEVICES_TIMEOUT;
+	}
+
+	return i2cFailed ? DEVICES_ERROR : DEVICES_OK;
+}
+
+/**
+ * Run one transfer at the clock speed of its device.
+ */
+static Devices_StatusTypeDef
+i2c_run(I2C_Transfer* transfer) {
+	Devices_StatusTypeDef result;
+	uint32_t clockSpeed = i2c_speed_of(transfer->Device);
+
+	if (hi2c.Init.ClockSpeed != clockSpeed) {
+		hi2c.Init.ClockSpeed = clockSpeed;
+		if (HAL_I2C_Init(&hi2c) != HAL_OK) {
+			trace_printf("i2c: speed change failed\n");
+			return DEVICES_ERROR;
+		}
+	}
+
+	if (transfer->WriteLength > 0) {
+		i2cFailed = 0;
+		result = i2c_wait(HAL_I2C_Master_Transmit_IT(&hi2c, transfer->Device,
+				(uint8_t*)transfer->Write, transfer->WriteLength));
+		if (result != DEVICES_OK) {
+			return result;
+		}
+	}
+
+	if (transfer->ReadLength > 0) {
+		i2cFailed = 0;
+		result = i2c_wait(HAL_I2C_Master_Receive_IT(&hi2c, transfer->Device,
+				transfer->Read, transfer->ReadLength));
+		if (result != DEVICES_OK) {
+			return result;
+		}
+	}
+
+	return DEVICES_OK;
+}
+
+/**
+ * Serve requests from xI2cQueue one at a time. The task sleeps while each
+ * transfer runs, so other tasks keep the CPU until the bus is done.
+ */
+void
+i2c_task(void * pvParameters) {
+	I2C_Request* request;
+
+	xI2cTask = xTaskGetCurrentTaskHandle();
+
+	for (;;) {
+		if (xQueueReceive(xI2cQueue, &request, portMAX_DELAY) != pdTRUE) {
+			continue;
+		}
+
+		request->Status = DEVICES_OK;
+		for (uint8_t i = 0; i < request->Count && request->Status == DEVICES_OK; i++) {
+			request->Status = i2c_run(&request->Transfers[i]);
+		}
+
+		xTaskNotifyGive(request->Task);
+	}
+}
+
+/* Interrupts --------------------------------------------------------------- */
+
+/**
+ * Wake the I2C task from an interrupt.
+ */
+static void
+i2c_done_from_isr() {
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+	if (xI2cTask != NULL) {
+		vTaskNotifyGiveFromISR(xI2cTask, &xHigherPriorityTaskWoken);
+	}
+	portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
+void
+HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef* hi2c) {
+	i2c_done_from_isr();
+}
+
+void
+HAL_I2C_MasterRxCpltCallback(I2C_HandleTypeDef* hi2c) {
+	i2c_done_from_isr();
+}
+
+void
+HAL_I2C_ErrorCallback(I2C_HandleTypeDef* hi2c) {
+	i2cFailed = 1;
+	i2c_done_from_isr();
+}
+
+void
+I2C1_EV_IRQHandler(void) {
+	HAL_I2C_EV_IRQHandler(&hi2c);
+}
+
+void
+I2C1_ER_IRQHandler(void) {
+	HAL_I2C_ER_IRQHandler(&hi2c);
+}
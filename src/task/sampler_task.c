@@ -0,0 +1,168 @@
+#include <peripheral/lps331.h>
+#include <peripheral/hts221.h>
+#include <task/sampler_task.h>
+#include "diag/Trace.h"
+
+SampleRing sampleRing;
+Sample sampleStorage[SAMPLE_RING_CAPACITY];
+
+/* Edges from the data ready interrupts, as SAMPLE_DRDY_* bits. */
+QueueHandle_t xDrdyQueue = NULL;
+
+uint8_t lps331Installed = 0;
+uint8_t hts221Installed = 0;
+
+/* Samples finished by a timeout rather than on data ready. */
+uint32_t sampleDrdyMissed = 0;
+
+/**
+ * Configure a data ready line as an interrupt on its rising edge.
+ */
+static void
+drdy_init(GPIO_TypeDef* port, uint16_t pin, IRQn_Type irq) {
+	GPIO_InitTypeDef gpio_init;
+
+	gpio_init.Pin = pin;
+	gpio_init.Mode = GPIO_MODE_IT_RISING;
+	gpio_init.Speed = GPIO_SPEED_LOW;
+	gpio_init.Pull = GPIO_PULLDOWN;
+	HAL_GPIO_Init(port, &gpio_init);
+
+	/* Below configMAX_SYSCALL_INTERRUPT_PRIORITY, to notify the task. */
+	HAL_NVIC_SetPriority(irq, 7, 0);
+	HAL_NVIC_EnableIRQ(irq);
+}
+
+/**
+ * Initialize the peripherals and state for this task.
+ */
+uint8_t
+sampler_task_setup() {
+	xDrdyQueue = xQueueCreate(SAMPLE_DRDY_QUEUE_LENGTH, sizeof(uint32_t));
+	if (   xDrdyQueue == NULL
+		|| sample_ring_init(&sampleRing, sampleStorage, SAMPLE_RING_CAPACITY,
+				SAMPLE_RING_POLICY, SAMPLE_RING_DECIMATION) != SAMPLE_RING_OK) {
+		return 0;
+	}
+
+	__HAL_RCC_GPIOA_CLK_ENABLE();
+	drdy_init(LPS331_DRDY_PORT, LPS331_DRDY_PIN, LPS331_DRDY_IRQn);
+	drdy_init(HTS221_DRDY_PORT, HTS221_DRDY_PIN, HTS221_DRDY_IRQn);
+
+	lps331Installed = lps331_init();
+	hts221Installed = hts221_init();
+	return lps331Installed || hts221Installed;
+}
+
+/**
+ * Start a conversion on each sensor and read each one as it finishes.
+ * A sensor that fails to start or to be read gives SAMPLE_NO_READING.
+ */
+void
+take_sample(Sample* sample) {
+	uint32_t pending = 0;
+	uint32_t bits;
+
+	sample->LPS331Temperature = SAMPLE_NO_READING;
+	sample->LPS331Pressure = SAMPLE_NO_READING;
+	sample->HTS221Temperature = SAMPLE_NO_READING;
+	sample->HTS221Humidity = SAMPLE_NO_READING;
+
+	/* Drop any edge left over from an earlier conversion. */
+	xQueueReset(xDrdyQueue);
+
+	if (lps331Installed && lps331_start() == DEVICES_OK) {
+		pending |= SAMPLE_DRDY_LPS331;
+	}
+	if (hts221Installed && hts221_start() == DEVICES_OK) {
+		pending |= SAMPLE_DRDY_HTS221;
+	}
+
+	TickType_t started = xTaskGetTickCount();
+	while (pending) {
+		TickType_t waited = xTaskGetTickCount() - started;
+		bits = 0;
+		if (waited < SAMPLE_DRDY_TIMEOUT_MS) {
+			if (xQueueReceive(xDrdyQueue, &bits, SAMPLE_DRDY_TIMEOUT_MS - waited) != pdTRUE) {
+				bits = 0;
+			}
+			bits &= pending;
+		} else {
+			/* Out of time: read whatever is left. */
+			sampleDrdyMissed++;
+			bits = pending;
+		}
+
+		if (bits & SAMPLE_DRDY_LPS331) {
+			LPS331_SampleTypeDef lps331;
+			if (lps331_read_sample(&lps331) == DEVICES_OK) {
+				sample->LPS331Temperature = lps331_temp_cC(lps331.Temperature);
+				sample->LPS331Pressure = lps331_pres_Pa(lps331.Pressure);
+			}
+		}
+		if (bits & SAMPLE_DRDY_HTS221) {
+			HTS221_SampleTypeDef hts221;
+			if (hts221_read_sample(&hts221) == DEVICES_OK) {
+				sample->HTS221Temperature = hts221_temp_cC(hts221.Temperature);
+				sample->HTS221Humidity = hts221_hum_crH(hts221.Humidity);
+			}
+		}
+		pending &= ~bits;
+	}
+
+	sample->TickCount = xTaskGetTickCount();
+}
+
+/**
+ * Take a sample every SAMPLE_RATE_MS and pass it to the camera task.
+ */
+void
+sampler_task(void * pvParameters) {
+	if (!sampler_task_setup()) {
+		trace_printf("sampler_task: no sensors\n");
+		vTaskDelete(NULL);
+		return;
+	}
+	trace_printf("sampler_task: started\n");
+
+	TickType_t wake = xTaskGetTickCount();
+	for (;;) {
+		Sample sample;
+		take_sample(&sample);
+
+		/* The ring counts any sample its policy drops. */
+		sample_ring_put(&sampleRing, &sample, SAMPLE_BLOCK_MS);
+
+		vTaskDelayUntil(&wake, SAMPLE_RATE_MS);
+	}
+}
+
+/* Interrupts --------------------------------------------------------------- */
+
+void
+HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin) {
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+	uint32_t bits = 0;
+
+	if (GPIO_Pin == LPS331_DRDY_PIN) {
+		bits = SAMPLE_DRDY_LPS331;
+	} else if (GPIO_Pin == HTS221_DRDY_PIN) {
+		bits = SAMPLE_DRDY_HTS221;
+	}
+
+	/* A full queue already holds an edge from each sensor. */
+	if (bits && xDrdyQueue != NULL) {
+		xQueueSendFromISR(xDrdyQueue, &bits, &xHigherPriorityTaskWoken);
+	}
+	portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
+void
+EXTI0_IRQHandler(void) {
+	HAL_GPIO_EXTI_IRQHandler(LPS331_DRDY_PIN);
+}
+
+void
+EXTI1_IRQHandler(void) {
+	HAL_GPIO_EXTI_IRQHandler(HTS221_DRDY_PIN);
+}
@@ -1,9 +1,12 @@
 #include <peripheral/skywire.h>
+#include <peripheral/arducam.h>
 #include <peripheral/virtual_com.h>
 #include <peripheral/i2c_spi_bus.h>
 #include <task/skywire_task.h>
 #include <task/beacon_task.h>
+#include <task/camera_task.h>
 #include <hayes.h>
+#include <jpeg.h>
 #include <stdio.h>
 #include <string.h>
 #include <fat_sl.h>
@@ -12,6 +15,13 @@
 /* Buffer for the Skywire modem communication. */
 char buffer[512];
 
+/* FIFO data lands at liveBuffer + 1; the spare byte takes the dummy. */
+uint8_t liveBuffer[LIVE_BURST_LENGTH + 1];
+
+volatile uint8_t liveWaiting = 0;
+QueueHandle_t xLiveQueue;
+QueueHandle_t xLiveResultQueue;
+
 /**
  * Activate the PDP context for socket communication with the Internet.
  */
@@ -89,118 +99,188 @@ skywire_task_setup(ATDevice* dev) {
 // POST manifest ---------------------------------------------------------------
 
 /**
- * Add a file to the manifest.
+ * Select up to max records from the tail of a log.
  */
-uint8_t
-add_to_manifest(Attachment** head, Attachment** tail, char* file) {
-	/* Get the size of the attachment. */
-	uint32_t length;
-	if ((length = f_filelength(file)) == 0) {
-		return 0;
-	}
+void
+get_run(RingLog* log, ManifestRun* run, uint16_t max) {
+	RingRecord record;
 
-	/* Allocate an entry for the manifest. */
-	Attachment* attachment;
-	attachment = (Attachment*)pvPortMalloc(sizeof(Attachment));
-	attachment->length = length;
-	attachment->next = NULL;
-	strncpy(attachment->name, file, 64);
+	rlog_cursor(log, &run->start);
+	run->end = run->start;
+	run->count = 0;
 
-	/* Add the attachment to the manifest. */
-	if (*head == NULL) {
-		*head = attachment;
-		*tail = *head;
-	} else {
-		(*tail)->next = attachment;
-		*tail = attachment;
+	while (   run->count < max
+		   && rlog_next(log, &run->end, &record) == RLOG_OK) {
+		run->count++;
 	}
+}
 
-	return 1;
+/**
+ * Total payload length of the records of a type in a run.
+ */
+uint32_t
+run_length(RingLog* log, ManifestRun* run, uint8_t type) {
+	RingCursor cursor = run->start;
+	RingRecord record;
+	uint32_t length = 0;
+	for (uint16_t i = 0; i < run->count; ++i) {
+		if (rlog_next(log, &cursor, &record) != RLOG_OK) {
+			break;
+		}
+		if (record.Header.Type == type) {
+			length += record.Header.Length;
+		}
+	}
+	return length;
 }
 
 /**
- * Construct a manifest of files to be sent to the server.
- * The manifest will contain data.log and any attached images.
+ * Select up to UPLOAD_MAX_RECORDS records from the data log. The sample
+ * records go into SAMPLE_ATTACHMENT and the SAME lines of unchanged scenes
+ * into SAME_ATTACHMENT, as sample_decode.py only reads sample records.
+ * The caller holds the SPI bus.
  */
-uint8_t
-get_manifest(Attachment** manifest) {
-	F_FILE* pxLog;
-	if ((pxLog = f_open("data.log", "r")) == NULL) {
-		trace_printf("skywire_task: failed to open data.log\n");
-		return 0;
+void
+get_data(Manifest* manifest) {
+	manifest->length = 0;
+	manifest->sameLength = 0;
+	manifest->samples.count = 0;
+	if (dataLog.Mounted) {
+		get_run(&dataLog, &manifest->samples, UPLOAD_MAX_RECORDS);
+		manifest->length = run_length(&dataLog, &manifest->samples, RLOG_TYPE_SAMPLE);
+		manifest->sameLength = run_length(&dataLog, &manifest->samples, RLOG_TYPE_SAME);
 	}
+}
 
-	/* Add data.log to the start of the manifest. */
-	Attachment* tail = NULL;
-	if (!add_to_manifest(manifest, &tail, "data.log")) {
-		goto error;
+/**
+ * Construct a manifest of records to be sent to the server.
+ * Takes at most UPLOAD_MAX_RECORDS records from the data log,
+ * UPLOAD_MAX_IMAGES images from the image store and UPLOAD_MAX_THUMBNAILS
+ * thumbnails from the thumbnail store.
+ */
+uint8_t
+get_manifest(Manifest* manifest) {
+	manifest->images.count = 0;
+	manifest->thumbnails.count = 0;
+
+	get_data(manifest);
+	/* Images and thumbnails are attachments of their own. */
+	if (imageStore.Mounted) {
+		get_run(&imageStore, &manifest->images, UPLOAD_MAX_IMAGES);
+	}
+	if (thumbStore.Mounted) {
+		get_run(&thumbStore, &manifest->thumbnails, UPLOAD_MAX_THUMBNAILS);
 	}
 
-	/* Parse the data log and look for attachments. */
-	char line[128];
-	while (f_eof(pxLog) == 0) {
-		for (uint8_t i = 0; i < 128; ++i) {
-			char c = f_getc(pxLog);
-			if (c == '\n') {
-				line[i] = '\0';
-				break;
-			} else {
-				line[i] = c;
-			}
-		}
+	return (manifest->samples.count + manifest->images.count + manifest->thumbnails.count) > 0;
+}
 
-		if (memcmp(line, "FILE:", 5) == 0) {
-			int tick;
-			char file[64];
-			if (sscanf((line + 5), "{\"tick\":%d,\"file\":\"%[^\"]\"}", &tick, file) == 2) {
-				if (!add_to_manifest(manifest, &tail, file)) {
-					goto error;
-				}
-			}
+/**
+ * Release the records in a manifest once the server has them.
+ */
+void
+free_manifest(Manifest* manifest) {
+	if (manifest->samples.count > 0) {
+		rlog_consume(&dataLog, &manifest->samples.end);
+	}
+	if (manifest->images.count > 0) {
+		rlog_consume(&imageStore, &manifest->images.end);
+	}
+	if (manifest->thumbnails.count > 0) {
+		rlog_consume(&thumbStore, &manifest->thumbnails.end);
+	}
+	trace_printf("skywire_task: released %d samples, %d images, %d thumbnails\n",
+			manifest->samples.count, manifest->images.count, manifest->thumbnails.count);
+}
 
+/**
+ * Write the payload of a record to the modem.
+ * Returns 0 if the record cannot be read or written. The chunk is then
+ * short of its declared length, so the POST must be abandoned.
+ */
+uint8_t
+write_record(ATDevice* dev, RingLog* log, RingRecord* record) {
+	uint32_t written = 0;
+	while (written < record->Header.Length) {
+		uint32_t length = MIN(record->Header.Length - written, 128);
+		if (rlog_read(log, record, written, dev->buffer, length) != RLOG_OK) {
+			trace_printf("skywire_task: record %lu read failed\n",
+					(unsigned long)record->Header.Sequence);
+			return 0;
+		}
+		if (hayes_write(dev, (uint8_t*)dev->buffer, 0, length) != 0) {
+			trace_printf("skywire_task: modem write failed\n");
+			return 0;
 		}
+		written += length;
 	}
-
-	f_close(pxLog);
 	return 1;
+}
 
-error:
-	if (pxLog != NULL) { f_close(pxLog); }
-	return 0;
+/**
+ * Write the payload of each record of a type in a run of the data log to
+ * the modem. The caller holds the SPI bus.
+ * Returns 0 if a record cannot be read or written.
+ */
+uint8_t
+write_run(ATDevice* dev, ManifestRun* run, uint8_t type) {
+	RingCursor cursor = run->start;
+	RingRecord record;
+	for (uint16_t i = 0; i < run->count; ++i) {
+		if (rlog_next(&dataLog, &cursor, &record) != RLOG_OK) {
+			return 0;
+		}
+		if (record.Header.Type == type && !write_record(dev, &dataLog, &record)) {
+			return 0;
+		}
+	}
+	return 1;
 }
 
 /**
- * Delete all files in the manifest.
- * Free all memory associated with the manifest.
+ * Write the start of an HTTP chunk and its attachment header.
  */
 void
-free_manifest(Attachment* manifest, uint8_t deleteFiles) {
-	Attachment* next = NULL;
-	while (manifest != NULL) {
-		next = manifest->next;
-
-		/* Delete the file from the SD card. */
-		if (deleteFiles && (f_delete(manifest->name) == F_NO_ERROR)) {
-			trace_printf("skywire_task: removed %s\n", manifest->name);
-		}
+write_chunk_header(ATDevice* dev, char* name, uint32_t length) {
+	/* Write the start of the HTTP chunk. */
+	snprintf(dev->buffer, 32, "%lx\r\n", (unsigned long)(32 + length));
+	hayes_at(dev, dev->buffer);
+
+	/* Write the attachment header. */
+	memset(dev->buffer, '\0', 32);
+	snprintf(dev->buffer, 32, "%s,%lu\r\n", name, (unsigned long)length);
+	hayes_write(dev, (uint8_t*)dev->buffer, 0, 32);
+}
 
-		/* Free memory associated with this attachment. */
-		vPortFree(manifest);
+/**
+ * Write the records of the data log in a manifest as their attachments:
+ * SAMPLE_ATTACHMENT, always, and SAME_ATTACHMENT if there are any SAME
+ * lines. The caller holds the SPI bus.
+ * Returns 0 if a record cannot be read or written.
+ */
+uint8_t
+write_data(ATDevice* dev, Manifest* manifest) {
+	write_chunk_header(dev, SAMPLE_ATTACHMENT, manifest->length);
+	if (!write_run(dev, &manifest->samples, RLOG_TYPE_SAMPLE)) {
+		return 0;
+	}
+	hayes_at(dev, "\r\n");
 
-		manifest = next;
+	if (manifest->sameLength > 0) {
+		write_chunk_header(dev, SAME_ATTACHMENT, manifest->sameLength);
+		if (!write_run(dev, &manifest->samples, RLOG_TYPE_SAME)) {
+			return 0;
+		}
+		hayes_at(dev, "\r\n");
 	}
+	return 1;
 }
 
 /**
- * Use a POST to upload the manifest to the server.
- * Write slowly until we can support software flow control.
- *
- * Each HTTP chunk contains one attachment.
- * The first 32 bytes of the chunk encode the attachment length and filename.
- * Therefore, each HTTP chunk length is the attachment length plus 32 bytes.
+ * Open a socket to the server and write the HTTP header of a POST.
  */
 uint8_t
-post_manifest(ATDevice* dev, Attachment* manifest) {
+start_post(ATDevice* dev) {
 	if (   hayes_at(dev, "AT#SD=1,0,80,\"" NGROK_TUNNEL "\"\r\n") != HAYES_OK
 		|| hayes_res(dev, pred_ends_with, "CONNECT\r\n", 10000)   != HAYES_OK) {
 		trace_printf("skywire_task: open socket data failed\n");
@@ -217,39 +297,70 @@ post_manifest(ATDevice* dev, Attachment* manifest) {
 			"Transfer-Encoding: chunked\r\n" \
 			"Connection: close\r\n\r\n"
 	);
+	return 1;
+}
 
-	while (manifest != NULL) {
-		// Write file
-		F_FILE* pxFile = f_open(manifest->name, "r");
-		if (pxFile == NULL) {
-			trace_printf("failed to open file");
-			continue;
-		}
+/**
+ * Use a POST to upload the manifest to the server.
+ * Write slowly until we can support software flow control.
+ *
+ * Each HTTP chunk contains one attachment.
+ * The first 32 bytes of the chunk encode the attachment length and filename.
+ * Therefore, each HTTP chunk length is the attachment length plus 32 bytes.
+ *
+ * The first attachment is SAMPLE_ATTACHMENT, the payloads of the sample
+ * records back to back, a run of packed blocks and SampleRecords. If any
+ * frames were logged as unchanged, their SAME lines follow as
+ * SAME_ATTACHMENT. The thumbnails follow as thumb<seq>.pgm, so a preview of each image arrives
+ * ahead of the images themselves. Each image then follows as dcim<seq>.jpg,
+ * streamed straight out of the image store. The images carry their own
+ * tick count and sensor reading in a metadata segment.
+ *
+ * Returns 0 if a record cannot be read from the card. The POST is left
+ * without its last chunk, so the server never answers it, and the records
+ * stay in the logs for the next one.
+ */
+uint8_t
+post_manifest(ATDevice* dev, Manifest* manifest) {
+	if (!start_post(dev)) {
+		return 0;
+	}
 
-		/* Write the start of the HTTP chunk. */
-		int length = manifest->length;
-		snprintf(dev->buffer, 32, "%x\r\n", 32 +length);
-		hayes_at(dev, dev->buffer);
-
-		/* Write the attachment header. */
-		memset(dev->buffer, '\0', 32);
-		snprintf(dev->buffer, 32, "%s,%d\r\n", manifest->name, length);
-		hayes_write(dev, (uint8_t*)dev->buffer, 0, 32);
-
-		/* Write the attachment. */
-		uint32_t written = 0;
-		while (written < manifest->length) {
-			uint32_t read = f_read(dev->buffer, 1, 128, pxFile);
-			written += read;
-			hayes_write(dev, (uint8_t*)dev->buffer, 0, read);
-		}
+	/* Write the samples and the unchanged scenes. */
+	RingCursor cursor;
+	RingRecord record;
+	if (!write_data(dev, manifest)) {
+		return 0;
+	}
 
-		f_close(pxFile);
-		pxFile = NULL;
+	/* Write each thumbnail. */
+	cursor = manifest->thumbnails.start;
+	for (uint16_t i = 0; i < manifest->thumbnails.count; ++i) {
+		if (rlog_next(&thumbStore, &cursor, &record) != RLOG_OK) {
+			return 0;
+		}
+		char name[32];
+		snprintf(name, 32, "thumb%lu.pgm", (unsigned long)record.Header.Sequence);
+		write_chunk_header(dev, name, record.Header.Length);
+		if (!write_record(dev, &thumbStore, &record)) {
+			return 0;
+		}
+		hayes_at(dev, "\r\n");
+	}
 
-		/* Write the end of the HTTP chunk. */
+	/* Write each image. */
+	cursor = manifest->images.start;
+	for (uint16_t i = 0; i < manifest->images.count; ++i) {
+		if (rlog_next(&imageStore, &cursor, &record) != RLOG_OK) {
+			return 0;
+		}
+		char name[32];
+		snprintf(name, 32, "dcim%lu.jpg", (unsigned long)record.Header.Sequence);
+		write_chunk_header(dev, name, record.Header.Length);
+		if (!write_record(dev, &imageStore, &record)) {
+			return 0;
+		}
 		hayes_at(dev, "\r\n");
-		manifest = manifest->next;
 	}
 
 	/* Write the trailing HTTP chunk and termination. */
@@ -259,8 +370,12 @@ post_manifest(ATDevice* dev, Attachment* manifest) {
 
 // Task ------------------------------------------------------------------------
 
+/**
+ * Read the server's response: the speed limit, and the seconds of records
+ * it asks to have uploaded again after losing them, or 0.
+ */
 uint8_t
-parse_response(ATDevice* dev, uint8_t* speedLimit) {
+parse_response(ATDevice* dev, uint8_t* speedLimit, uint32_t* resend) {
 	/**
 	 * Expect a 200 OK response.
 	 * Skip the headers by looking for "\r\n\r\n".
@@ -274,9 +389,13 @@ parse_response(ATDevice* dev, uint8_t* speedLimit) {
 	}
 
 	int sl = 0;
+	unsigned long seconds;
 	char* line = NULL;
+	*resend = 0;
 	while ((line = tokenize_res(dev, line)) != NULL) {
-		if (sscanf(line, "SL=%d,EOM", &sl) == 1) {
+		if (sscanf(line, "RESEND=%lu", &seconds) == 1) {
+			*resend = MIN(seconds, RESEND_MAX_S);
+		} else if (sscanf(line, "SL=%d,EOM", &sl) == 1) {
 			//adding line to see if incoming SL value is good
 			if (sl >= 1 && sl <= 255){
 				*speedLimit = sl;
@@ -288,6 +407,224 @@ parse_response(ATDevice* dev, uint8_t* speedLimit) {
 	return 0;
 }
 
+/**
+ * Move the tails of the logs back over the records of the last seconds,
+ * so they go up again with the next POSTs. Records overwritten since are
+ * not recovered. The caller holds the SPI bus.
+ */
+void
+resend_records(uint32_t seconds) {
+	TickType_t since = xTaskGetTickCount() - seconds * 1000 / portTICK_PERIOD_MS;
+	RingLog* logs[] = { &dataLog, &thumbStore, &imageStore };
+	for (uint8_t i = 0; i < sizeof(logs) / sizeof(logs[0]); ++i) {
+		if (logs[i]->Mounted && rlog_rewind(logs[i], since) == RLOG_ERROR) {
+			trace_printf("skywire_task: rewind failed\n");
+		}
+	}
+	trace_printf("skywire_task: resending the last %lu s\n", (unsigned long)seconds);
+}
+
+// POST live image -------------------------------------------------------------
+
+/**
+ * Write a buffer to the modem in pieces hayes_write() can take.
+ */
+uint8_t
+write_buffer(ATDevice* dev, uint8_t* data, uint32_t length) {
+	uint32_t written = 0;
+	while (written < length) {
+		uint8_t piece = MIN(length - written, 128);
+		if (hayes_write(dev, data + written, 0, piece) != 0) {
+			return 0;
+		}
+		written += piece;
+	}
+	return 1;
+}
+
+/**
+ * Read the next burst of the camera FIFO into liveBuffer + 1, holding the
+ * SPI bus only for the read. The first burst of the FIFO starts with the
+ * dummy byte, which lands in liveBuffer[0].
+ */
+uint8_t
+read_live_burst(uint8_t first, uint16_t length) {
+	uint8_t* burst = first ? liveBuffer : liveBuffer + 1;
+	while (!spi_take()) {
+		vTaskDelay(1);
+	}
+	Devices_StatusTypeDef status = arducam_burst_read(burst, (liveBuffer + 1 + length) - burst);
+	spi_give();
+	if (status != DEVICES_OK) {
+		trace_printf("skywire_task: FIFO read failed\n");
+		return 0;
+	}
+	return 1;
+}
+
+/**
+ * Find the length of the JPG image in the camera FIFO, up to and including
+ * its EOI marker, and rewind the FIFO for the upload. A FIFO with no EOI
+ * marker is taken whole.
+ * Returns 0 if the FIFO does not hold a JPG image or cannot be read.
+ */
+uint32_t
+measure_live(LiveImage* live) {
+	uint32_t fifoLength = live->Length - 1;
+	uint32_t frameLength = 0;
+	JpegScanner scanner = { 0 };
+	for (uint32_t read = 0; read < fifoLength && frameLength == 0; ) {
+		uint16_t length = MIN(fifoLength - read, LIVE_BURST_LENGTH);
+		if (!read_live_burst(read == 0, length)) {
+			return 0;
+		}
+
+		/* The tables may hold FF D9, so only the entropy coded data after
+		   the headers is scanned for EOI. */
+		uint32_t start = 0;
+		if (read == 0) {
+			if (!jpeg_check_soi(liveBuffer + 1, length)) {
+				trace_printf("skywire_task: FIFO does not hold a JPG image\n");
+				return 0;
+			}
+			if ((start = jpeg_header_length(liveBuffer + 1, length)) == 0) {
+				start = 2;
+			}
+		}
+		uint32_t end = jpeg_find_eoi(&scanner, liveBuffer + 1 + start, length - start);
+		if (end != 0) {
+			frameLength = read + start + end;
+		}
+		read += length;
+	}
+	if (frameLength == 0) {
+		frameLength = fifoLength;
+	}
+
+	while (!spi_take()) {
+		vTaskDelay(1);
+	}
+	Devices_StatusTypeDef status = arducam_fifo_rewind();
+	spi_give();
+	if (status != DEVICES_OK) {
+		trace_printf("skywire_task: FIFO rewind failed\n");
+		return 0;
+	}
+	return frameLength;
+}
+
+/**
+ * Use a POST to upload the pending samples and an image straight out of the
+ * camera FIFO, without storing the image on the SD card.
+ *
+ * The SPI bus is only held for each FIFO burst, and the burst is written to
+ * the modem before the next is read. The UART writes block, so the readout
+ * runs at the pace of the modem while the camera task can still write
+ * samples between bursts.
+ *
+ * The chunk length has to be sent before the image, so the FIFO is read
+ * through once to find the EOI marker before the POST starts. The
+ * attachment is then declared as the image up to EOI plus the metadata
+ * segment, and exactly that much is sent.
+ *
+ * Returns the length of the image, or 0 if it was not uploaded.
+ */
+uint32_t
+post_live(ATDevice* dev, LiveImage* live, uint8_t* speedLimit) {
+	uint32_t frameLength = measure_live(live);
+	if (frameLength == 0 || !start_post(dev)) {
+		return 0;
+	}
+
+	/* Write the samples and the unchanged scenes. */
+	Manifest manifest;
+	while (!spi_take()) {
+		vTaskDelay(10);
+	}
+	manifest.images.count = 0;
+	manifest.thumbnails.count = 0;
+	get_data(&manifest);
+	uint8_t wrote = write_data(dev, &manifest);
+	spi_give();
+	if (!wrote) {
+		return 0;
+	}
+
+	/* Write the image, with the metadata segment after its SOI marker. */
+	uint32_t imageLength = frameLength + live->MetadataLength;
+	char name[32];
+	snprintf(name, 32, "live%lu.jpg", (unsigned long)live->TickCount);
+	write_chunk_header(dev, name, imageLength);
+
+	for (uint32_t sent = 0; sent < frameLength; ) {
+		uint16_t length = MIN(frameLength - sent, LIVE_BURST_LENGTH);
+		uint32_t skip = 0;
+		if (!read_live_burst(sent == 0, length)) {
+			return 0;
+		}
+		if (sent == 0) {
+			if (   !write_buffer(dev, liveBuffer + 1, 2)
+				|| !write_buffer(dev, live->Metadata, live->MetadataLength)) {
+				trace_printf("skywire_task: modem write failed\n");
+				return 0;
+			}
+			skip = 2;
+		}
+		if (!write_buffer(dev, liveBuffer + 1 + skip, length - skip)) {
+			trace_printf("skywire_task: modem write failed\n");
+			return 0;
+		}
+		sent += length;
+	}
+	hayes_at(dev, "\r\n");
+
+	/* Write the trailing HTTP chunk and termination. */
+	hayes_at(dev, "0\r\n\r\n");
+
+	uint32_t resend;
+	if (!parse_response(dev, speedLimit, &resend)) {
+		return 0;
+	}
+
+	/* Server returned 200 OK - safe to release the samples. */
+	while (!spi_take()) {
+		vTaskDelay(10);
+	}
+	free_manifest(&manifest);
+	if (resend > 0) {
+		resend_records(resend);
+	}
+	spi_give();
+
+	trace_printf("skywire_task: streamed %lu byte image\n", (unsigned long)imageLength);
+	return imageLength;
+}
+
+/**
+ * Wait out the upload interval for an image from the camera task and
+ * stream it to the server. The result is passed back on xLiveResultQueue.
+ * Returns 1 if the link is still up.
+ */
+uint8_t
+upload_live(ATDevice* dev) {
+	LiveImage live;
+	liveWaiting = 1;
+	BaseType_t received = xQueueReceive(xLiveQueue, &live, UPLOAD_INTERVAL_MS);
+	liveWaiting = 0;
+	if (received != pdTRUE) {
+		return 1;
+	}
+
+	SLUpdate slUpdate;
+	uint32_t imageLength = post_live(dev, &live, &slUpdate.limit);
+	xQueueSend(xLiveResultQueue, (void*)&imageLength, 0);
+	if (imageLength > 0) {
+		/* Post the updated speed limit to the beacon task. */
+		xQueueSend(xSLUpdatesQueue, (void*)&slUpdate, 0);
+	}
+	return imageLength > 0;
+}
+
 /**
  *
  */
@@ -301,6 +638,10 @@ skywire_task(void* pvParameters) {
 	dev.buffer = buffer;
 	dev.length = 512;
 
+	/* Images are handed over by the camera task one at a time. */
+	xLiveQueue = xQueueCreate(1, sizeof(LiveImage));
+	xLiveResultQueue = xQueueCreate(1, sizeof(uint32_t));
+
 	/* Initialize the peripherals and state for this task. */
 	if (!skywire_task_setup(&dev)) {
 		trace_printf("skywire_task: setup failed\n");
@@ -310,23 +651,32 @@ skywire_task(void* pvParameters) {
 		trace_printf("skywire_task: started\n");
 	}
 
+	/* Whether the last POST reached the server. */
+	uint8_t linkUp = 1;
+
 	for (;;) {
 		/* Wait for exclusive access to the SPI bus. */
 		while (!spi_take()) {
 			vTaskDelay(100);
 		}
 
-		/* Get a manifest of files to POST to the server. */
-		Attachment* manifest;
-		uint8_t deleteFiles = 0;
+		/* Get a manifest of records to POST to the server. */
+		Manifest manifest;
 		if (get_manifest(&manifest)) {
-			/* POST the files in the manifest to the server. */
-			if (post_manifest(&dev, manifest)) {
+			/* POST the records in the manifest to the server. */
+			linkUp = 0;
+			if (post_manifest(&dev, &manifest)) {
 				/* Parse the HTTP response from the server. */
 				SLUpdate slUpdate;
-				if (parse_response(&dev, &slUpdate.limit)) {
-					/* Server returned 200 OK - safe to delete the local data. */
-					deleteFiles = 1;
+				uint32_t resend;
+				if (parse_response(&dev, &slUpdate.limit, &resend)) {
+					linkUp = 1;
+
+					/* Server returned 200 OK - safe to release the local data. */
+					free_manifest(&manifest);
+					if (resend > 0) {
+						resend_records(resend);
+					}
 
 					/* Post the updated speed limit to the beacon task. */
 					xQueueSend(xSLUpdatesQueue, (void*)&slUpdate, 0);
@@ -334,14 +684,18 @@ skywire_task(void* pvParameters) {
 			}
 		}
 
-		/* Delete all of the files POSTed to the server */
-		free_manifest(manifest, deleteFiles);
+		/* With the link up and no images waiting on the SD card, the next
+		   image can go straight from the camera to the server. */
+		uint8_t live = linkUp && (!imageStore.Mounted || rlog_used(&imageStore) == 0);
 
 		/* Release exclusive access to the SPI bus. */
 		spi_give();
 
-		// Sleep for 1 minute.
-		vTaskDelay(30000);
+		if (live) {
+			linkUp = upload_live(&dev);
+		} else {
+			vTaskDelay(UPLOAD_INTERVAL_MS);
+		}
 	}
 
 }
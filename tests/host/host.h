@@ -0,0 +1,112 @@
+/**
+ * Fakes the host tests link in place of the hardware and the scheduler.
+ *
+ * The tests run single threaded. Time only moves when the code under test
+ * delays or a test advances hostTicks itself.
+ */
+
+#ifndef _HOST_H_
+#define _HOST_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "fat_sl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Fail the test with the file and line of the first false condition. */
+#define CHECK(condition) do { \
+		if (!(condition)) { \
+			printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #condition); \
+			exit(1); \
+		} \
+	} while (0)
+
+/* Scheduler: the tick count, and whether trace_printf() output is shown. */
+extern TickType_t hostTicks;
+extern uint8_t hostTrace;
+
+/* RAM disk behind host_disk_initfunc. Sector writes are counted per
+   sector and reads in total, and the sector in hostDiskBadRead fails every
+   read. */
+#define HOST_SECTOR_SIZE 512
+extern uint8_t* hostDisk;
+extern unsigned long hostDiskSectors;
+extern unsigned long* hostDiskWrites;
+extern unsigned long hostDiskReads;
+extern unsigned long hostDiskBadRead;
+
+void host_disk_create(unsigned long sectors);
+void host_disk_destroy(void);
+unsigned long host_disk_writes(void);
+F_DRIVER* host_disk_initfunc(unsigned long driver_param);
+
+/* Camera behind the ArduCAM and OV5642 calls. The FIFO holds a dummy byte
+   and then the frames, and every burst read is counted. A capture is done
+   after hostCapturePolls polls. The SPI bus can be taken by one caller at
+   a time, and hostSpiHeld is set while it is. Each qscale set is counted,
+   and must be in the OV5642 range. */
+extern uint8_t* hostFifo;
+extern uint32_t hostFifoLength;
+extern uint32_t hostFifoPosition;
+extern unsigned long hostFifoBursts;
+extern unsigned long hostFifoBurstBytes;
+extern uint16_t hostFifoMaxBurst;
+extern uint8_t hostCapturePolls;
+extern uint8_t hostQscale;
+extern unsigned long hostQscaleWrites;
+extern uint8_t hostSpiHeld;
+
+void host_fifo_load(const uint8_t* frame, uint32_t length, uint32_t padding);
+
+/* Skywire modem behind skywire_write(). Everything written is kept in
+   hostModemTx. AT#SD connects, and the end of a POST gets a 200 OK with a
+   speed limit unless hostModemAnswer is cleared. Writes past
+   hostModemFailAfter bytes fail. */
+extern uint8_t* hostModemTx;
+extern uint32_t hostModemTxLength;
+extern uint32_t hostModemFailAfter;
+extern uint8_t hostModemAnswer;
+
+void host_modem_reset(void);
+
+/* Baseline JPEG encoder for test frames. */
+typedef struct _HostJpegOptions {
+	uint16_t Width;
+	uint16_t Height;
+	uint8_t Components;        /* 1 for grey, else YCbCr */
+	uint8_t H;                 /* Luma sampling factors, chroma is 1x1 */
+	uint8_t V;
+	uint8_t Quality;           /* 1 to 100, 0 for 75 */
+	uint16_t RestartInterval;
+	uint16_t Padding;          /* Length of an APP1 segment ahead of the tables */
+} HostJpegOptions;
+
+typedef uint8_t (*HostJpegPixel)(void* context, uint32_t x, uint32_t y, uint8_t component);
+
+uint32_t host_jpeg_encode(const HostJpegOptions* options, HostJpegPixel pixel, void* context,
+		uint8_t* out, uint32_t capacity, uint8_t* means);
+
+/* Frames captured through the camera task on a RAM disk, checked against
+   the last stored image as the task does. */
+typedef struct _HostSceneFrame {
+	uint8_t Stored;            /* Went to the image store */
+	uint8_t Same;              /* Logged as unchanged instead */
+	uint8_t Decoded;           /* Signature holds the frame's signature */
+	uint8_t Cells;             /* Cells changed from the last stored image */
+	uint8_t Signature[64];     /* JPEG_SIGNATURE_CELLS */
+} HostSceneFrame;
+
+void host_scene_setup(void);
+void host_scene_frame(const uint8_t* frame, uint32_t length, uint32_t elapsed, HostSceneFrame* result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _HOST_H_ */
@@ -0,0 +1,114 @@
+#include "host.h"
+#include "peripheral/arducam.h"
+#include "peripheral/i2c_spi_bus.h"
+#include "mdriver_spi_sd.h"
+
+uint8_t* hostFifo = NULL;
+uint32_t hostFifoLength = 0;
+uint32_t hostFifoPosition = 0;
+unsigned long hostFifoBursts = 0;
+unsigned long hostFifoBurstBytes = 0;
+uint16_t hostFifoMaxBurst = 0;
+uint8_t hostCapturePolls = 3;
+uint8_t hostQscale = 8;
+unsigned long hostQscaleWrites = 0;
+uint8_t hostSpiHeld = 0;
+
+static uint8_t polls;
+static OV5642_Profile profile;
+
+/**
+ * Fill the FIFO with a frame behind the dummy byte, followed by padding.
+ */
+void
+host_fifo_load(const uint8_t* frame, uint32_t length, uint32_t padding) {
+	free(hostFifo);
+	hostFifoLength = 1 + length + padding;
+	hostFifo = calloc(hostFifoLength, 1);
+	hostFifo[0] = 0xAA;
+	memcpy(hostFifo + 1, frame, length);
+	hostFifoPosition = 0;
+}
+
+uint8_t arducam_init() { return 1; }
+Devices_StatusTypeDef arducam_set_frames(uint8_t frames) { return DEVICES_OK; }
+Devices_StatusTypeDef arducam_low_power_set() { return DEVICES_OK; }
+Devices_StatusTypeDef arducam_low_power_remove() { return DEVICES_OK; }
+
+Devices_StatusTypeDef
+arducam_start_capture() {
+	polls = 0;
+	hostFifoPosition = 0;
+	return DEVICES_OK;
+}
+
+Devices_StatusTypeDef
+arducam_capture_done(uint8_t* done) {
+	*done = ++polls >= hostCapturePolls;
+	return DEVICES_OK;
+}
+
+Devices_StatusTypeDef
+arducam_capture_length(uint32_t* capture_length) {
+	*capture_length = hostFifoLength;
+	return DEVICES_OK;
+}
+
+Devices_StatusTypeDef
+arducam_fifo_rewind() {
+	hostFifoPosition = 0;
+	return DEVICES_OK;
+}
+
+Devices_StatusTypeDef
+arducam_burst_read(uint8_t* buffer, uint16_t length) {
+	if (hostFifoPosition + length > hostFifoLength) {
+		return DEVICES_ERROR;
+	}
+	memcpy(buffer, hostFifo + hostFifoPosition, length);
+	hostFifoPosition += length;
+	hostFifoBursts++;
+	hostFifoBurstBytes += length;
+	hostFifoMaxBurst = (length > hostFifoMaxBurst) ? length : hostFifoMaxBurst;
+	return DEVICES_OK;
+}
+
+uint8_t ov5642_init() { return 1; }
+Devices_StatusTypeDef ov5642_set_window(const OV5642_Window* window) { return DEVICES_OK; }
+OV5642_Profile ov5642_get_profile() { return profile; }
+uint8_t ov5642_get_qscale() { return hostQscale; }
+
+Devices_StatusTypeDef
+ov5642_set_profile(OV5642_Profile next) {
+	profile = next;
+	return DEVICES_OK;
+}
+
+Devices_StatusTypeDef
+ov5642_set_qscale(uint8_t qscale) {
+	CHECK(qscale >= OV5642_QSCALE_MIN && qscale <= OV5642_QSCALE_MAX);
+	hostQscale = qscale;
+	hostQscaleWrites++;
+	return DEVICES_OK;
+}
+
+/* The SPI bus is held by one caller at a time. */
+uint8_t
+spi_take() {
+	if (hostSpiHeld) {
+		return 0;
+	}
+	hostSpiHeld = 1;
+	return 1;
+}
+
+void
+spi_give() {
+	CHECK(hostSpiHeld);
+	hostSpiHeld = 0;
+}
+
+F_DRIVER*
+mmc_spi_initfunc(unsigned long driver_param) {
+	return host_disk_initfunc(driver_param);
+}
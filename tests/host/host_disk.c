@@ -0,0 +1,84 @@
+#include "host.h"
+
+uint8_t* hostDisk = NULL;
+unsigned long hostDiskSectors = 0;
+unsigned long* hostDiskWrites = NULL;
+unsigned long hostDiskReads = 0;
+unsigned long hostDiskBadRead = (unsigned long)-1;
+
+static F_DRIVER driver;
+
+static int
+host_disk_write(F_DRIVER* drv, void* data, unsigned long sector) {
+	if (sector >= hostDiskSectors) {
+		return 1;
+	}
+	memcpy(hostDisk + sector * HOST_SECTOR_SIZE, data, HOST_SECTOR_SIZE);
+	hostDiskWrites[sector]++;
+	return 0;
+}
+
+static int
+host_disk_read(F_DRIVER* drv, void* data, unsigned long sector) {
+	if (sector >= hostDiskSectors || sector == hostDiskBadRead) {
+		return 1;
+	}
+	memcpy(data, hostDisk + sector * HOST_SECTOR_SIZE, HOST_SECTOR_SIZE);
+	hostDiskReads++;
+	return 0;
+}
+
+static int
+host_disk_getphy(F_DRIVER* drv, F_PHY* phy) {
+	phy->number_of_sectors = hostDiskSectors;
+	phy->sector_per_track = 63;
+	phy->number_of_heads = 255;
+	phy->bytes_per_sector = HOST_SECTOR_SIZE;
+	phy->media_descriptor = F_MEDIADESC_REMOVABLE;
+	return 0;
+}
+
+/**
+ * Create a blank disk of the given number of sectors.
+ */
+void
+host_disk_create(unsigned long sectors) {
+	host_disk_destroy();
+	hostDisk = calloc(sectors, HOST_SECTOR_SIZE);
+	hostDiskWrites = calloc(sectors, sizeof(unsigned long));
+	hostDiskSectors = sectors;
+	hostDiskBadRead = (unsigned long)-1;
+}
+
+/**
+ * Total of the sector writes.
+ */
+unsigned long
+host_disk_writes(void) {
+	unsigned long writes = 0;
+	for (unsigned long sector = 0; sector < hostDiskSectors; sector++) {
+		writes += hostDiskWrites[sector];
+	}
+	return writes;
+}
+
+void
+host_disk_destroy(void) {
+	free(hostDisk);
+	free(hostDiskWrites);
+	hostDisk = NULL;
+	hostDiskWrites = NULL;
+	hostDiskSectors = 0;
+}
+
+/**
+ * Driver init function for fn_initvolume().
+ */
+F_DRIVER*
+host_disk_initfunc(unsigned long driver_param) {
+	memset(&driver, 0, sizeof(driver));
+	driver.writesector = host_disk_write;
+	driver.readsector = host_disk_read;
+	driver.getphy = host_disk_getphy;
+	return &driver;
+}
@@ -0,0 +1,355 @@
+/**
+ * Baseline JPEG encoder for making test frames, with the example tables of
+ * ITU T.81 Annex K scaled for quality as libjpeg does.
+ */
+
+#include <math.h>
+
+#include "host.h"
+
+static const uint8_t zigzag[64] = {
+	 0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+	12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+	35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+	58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63
+};
+
+static const uint8_t lumaQuant[64] = {
+	16, 11, 10, 16,  24,  40,  51,  61,  12, 12, 14, 19,  26,  58,  60,  55,
+	14, 13, 16, 24,  40,  57,  69,  56,  14, 17, 22, 29,  51,  87,  80,  62,
+	18, 22, 37, 56,  68, 109, 103,  77,  24, 35, 55, 64,  81, 104, 113,  92,
+	49, 64, 78, 87, 103, 121, 120, 101,  72, 92, 95, 98, 112, 100, 103,  99
+};
+
+static const uint8_t chromaQuant[64] = {
+	17, 18, 24, 47, 99, 99, 99, 99,  18, 21, 26, 66, 99, 99, 99, 99,
+	24, 26, 56, 99, 99, 99, 99, 99,  47, 66, 99, 99, 99, 99, 99, 99,
+	99, 99, 99, 99, 99, 99, 99, 99,  99, 99, 99, 99, 99, 99, 99, 99,
+	99, 99, 99, 99, 99, 99, 99, 99,  99, 99, 99, 99, 99, 99, 99, 99
+};
+
+/* Code lengths and values of the four example Huffman tables. */
+static const uint8_t dcLumaBits[16] = { 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 };
+static const uint8_t dcChromaBits[16] = { 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 };
+static const uint8_t dcValues[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+
+static const uint8_t acLumaBits[16] = { 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7D };
+static const uint8_t acLumaValues[162] = {
+	0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+	0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xA1, 0x08, 0x23, 0x42, 0xB1, 0xC1, 0x15, 0x52, 0xD1, 0xF0,
+	0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0A, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x25, 0x26, 0x27, 0x28,
+	0x29, 0x2A, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+	0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+	0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+	0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7,
+	0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5,
+	0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xE1, 0xE2,
+	0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+	0xF9, 0xFA
+};
+
+static const uint8_t acChromaBits[16] = { 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 };
+static const uint8_t acChromaValues[162] = {
+	0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+	0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xA1, 0xB1, 0xC1, 0x09, 0x23, 0x33, 0x52, 0xF0,
+	0x15, 0x62, 0x72, 0xD1, 0x0A, 0x16, 0x24, 0x34, 0xE1, 0x25, 0xF1, 0x17, 0x18, 0x19, 0x1A, 0x26,
+	0x27, 0x28, 0x29, 0x2A, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+	0x49, 0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+	0x69, 0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+	0x88, 0x89, 0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5,
+	0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3,
+	0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA,
+	0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+	0xF9, 0xFA
+};
+
+typedef struct _HuffmanCodes {
+	uint16_t Code[256];
+	uint8_t Size[256];
+} HuffmanCodes;
+
+typedef struct _Encoder {
+	uint8_t* Out;
+	uint32_t Capacity;
+	uint32_t Length;
+	uint32_t Bits;
+	uint8_t BitCount;
+	uint8_t Quant[2][64];
+	HuffmanCodes Dc[2];
+	HuffmanCodes Ac[2];
+	int16_t Predictor[3];
+} Encoder;
+
+static double cosines[8][8];
+
+static void
+put_byte(Encoder* encoder, uint8_t byte) {
+	CHECK(encoder->Length < encoder->Capacity);
+	encoder->Out[encoder->Length++] = byte;
+}
+
+static void
+put_word(Encoder* encoder, uint16_t word) {
+	put_byte(encoder, word >> 8);
+	put_byte(encoder, word & 0xFF);
+}
+
+static void
+put_bits(Encoder* encoder, uint32_t value, uint8_t count) {
+	encoder->Bits = (encoder->Bits << count) | (value & ((1UL << count) - 1));
+	encoder->BitCount += count;
+	while (encoder->BitCount >= 8) {
+		uint8_t byte = encoder->Bits >> (encoder->BitCount - 8);
+		put_byte(encoder, byte);
+		if (byte == 0xFF) {
+			put_byte(encoder, 0x00);
+		}
+		encoder->BitCount -= 8;
+	}
+}
+
+/* Pad the last byte with ones, as before a marker. */
+static void
+flush_bits(Encoder* encoder) {
+	if (encoder->BitCount > 0) {
+		put_bits(encoder, 0x7F, 8 - encoder->BitCount);
+	}
+	encoder->Bits = 0;
+}
+
+static void
+build_codes(HuffmanCodes* codes, const uint8_t bits[16], const uint8_t* values) {
+	uint16_t code = 0;
+	uint16_t k = 0;
+	for (uint8_t length = 1; length <= 16; ++length) {
+		for (uint8_t i = 0; i < bits[length - 1]; ++i, ++k) {
+			codes->Code[values[k]] = code++;
+			codes->Size[values[k]] = length;
+		}
+		code <<= 1;
+	}
+}
+
+static void
+put_table(Encoder* encoder, uint8_t id, const uint8_t bits[16], const uint8_t* values) {
+	uint16_t total = 0;
+	for (uint8_t i = 0; i < 16; ++i) {
+		total += bits[i];
+	}
+	put_byte(encoder, id);
+	for (uint8_t i = 0; i < 16; ++i) {
+		put_byte(encoder, bits[i]);
+	}
+	for (uint16_t i = 0; i < total; ++i) {
+		put_byte(encoder, values[i]);
+	}
+}
+
+/* Magnitude category of a coefficient. */
+static uint8_t
+category(int32_t value) {
+	uint8_t size = 0;
+	value = (value < 0) ? -value : value;
+	while (value > 0) {
+		size++;
+		value >>= 1;
+	}
+	return size;
+}
+
+static void
+put_value(Encoder* encoder, int32_t value, uint8_t size) {
+	put_bits(encoder, (value < 0) ? value - 1 : value, size);
+}
+
+/* Transform, quantise and code one block of samples, level shifted. */
+static int32_t
+encode_block(Encoder* encoder, const double samples[64], uint8_t table, int16_t* predictor) {
+	double rows[64];
+	int32_t coefficients[64];
+
+	for (int y = 0; y < 8; ++y) {
+		for (int u = 0; u < 8; ++u) {
+			double sum = 0;
+			for (int x = 0; x < 8; ++x) {
+				sum += samples[y * 8 + x] * cosines[u][x];
+			}
+			rows[y * 8 + u] = sum;
+		}
+	}
+	for (int u = 0; u < 8; ++u) {
+		for (int v = 0; v < 8; ++v) {
+			double sum = 0;
+			for (int y = 0; y < 8; ++y) {
+				sum += rows[y * 8 + u] * cosines[v][y];
+			}
+			coefficients[v * 8 + u] = (int32_t)lround(sum / encoder->Quant[table][v * 8 + u]);
+		}
+	}
+
+	int32_t dc = coefficients[0];
+	int32_t diff = dc - *predictor;
+	*predictor = dc;
+	uint8_t size = category(diff);
+	put_bits(encoder, encoder->Dc[table].Code[size], encoder->Dc[table].Size[size]);
+	put_value(encoder, diff, size);
+
+	uint8_t run = 0;
+	for (int k = 1; k < 64; ++k) {
+		int32_t ac = coefficients[zigzag[k]];
+		if (ac == 0) {
+			run++;
+			continue;
+		}
+		while (run >= 16) {
+			put_bits(encoder, encoder->Ac[table].Code[0xF0], encoder->Ac[table].Size[0xF0]);
+			run -= 16;
+		}
+		size = category(ac);
+		uint8_t symbol = (run << 4) | size;
+		put_bits(encoder, encoder->Ac[table].Code[symbol], encoder->Ac[table].Size[symbol]);
+		put_value(encoder, ac, size);
+		run = 0;
+	}
+	if (run > 0) {
+		put_bits(encoder, encoder->Ac[table].Code[0x00], encoder->Ac[table].Size[0x00]);
+	}
+	return dc * encoder->Quant[table][0];
+}
+
+/**
+ * Encode an image of pixel() samples into out. Chroma is sampled at the
+ * top left pixel each chroma sample covers. If means is not NULL it gets
+ * the mean luma of each 8x8 block, the exact 1/8 scale image, in rows of
+ * (width + 7) / 8. Returns the length of the image.
+ */
+uint32_t
+host_jpeg_encode(const HostJpegOptions* options, HostJpegPixel pixel, void* context,
+		uint8_t* out, uint32_t capacity, uint8_t* means) {
+	Encoder encoder = { 0 };
+	encoder.Out = out;
+	encoder.Capacity = capacity;
+
+	for (int u = 0; u < 8; ++u) {
+		for (int x = 0; x < 8; ++x) {
+			cosines[u][x] = ((u == 0) ? sqrt(0.125) : 0.5) * cos((2 * x + 1) * u * M_PI / 16);
+		}
+	}
+	uint8_t quality = options->Quality ? options->Quality : 75;
+	int scale = (quality < 50) ? 5000 / quality : 200 - 2 * quality;
+	for (int k = 0; k < 64; ++k) {
+		int luma = (lumaQuant[k] * scale + 50) / 100;
+		int chroma = (chromaQuant[k] * scale + 50) / 100;
+		encoder.Quant[0][k] = (luma < 1) ? 1 : (luma > 255) ? 255 : luma;
+		encoder.Quant[1][k] = (chroma < 1) ? 1 : (chroma > 255) ? 255 : chroma;
+	}
+	build_codes(&encoder.Dc[0], dcLumaBits, dcValues);
+	build_codes(&encoder.Dc[1], dcChromaBits, dcValues);
+	build_codes(&encoder.Ac[0], acLumaBits, acLumaValues);
+	build_codes(&encoder.Ac[1], acChromaBits, acChromaValues);
+
+	uint8_t components = (options->Components == 1) ? 1 : 3;
+	uint8_t h = (components == 1 || options->H == 0) ? 1 : options->H;
+	uint8_t v = (components == 1 || options->V == 0) ? 1 : options->V;
+	uint16_t width = options->Width, height = options->Height;
+
+	/* Headers. */
+	put_word(&encoder, 0xFFD8);
+	if (options->Padding >= 4) {
+		put_word(&encoder, 0xFFE1);
+		put_word(&encoder, options->Padding - 2);
+		for (uint16_t i = 4; i < options->Padding; ++i) {
+			put_byte(&encoder, 0);
+		}
+	}
+	put_word(&encoder, 0xFFDB);
+	put_word(&encoder, 2 + 65 * (components == 1 ? 1 : 2));
+	for (uint8_t table = 0; table < (components == 1 ? 1 : 2); ++table) {
+		put_byte(&encoder, table);
+		for (int k = 0; k < 64; ++k) {
+			put_byte(&encoder, encoder.Quant[table][zigzag[k]]);
+		}
+	}
+	put_word(&encoder, 0xFFC0);
+	put_word(&encoder, 8 + 3 * components);
+	put_byte(&encoder, 8);
+	put_word(&encoder, height);
+	put_word(&encoder, width);
+	put_byte(&encoder, components);
+	for (uint8_t i = 0; i < components; ++i) {
+		put_byte(&encoder, i + 1);
+		put_byte(&encoder, (i == 0) ? (h << 4) | v : 0x11);
+		put_byte(&encoder, (i == 0) ? 0 : 1);
+	}
+	put_word(&encoder, 0xFFC4);
+	put_word(&encoder, 2 + (17 + 12) + (17 + 162)
+			+ (components == 1 ? 0 : (17 + 12) + (17 + 162)));
+	put_table(&encoder, 0x00, dcLumaBits, dcValues);
+	put_table(&encoder, 0x10, acLumaBits, acLumaValues);
+	if (components == 3) {
+		put_table(&encoder, 0x01, dcChromaBits, dcValues);
+		put_table(&encoder, 0x11, acChromaBits, acChromaValues);
+	}
+	if (options->RestartInterval != 0) {
+		put_word(&encoder, 0xFFDD);
+		put_word(&encoder, 4);
+		put_word(&encoder, options->RestartInterval);
+	}
+	put_word(&encoder, 0xFFDA);
+	put_word(&encoder, 6 + 2 * components);
+	put_byte(&encoder, components);
+	for (uint8_t i = 0; i < components; ++i) {
+		put_byte(&encoder, i + 1);
+		put_byte(&encoder, (i == 0) ? 0x00 : 0x11);
+	}
+	put_byte(&encoder, 0);
+	put_byte(&encoder, 63);
+	put_byte(&encoder, 0);
+
+	/* Scan, with samples past the edges repeating the last row and column. */
+	uint16_t mcusX = (width + 8 * h - 1) / (8 * h);
+	uint16_t mcusY = (height + 8 * v - 1) / (8 * v);
+	uint16_t blocksX = (width + 7) / 8;
+	uint16_t blocksY = (height + 7) / 8;
+	uint32_t mcu = 0;
+	uint8_t restart = 0;
+	double samples[64];
+	for (uint16_t my = 0; my < mcusY; ++my) {
+		for (uint16_t mx = 0; mx < mcusX; ++mx, ++mcu) {
+			if (options->RestartInterval != 0 && mcu != 0 && mcu % options->RestartInterval == 0) {
+				flush_bits(&encoder);
+				put_word(&encoder, 0xFFD0 + restart);
+				restart = (restart + 1) % 8;
+				memset(encoder.Predictor, 0, sizeof(encoder.Predictor));
+			}
+			for (uint8_t i = 0; i < components; ++i) {
+				uint8_t ch = (i == 0) ? h : 1, cv = (i == 0) ? v : 1;
+				uint8_t sx = h / ch, sy = v / cv;
+				for (uint8_t by = 0; by < cv; ++by) {
+					for (uint8_t bx = 0; bx < ch; ++bx) {
+						uint32_t sum = 0;
+						for (int y = 0; y < 8; ++y) {
+							for (int x = 0; x < 8; ++x) {
+								uint32_t px = ((mx * ch + bx) * 8 + x) * sx;
+								uint32_t py = ((my * cv + by) * 8 + y) * sy;
+								px = (px < width) ? px : width - 1U;
+								py = (py < height) ? py : height - 1U;
+								uint8_t sample = pixel(context, px, py, i);
+								samples[y * 8 + x] = sample - 128.0;
+								sum += sample;
+							}
+						}
+						encode_block(&encoder, samples, (i == 0) ? 0 : 1, &encoder.Predictor[i]);
+						uint16_t blockX = mx * ch + bx, blockY = my * cv + by;
+						if (i == 0 && means != NULL && blockX < blocksX && blockY < blocksY) {
+							means[blockY * blocksX + blockX] = (sum + 32) / 64;
+						}
+					}
+				}
+			}
+		}
+	}
+	flush_bits(&encoder);
+	put_word(&encoder, 0xFFD9);
+	return encoder.Length;
+}
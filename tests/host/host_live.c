@@ -0,0 +1,8 @@
+#include "host.h"
+#include "task/skywire_task.h"
+
+/* The Skywire task's side of the live image hand over, for the tests that
+   do not link it. */
+volatile uint8_t liveWaiting = 0;
+QueueHandle_t xLiveQueue;
+QueueHandle_t xLiveResultQueue;
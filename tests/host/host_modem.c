@@ -0,0 +1,74 @@
+#include "host.h"
+#include "peripheral/skywire.h"
+#include "task/beacon_task.h"
+
+uint8_t* hostModemTx = NULL;
+uint32_t hostModemTxLength = 0;
+uint32_t hostModemFailAfter = ~0u;
+uint8_t hostModemAnswer = 1;
+
+static uint32_t txCapacity;
+static char rx[256];
+static uint32_t rxLength;
+static uint32_t rxPosition;
+
+QueueHandle_t xSLUpdatesQueue;
+
+static void
+reply(const char* response) {
+	strcpy(rx, response);
+	rxLength = strlen(rx);
+	rxPosition = 0;
+}
+
+static uint8_t
+tx_ends_with(const char* text) {
+	uint32_t length = strlen(text);
+	return hostModemTxLength >= length
+			&& memcmp(hostModemTx + hostModemTxLength - length, text, length) == 0;
+}
+
+/**
+ * Empty the record of what was written to the modem.
+ */
+void
+host_modem_reset(void) {
+	if (hostModemTx == NULL) {
+		txCapacity = 4 << 20;
+		hostModemTx = malloc(txCapacity);
+	}
+	hostModemTxLength = 0;
+	rxLength = rxPosition = 0;
+}
+
+void vcp_init() { }
+void skywire_init() { }
+void skywire_activate() { }
+
+/* The modem connects on AT#SD and the server answers once the last chunk
+   of a POST is written. Writes past hostModemFailAfter bytes fail. */
+Skywire_StatusTypeDef
+skywire_write(uint8_t* buffer, uint8_t start, uint8_t length) {
+	if (hostModemTxLength + length > hostModemFailAfter) {
+		return SKYWIRE_ERROR;
+	}
+	CHECK(hostModemTxLength + length <= txCapacity);
+	memcpy(hostModemTx + hostModemTxLength, buffer + start, length);
+	hostModemTxLength += length;
+	if (length > 6 && memcmp(buffer + start, "AT#SD=", 6) == 0) {
+		reply("\r\nCONNECT\r\n");
+	} else if (hostModemAnswer && tx_ends_with("\r\n0\r\n\r\n")) {
+		reply("HTTP/1.1 200 OK\r\nContent-Length: 11\r\n\r\nSL=50,EOM\r\n\r\nNO CARRIER\r\n");
+	}
+	return SKYWIRE_OK;
+}
+
+uint8_t
+skywire_count() {
+	return rxLength - rxPosition;
+}
+
+uint8_t
+skywire_getc() {
+	return rx[rxPosition++];
+}
@@ -0,0 +1,105 @@
+#include "host.h"
+#include "task.h"
+#include "queue.h"
+#include <stdarg.h>
+
+TickType_t hostTicks = 0;
+uint8_t hostTrace = 0;
+
+TickType_t
+xTaskGetTickCount(void) {
+	return hostTicks;
+}
+
+void
+vTaskDelay(const TickType_t ticks) {
+	hostTicks += ticks;
+}
+
+void
+vTaskDelayUntil(TickType_t* const previousWake, const TickType_t increment) {
+	*previousWake += increment;
+	if ((int32_t)(*previousWake - hostTicks) > 0) {
+		hostTicks = *previousWake;
+	}
+}
+
+int
+trace_printf(const char* format, ...) {
+	va_list args;
+	int length = 0;
+
+	if (hostTrace) {
+		va_start(args, format);
+		length = vprintf(format, args);
+		va_end(args);
+	}
+	return length;
+}
+
+/* Queues hold copies of their items in a ring. A receive from an empty
+   queue, or a send to a full one, times out at once after moving the tick
+   count on by the time it would have blocked. */
+typedef struct _HostQueue {
+	UBaseType_t Length;
+	UBaseType_t ItemSize;
+	UBaseType_t Count;
+	UBaseType_t Head;
+	uint8_t Items[];
+} HostQueue;
+
+QueueHandle_t
+xQueueGenericCreate(const UBaseType_t length, const UBaseType_t itemSize, const uint8_t type) {
+	(void)type;
+	HostQueue* queue = calloc(1, sizeof(HostQueue) + length * itemSize);
+	queue->Length = length;
+	queue->ItemSize = itemSize;
+	return queue;
+}
+
+BaseType_t
+xQueueGenericSend(QueueHandle_t handle, const void* const item, TickType_t wait, const BaseType_t position) {
+	HostQueue* queue = handle;
+	if (queue->Count == queue->Length) {
+		if (wait != portMAX_DELAY) {
+			hostTicks += wait;
+		}
+		return errQUEUE_FULL;
+	}
+	UBaseType_t slot;
+	if (position == queueSEND_TO_FRONT) {
+		queue->Head = (queue->Head + queue->Length - 1) % queue->Length;
+		slot = queue->Head;
+	} else {
+		slot = (queue->Head + queue->Count) % queue->Length;
+	}
+	if (queue->ItemSize > 0) {
+		memcpy(queue->Items + slot * queue->ItemSize, item, queue->ItemSize);
+	}
+	queue->Count++;
+	return pdPASS;
+}
+
+BaseType_t
+xQueueGenericReceive(QueueHandle_t handle, void* const buffer, TickType_t wait, const BaseType_t peek) {
+	HostQueue* queue = handle;
+	if (queue->Count == 0) {
+		if (wait != portMAX_DELAY) {
+			hostTicks += wait;
+		}
+		return errQUEUE_EMPTY;
+	}
+	if (queue->ItemSize > 0) {
+		memcpy(buffer, queue->Items + queue->Head * queue->ItemSize, queue->ItemSize);
+	}
+	if (!peek) {
+		queue->Head = (queue->Head + 1) % queue->Length;
+		queue->Count--;
+	}
+	return pdPASS;
+}
+
+void
+vTaskDelete(TaskHandle_t task) {
+	(void)task;
+}
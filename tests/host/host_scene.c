@@ -0,0 +1,68 @@
+#include "host.h"
+#include "ring_log.h"
+#include "jpeg.h"
+#include "task/camera_task.h"
+
+uint8_t camera_task_setup(void);
+void start_image(void);
+void poll_image(void);
+extern uint8_t captureActive;
+extern JpegDcDecoder sceneDecoder;
+extern uint8_t sceneReference[JPEG_SIGNATURE_CELLS];
+extern uint8_t sceneReferenceValid;
+
+/* FIFO padding after each frame, as the ArduChip leaves. */
+#define SCENE_FIFO_PADDING 1000
+
+/**
+ * Format a RAM disk and start the camera task's stores on it.
+ */
+void
+host_scene_setup(void) {
+	host_disk_create(90000);
+	fn_initvolume(host_disk_initfunc);
+	CHECK(f_format(F_FAT16_MEDIA) == F_NO_ERROR);
+	fn_delvolume();
+	CHECK(camera_task_setup() == 1);
+}
+
+/**
+ * Capture a JPEG through the camera task, elapsed milliseconds after the
+ * last one, and report whether it was stored or logged as unchanged.
+ */
+void
+host_scene_frame(const uint8_t* frame, uint32_t length, uint32_t elapsed, HostSceneFrame* result) {
+	uint8_t reference[JPEG_SIGNATURE_CELLS];
+	uint8_t referenceValid = sceneReferenceValid;
+	memcpy(reference, sceneReference, JPEG_SIGNATURE_CELLS);
+	uint32_t images = imageStore.HeadSequence;
+	uint32_t records = dataLog.HeadSequence;
+
+	host_fifo_load(frame, length, SCENE_FIFO_PADDING);
+	hostTicks += elapsed;
+	start_image();
+	CHECK(captureActive);
+	while (captureActive) {
+		poll_image();
+	}
+
+	memset(result, 0, sizeof(HostSceneFrame));
+	result->Stored = (imageStore.HeadSequence != images);
+	result->Same = !result->Stored && (dataLog.HeadSequence != records);
+	result->Decoded = jpeg_dc_signature(&sceneDecoder, result->Signature);
+	if (result->Decoded) {
+		result->Cells = referenceValid
+				? jpeg_signature_compare(result->Signature, reference, SCENE_CHANGE_LEVEL)
+				: JPEG_SIGNATURE_CELLS;
+	}
+
+	/* Upload keeps up, so the stores never fill. */
+	RingLog* logs[] = { &imageStore, &thumbStore, &dataLog };
+	for (uint8_t i = 0; i < 3; i++) {
+		RingCursor cursor;
+		RingRecord record;
+		rlog_cursor(logs[i], &cursor);
+		while (rlog_next(logs[i], &cursor, &record) == RLOG_OK) {}
+		CHECK(rlog_consume(logs[i], &cursor) == RLOG_OK);
+	}
+}
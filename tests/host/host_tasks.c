@@ -0,0 +1,6 @@
+#include "host.h"
+#include "task/sampler_task.h"
+
+/* State the tasks a test does not link share with the ones it does. */
+SampleRing sampleRing;
+uint32_t sampleDrdyMissed;
@@ -0,0 +1,86 @@
+/**
+ * Run a directory of JPEGs through the camera task's scene check, in name
+ * order, as frames IMAGE_RATE_MS apart. Each is read from a simulated FIFO
+ * in bursts, decoded for its signature and either stored or logged as
+ * unchanged, as on the camera.
+ *
+ *   make -C tests build/scene_check
+ *   tests/build/scene_check frames/
+ */
+
+#include <dirent.h>
+
+#include "host.h"
+#include "task/camera_task.h"
+
+#define FRAME_MAX (4 << 20)
+#define NAMES_MAX 4096
+
+static uint8_t frame[FRAME_MAX];
+
+static int
+compare_names(const void* a, const void* b) {
+	return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+static int
+is_jpeg(const char* name) {
+	const char* extension = strrchr(name, '.');
+	return extension != NULL && (strcmp(extension, ".jpg") == 0 || strcmp(extension, ".JPG") == 0
+			|| strcmp(extension, ".jpeg") == 0);
+}
+
+int
+main(int argc, char** argv) {
+	if (argc != 2) {
+		fprintf(stderr, "usage: %s directory\n", argv[0]);
+		return 2;
+	}
+	DIR* dir = opendir(argv[1]);
+	if (dir == NULL) {
+		perror(argv[1]);
+		return 1;
+	}
+	char* names[NAMES_MAX];
+	int count = 0;
+	struct dirent* entry;
+	while ((entry = readdir(dir)) != NULL && count < NAMES_MAX) {
+		if (is_jpeg(entry->d_name)) {
+			names[count++] = strdup(entry->d_name);
+		}
+	}
+	closedir(dir);
+	qsort(names, count, sizeof(char*), compare_names);
+
+	host_scene_setup();
+	int stored = 0, same = 0, undecoded = 0;
+	for (int i = 0; i < count; i++) {
+		char path[1024];
+		snprintf(path, sizeof(path), "%s/%s", argv[1], names[i]);
+		FILE* file = fopen(path, "rb");
+		if (file == NULL) {
+			perror(path);
+			continue;
+		}
+		uint32_t length = fread(frame, 1, FRAME_MAX, file);
+		fclose(file);
+
+		HostSceneFrame result;
+		host_scene_frame(frame, length, IMAGE_RATE_MS, &result);
+		stored += result.Stored;
+		same += result.Same;
+		undecoded += !result.Decoded;
+		if (result.Decoded) {
+			printf("%s: %7lu bytes, %2u cells changed, %s\n", names[i], (unsigned long)length,
+					result.Cells, result.Stored ? "stored" : result.Same ? "same" : "dropped");
+		} else {
+			printf("%s: %7lu bytes, not decoded, %s\n", names[i], (unsigned long)length,
+					result.Stored ? "stored" : "dropped");
+		}
+		free(names[i]);
+	}
+	printf("%d frames: %d stored, %d logged as unchanged, %d not decoded\n",
+			count, stored, same, undecoded);
+	host_disk_destroy();
+	return 0;
+}
@@ -0,0 +1,222 @@
+/**
+ * Camera FIFO to image store, through start_image() and poll_image() with
+ * a simulated ArduChip FIFO: the FIFO is read in whole sector bursts, the
+ * frame lands in the image store sector aligned and byte for byte, and the
+ * time per 5 MP frame is estimated against the previous 128 byte bursts.
+ */
+
+#include "host.h"
+#include "ring_log.h"
+#include "jpeg.h"
+#include "task/camera_task.h"
+#include "peripheral/arducam.h"
+
+#define FRAME_MAX (1 << 20)
+
+uint8_t camera_task_setup(void);
+void start_image(void);
+void poll_image(void);
+extern uint8_t captureActive;
+
+/* SPI1 at 84 MHz / 64, with estimates of the time to start a burst and
+   for the card to take a sector. */
+#define BYTE_US        (8.0 / 1.3125)
+#define BURST_SETUP_US 20.0
+#define SECTOR_US      (530 * BYTE_US)
+#define SD_WRITE_US    (SECTOR_US + 400.0)
+#define SD_READ_US     (SECTOR_US + 100.0)
+
+static uint8_t frame[FRAME_MAX];
+static uint8_t stored[FRAME_MAX + 512];
+
+typedef struct _Cost {
+	unsigned long bursts;
+	unsigned long burstBytes;
+	unsigned long writes;
+	unsigned long reads;
+} Cost;
+
+static void
+cost_start(Cost* cost) {
+	hostFifoBursts = hostFifoBurstBytes = 0;
+	cost->writes = host_disk_writes();
+	cost->reads = hostDiskReads;
+}
+
+static void
+cost_end(Cost* cost) {
+	cost->bursts = hostFifoBursts;
+	cost->burstBytes = hostFifoBurstBytes;
+	cost->writes = host_disk_writes() - cost->writes;
+	cost->reads = hostDiskReads - cost->reads;
+}
+
+static double
+cost_seconds(const Cost* cost) {
+	return (cost->bursts * BURST_SETUP_US + cost->burstBytes * BYTE_US
+			+ cost->writes * SD_WRITE_US + cost->reads * SD_READ_US) / 1e6;
+}
+
+/* A road scene with texture, so the frame compresses like a real one. */
+static uint8_t
+scene(void* context, uint32_t x, uint32_t y, uint8_t component) {
+	if (component != 0) {
+		return 128 + (int)((x / 64 + y / 48) % 5) * 4;
+	}
+	int level = (y < 700) ? 180 - y / 10 : 90 + ((x / 120) % 2) * 10;
+	level += (int)((x * 7 + y * 13) % 11);
+	if (y > 1300 && y < 1330 && (x / 160) % 2) {
+		level = 230;
+	}
+	return level;
+}
+
+/* The last record in the image store. */
+static RingRecord
+last_image(void) {
+	RingCursor cursor;
+	RingRecord record, last = { 0 };
+	rlog_cursor(&imageStore, &cursor);
+	while (rlog_next(&imageStore, &cursor, &record) == RLOG_OK) {
+		last = record;
+	}
+	CHECK(last.Header.Type == RLOG_TYPE_JPEG);
+	return last;
+}
+
+/* Length of the last thumbnail, which goes to the card with its image. */
+static uint32_t
+thumbnail_length(void) {
+	RingCursor cursor;
+	RingRecord record;
+	uint32_t length = 0;
+	rlog_cursor(&thumbStore, &cursor);
+	while (rlog_next(&thumbStore, &cursor, &record) == RLOG_OK) {
+		length = record.Header.Length;
+	}
+	return length;
+}
+
+/* The previous capture path: 128 byte bursts, each written as it came. */
+static void
+capture_bursts_128(void) {
+	uint8_t buffer[128];
+	uint32_t remainingBytes;
+	arducam_start_capture();
+	arducam_capture_length(&remainingBytes);
+	CHECK(rlog_begin(&imageStore, RLOG_TYPE_JPEG, xTaskGetTickCount()) == RLOG_OK);
+	uint8_t length = MIN(remainingBytes, 128);
+	CHECK(arducam_burst_read(buffer, length) == DEVICES_OK);
+	remainingBytes -= length;
+	CHECK(rlog_write(&imageStore, buffer + 1, length - 1) == RLOG_OK);
+	while (remainingBytes > 0) {
+		length = MIN(remainingBytes, 128);
+		CHECK(arducam_burst_read(buffer, length) == DEVICES_OK);
+		remainingBytes -= length;
+		CHECK(rlog_write(&imageStore, buffer, length) == RLOG_OK);
+	}
+	CHECK(rlog_end(&imageStore) == RLOG_OK);
+	CHECK(rlog_flush(&imageStore) == RLOG_OK);
+}
+
+/* Capture a frame through the camera task and check what was stored. */
+static Cost
+capture(uint32_t length, uint32_t padding) {
+	Cost cost;
+	host_fifo_load(frame, length, padding);
+	uint32_t sequence = imageStore.HeadSequence;
+
+	/* A keyframe is due, so the same frame is stored again. */
+	hostTicks += SCENE_KEYFRAME_MS;
+	start_image();
+	CHECK(captureActive);
+	cost_start(&cost);
+	while (captureActive) {
+		poll_image();
+	}
+	cost_end(&cost);
+
+	/* Bursts are whole sectors, bar the last, and stop once the frame
+	   has been read. */
+	CHECK(hostFifoPosition >= 1 + length);
+	CHECK(cost.bursts == (length + CAPTURE_BURST_LENGTH - 1) / CAPTURE_BURST_LENGTH);
+	CHECK(hostFifoMaxBurst == CAPTURE_BURST_LENGTH + 1);
+
+	/* SOI, the metadata segment, then the rest of the frame. */
+	RingRecord record = last_image();
+	CHECK(record.Header.Sequence == sequence);
+	CHECK(rlog_read(&imageStore, &record, 0, stored, record.Header.Length) == RLOG_OK);
+	CHECK(stored[0] == JPEG_MARKER && stored[1] == JPEG_SOI);
+	CHECK(stored[2] == JPEG_MARKER && stored[3] == JPEG_APP0 + IMAGE_METADATA_APP);
+	uint32_t metadata = 2 + ((stored[4] << 8) | stored[5]);
+	CHECK(record.Header.Length == 2 + metadata + length - 2);
+	CHECK(memcmp(stored + 2 + metadata, frame + 2, length - 2) == 0);
+
+	/* The frame keeps the sector offsets it has in the FIFO bursts, so
+	   each burst goes to the card as whole sectors. */
+	CHECK((record.Offset + metadata) % F_SECTOR_SIZE == 0);
+	CHECK(record.Header.Flags & RLOG_FLAG_ALIGNED);
+	CHECK(cost.writes <= (record.Header.Length + thumbnail_length()) / F_SECTOR_SIZE + 8);
+	CHECK(cost.reads <= 8);
+	return cost;
+}
+
+int
+main(void) {
+	host_disk_create(90000);
+	fn_initvolume(host_disk_initfunc);
+	CHECK(f_format(F_FAT16_MEDIA) == F_NO_ERROR);
+	fn_delvolume();
+	CHECK(camera_task_setup() == 1);
+	CHECK(imageStore.Mounted);
+
+	/* A 5 MP frame, as the OV5642 gives at its full size. */
+	HostJpegOptions options = { 2592, 1944, 3, 2, 1, 50, 0, 0 };
+	uint32_t length = host_jpeg_encode(&options, scene, NULL, frame, FRAME_MAX, NULL);
+	capture(length, 0);
+
+	/* Timed without the thumbnail, which the previous path did not make. */
+	thumbStore.Mounted = 0;
+	Cost current = capture(length, 0);
+	thumbStore.Mounted = 1;
+
+	/* The FIFO is followed by padding in front of the length register. */
+	capture(length, 7);
+	capture(length, CAPTURE_BURST_LENGTH + 3);
+
+	/* Headers longer than a sector, and frames a byte either side of a
+	   whole burst. */
+	options.Padding = 700;
+	capture(host_jpeg_encode(&options, scene, NULL, frame, FRAME_MAX, NULL), 0);
+	options.Padding = 0;
+	options.Width = 640;
+	options.Height = 480;
+	length = host_jpeg_encode(&options, scene, NULL, frame, FRAME_MAX, NULL);
+	for (uint32_t padding = CAPTURE_BURST_LENGTH - length % CAPTURE_BURST_LENGTH - 2;
+			padding < CAPTURE_BURST_LENGTH - length % CAPTURE_BURST_LENGTH + 2; ++padding) {
+		capture(length, padding);
+	}
+
+	/* The same 5 MP frame through 128 byte bursts. */
+	options.Width = 2592;
+	options.Height = 1944;
+	length = host_jpeg_encode(&options, scene, NULL, frame, FRAME_MAX, NULL);
+	host_fifo_load(frame, length, 0);
+	Cost previous;
+	cost_start(&previous);
+	capture_bursts_128();
+	cost_end(&previous);
+
+	printf("%lu byte 5 MP frame\n", (unsigned long)length);
+	printf("128 byte bursts:    %5lu bursts, %4lu sector writes, %3lu reads, %.2f s/frame\n",
+			previous.bursts, previous.writes, previous.reads, cost_seconds(&previous));
+	printf("%4u byte bursts:   %5lu bursts, %4lu sector writes, %3lu reads, %.2f s/frame\n",
+			CAPTURE_BURST_LENGTH, current.bursts, current.writes, current.reads, cost_seconds(&current));
+	CHECK(current.bursts * 8 < previous.bursts);
+	CHECK(cost_seconds(&current) < cost_seconds(&previous));
+
+	fn_delvolume();
+	host_disk_destroy();
+	printf("ok\n");
+	return 0;
+}
@@ -0,0 +1,157 @@
+/**
+ * Lazy FAT mirroring (F_FAT_MIRROR_LAZY): the mirror FAT is left alone in
+ * the hot path, and matches FAT1 sector for sector after f_sync() and at
+ * unmount, however the FAT sectors were flushed.
+ */
+
+#include "host.h"
+#include "volume.h"
+
+#define FILES 6
+#define CHUNK 1000
+
+static uint8_t chunk[CHUNK];
+
+/* Fill the chunk with a pattern particular to a file and offset. */
+static void
+fill(int file, long offset) {
+	for (int i = 0; i < CHUNK; i++) {
+		chunk[i] = (uint8_t)(file * 31 + (offset + i) * 7);
+	}
+}
+
+static unsigned long
+fat_sector(int copy, unsigned long sector) {
+	return gl_volume.firstfat.sector + copy * gl_volume.firstfat.num + sector;
+}
+
+/* Number of FAT sectors in which the mirror differs from FAT1. */
+static unsigned long
+mirror_differences(void) {
+	unsigned long differences = 0;
+	for (unsigned long sector = 0; sector < gl_volume.firstfat.num; sector++) {
+		if (memcmp(hostDisk + fat_sector(0, sector) * HOST_SECTOR_SIZE,
+				hostDisk + fat_sector(1, sector) * HOST_SECTOR_SIZE, HOST_SECTOR_SIZE) != 0) {
+			differences++;
+		}
+	}
+	return differences;
+}
+
+static unsigned long
+mirror_writes(void) {
+	unsigned long writes = 0;
+	for (unsigned long sector = 0; sector < gl_volume.firstfat.num; sector++) {
+		writes += hostDiskWrites[fat_sector(1, sector)];
+	}
+	return writes;
+}
+
+static void
+file_name(char* name, int file) {
+	sprintf(name, "file%d.bin", file);
+}
+
+/* Append to the files in turn, so their cluster chains interleave and
+   cross FAT sectors. */
+static void
+append(long chunks) {
+	char name[16];
+	for (long n = 0; n < chunks; n++) {
+		for (int file = 0; file < FILES; file++) {
+			file_name(name, file);
+			F_FILE* f = f_open(name, "a");
+			CHECK(f != NULL);
+			fill(file, f_tell(f));
+			CHECK(f_write(chunk, 1, CHUNK, f) == CHUNK);
+			CHECK(f_close(f) == F_NO_ERROR);
+		}
+	}
+}
+
+/* Delete every other file, freeing chains that cross FAT sectors. */
+static void
+delete(void) {
+	char name[16];
+	for (int file = 1; file < FILES; file += 2) {
+		file_name(name, file);
+		CHECK(f_delete(name) == F_NO_ERROR);
+	}
+}
+
+static void
+verify(long length) {
+	char name[16];
+	uint8_t buffer[CHUNK];
+	for (int file = 0; file < FILES; file += 2) {
+		file_name(name, file);
+		CHECK(f_filelength(name) == length);
+		F_FILE* f = f_open(name, "r");
+		CHECK(f != NULL);
+		for (long offset = 0; offset < length; offset += CHUNK) {
+			fill(file, offset);
+			CHECK(f_read(buffer, 1, CHUNK, f) == CHUNK);
+			CHECK(memcmp(buffer, chunk, CHUNK) == 0);
+		}
+		CHECK(f_close(f) == F_NO_ERROR);
+	}
+}
+
+static void
+run(const char* label, unsigned long sectors, unsigned char media, long chunks) {
+	host_disk_create(sectors);
+	fn_initvolume(host_disk_initfunc);
+	CHECK(f_format(media) == F_NO_ERROR);
+	CHECK(fn_initvolume(host_disk_initfunc) == F_NO_ERROR);
+	CHECK(gl_volume.bootrecord.number_of_FATs == 2);
+	CHECK(mirror_differences() == 0);
+	unsigned long formatWrites = mirror_writes();
+
+	/* Only FAT1 is written in the hot path. */
+	append(chunks);
+	unsigned long stale = mirror_differences();
+	CHECK(stale > 1);
+	CHECK(mirror_writes() == formatWrites);
+
+	/* f_sync() brings every sector of the mirror up to date. */
+	CHECK(f_sync() == F_NO_ERROR);
+	CHECK(mirror_differences() == 0);
+	printf("%s: %lu FAT sectors, %lu stale before f_sync, %lu mirror writes\n",
+			label, gl_volume.firstfat.num, stale, mirror_writes() - formatWrites);
+
+	/* Freeing the chains moves from one FAT sector to the next, flushing
+	   each as it goes, and those sectors reach the mirror too. */
+	delete();
+	CHECK(mirror_differences() > 1);
+	CHECK(f_sync() == F_NO_ERROR);
+	CHECK(mirror_differences() == 0);
+
+	/* So does unmounting, even with a file left open. */
+	append(chunks / 2);
+	CHECK(mirror_differences() > 0);
+	F_FILE* open = f_open("open.bin", "w");
+	CHECK(open != NULL);
+	CHECK(f_write(chunk, 1, CHUNK, open) == CHUNK);
+	CHECK(fn_delvolume() == F_NO_ERROR);
+	CHECK(mirror_differences() == 0);
+
+	/* The mirror serves reads when FAT1 cannot be read. */
+	CHECK(fn_initvolume(host_disk_initfunc) == F_NO_ERROR);
+	hostDiskBadRead = fat_sector(0, 0);
+	verify((chunks + chunks / 2) * CHUNK);
+	hostDiskBadRead = (unsigned long)-1;
+	fn_delvolume();
+}
+
+int
+main(void) {
+	/* FAT16, with chains crossing FAT sectors and freed across them. */
+	run("fat16", 40000, F_FAT16_MEDIA, 150);
+
+	/* FAT12, whose entries straddle FAT sectors. */
+	run("fat12", 8000, F_FAT12_MEDIA, 60);
+
+	host_disk_destroy();
+	printf("ok\n");
+	return 0;
+}
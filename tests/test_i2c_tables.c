@@ -0,0 +1,161 @@
+/**
+ * OV5642 setup over a simulated I2C bus: ov5642_init() writes its register
+ * runs at 400 kHz, and they leave the sensor's registers as the writes of
+ * the previous tuple tables at 30 kHz did, in the same order. The time each
+ * takes on the bus is estimated from the bytes and transfers it sent.
+ */
+
+#include "host.h"
+#include "peripheral/arducam.h"
+#include "peripheral/i2c_spi_bus.h"
+#include "task/i2c_task.h"
+
+#define REGISTERS 65536
+#define WRITES_MAX 4096
+
+/* The tables in their previous form, in host/ov5642_tuples.c. */
+extern RegisterTuple16_8 tuple_dvp_fmt_global_init[];
+extern RegisterTuple16_8 tuple_dvp_fmt_jpeg_qvga[];
+extern RegisterTuple16_8 tuple_res_1080P[];
+
+/* Per byte, 8 data bits and an ACK. Per transfer, START, the address byte
+   and STOP on the bus, and an estimate of the time the HAL takes. */
+#define TRANSFER_BITS 11
+#define TRANSFER_US   25.0
+
+/* The sensor's register file, and the writes it took in order. */
+typedef struct _Bus {
+	uint8_t Registers[REGISTERS];
+	uint8_t Written[REGISTERS];
+	uint16_t Address[WRITES_MAX];
+	uint8_t Value[WRITES_MAX];
+	uint32_t Writes;
+	unsigned long Transfers;
+	unsigned long Bytes;
+	double Seconds;
+} Bus;
+
+static Bus before, after;
+static Bus* bus;
+static uint32_t ov5642Speed = I2C_CLOCK_DEFAULT;
+
+/* Peripherals set up by i2c_spi_bus.c and not used here. */
+QueueHandle_t xI2cQueue;
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef* h) { return HAL_OK; }
+HAL_StatusTypeDef HAL_SPI_Init(SPI_HandleTypeDef* h) { return HAL_OK; }
+HAL_StatusTypeDef HAL_SPI_Receive(SPI_HandleTypeDef* h, uint8_t* data, uint16_t size, uint32_t timeout) { return HAL_OK; }
+HAL_StatusTypeDef HAL_SPI_TransmitReceive(SPI_HandleTypeDef* h, uint8_t* out, uint8_t* in, uint16_t size, uint32_t timeout) { return HAL_OK; }
+void HAL_GPIO_WritePin(GPIO_TypeDef* port, uint16_t pin, GPIO_PinState state) { }
+QueueHandle_t xQueueCreateMutex(const uint8_t type) { return NULL; }
+
+Devices_StatusTypeDef
+i2c_device_speed(uint8_t device, uint32_t clockSpeed) {
+	CHECK((device & 0xFE) == OV5642_ADDRESS_W);
+	ov5642Speed = clockSpeed;
+	return DEVICES_OK;
+}
+
+/* The OV5642 on the bus, which increments the register address after each
+   byte written or read. */
+Devices_StatusTypeDef
+i2c_transact(I2C_Transfer* transfers, uint8_t count) {
+	CHECK(count >= 1 && count <= I2C_BATCH_LENGTH);
+	for (uint8_t i = 0; i < count; i++) {
+		I2C_Transfer* transfer = &transfers[i];
+		CHECK(transfer->Device == OV5642_ADDRESS_W);
+		CHECK(transfer->WriteLength >= 2);
+		uint16_t address = (transfer->Write[0] << 8) | transfer->Write[1];
+		for (uint16_t j = 2; j < transfer->WriteLength; j++, address++) {
+			CHECK(bus->Writes < WRITES_MAX);
+			bus->Address[bus->Writes] = address;
+			bus->Value[bus->Writes++] = transfer->Write[j];
+			bus->Registers[address] = transfer->Write[j];
+			bus->Written[address] = 1;
+		}
+		for (uint16_t j = 0; j < transfer->ReadLength; j++, address++) {
+			transfer->Read[j] = bus->Registers[address];
+		}
+
+		/* A read is a second transfer after a repeated START. */
+		uint8_t starts = (transfer->ReadLength > 0) ? 2 : 1;
+		uint32_t bytes = transfer->WriteLength + transfer->ReadLength;
+		bus->Transfers += starts;
+		bus->Bytes += bytes;
+		bus->Seconds += (double)(starts * TRANSFER_BITS + bytes * 9) / ov5642Speed
+				+ starts * TRANSFER_US / 1e6;
+	}
+	return DEVICES_OK;
+}
+
+static void
+bus_attach(Bus* next) {
+	bus = next;
+	bus->Registers[OV5642_CHIP_ID_HIGH_BYTE] = OV5642_CHIP_ID >> 8;
+	bus->Registers[OV5642_CHIP_ID_LOW_BYTE] = OV5642_CHIP_ID & 0xFF;
+}
+
+/* The index of a register among the profile registers, or -1. */
+static int
+profile_index(uint16_t address) {
+	for (int i = 0; i < OV5642_PROFILE_REGISTERS; i++) {
+		if (ov5642_profile_registers[i] == address) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+int
+main(void) {
+	/* The previous setup: each register a transfer of its own at 30 kHz. */
+	bus_attach(&before);
+	uint8_t id[2];
+	CHECK(i2c_read16(OV5642_ADDRESS_W, OV5642_CHIP_ID_HIGH_BYTE, &id[0], 1) == DEVICES_OK);
+	CHECK(i2c_read16(OV5642_ADDRESS_W, OV5642_CHIP_ID_LOW_BYTE, &id[1], 1) == DEVICES_OK);
+	CHECK(i2c_write16_8(OV5642_ADDRESS_W, 0x3008, 0x80) == DEVICES_OK);
+	CHECK(i2c_array16_8(OV5642_ADDRESS_W, tuple_dvp_fmt_global_init) == DEVICES_OK);
+	CHECK(i2c_array16_8(OV5642_ADDRESS_W, tuple_dvp_fmt_jpeg_qvga) == DEVICES_OK);
+	uint32_t tableWrites = before.Writes;
+	CHECK(i2c_array16_8(OV5642_ADDRESS_W, tuple_res_1080P) == DEVICES_OK);
+	CHECK(i2c_write16_8(OV5642_ADDRESS_W, OV5642_QSCALE, 0x0C) == DEVICES_OK);
+
+	/* The current setup, from the chip ID check on. */
+	bus_attach(&after);
+	CHECK(ov5642_init() == 1);
+	CHECK(ov5642Speed == I2C_CLOCK_FAST);
+	CHECK(ov5642_get_profile() == OV5642_PROFILE_DEFAULT);
+
+	/* The reset and the tables go in the same order, register for register,
+	   with the repeated writes kept. */
+	CHECK(after.Writes >= tableWrites);
+	CHECK(memcmp(after.Address, before.Address, tableWrites * sizeof(uint16_t)) == 0);
+	CHECK(memcmp(after.Value, before.Value, tableWrites) == 0);
+
+	/* The default profile takes over from the 1080p table. It writes only
+	   profile registers, and the other registers end up as they did. */
+	for (uint32_t i = tableWrites; i < after.Writes; i++) {
+		CHECK(profile_index(after.Address[i]) >= 0);
+	}
+	for (uint32_t address = 0; address < REGISTERS; address++) {
+		int index = profile_index(address);
+		if (index >= 0) {
+			CHECK(after.Registers[address] == ov5642_profiles[OV5642_PROFILE_DEFAULT][index]);
+		} else {
+			CHECK(after.Written[address] == before.Written[address]);
+			CHECK(after.Registers[address] == before.Registers[address]);
+		}
+	}
+	for (uint32_t i = tableWrites; i < before.Writes; i++) {
+		CHECK(after.Registers[before.Address[i]] == before.Registers[before.Address[i]]);
+	}
+
+	printf("before: %4u writes, %4lu transfers, %4lu bytes at %3u kHz, %4.0f ms\n",
+			before.Writes, before.Transfers, before.Bytes, I2C_CLOCK_DEFAULT / 1000, before.Seconds * 1e3);
+	printf("after:  %4u writes, %4lu transfers, %4lu bytes at %3u kHz, %4.0f ms\n",
+			after.Writes, after.Transfers, after.Bytes, I2C_CLOCK_FAST / 1000, after.Seconds * 1e3);
+	CHECK(after.Transfers * 2 < before.Transfers);
+	CHECK(after.Seconds * 10 < before.Seconds);
+
+	printf("ok\n");
+	return 0;
+}
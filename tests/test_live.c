@@ -0,0 +1,250 @@
+/**
+ * Live images from the camera FIFO to the modem, through the camera task's
+ * hand over and the Skywire task's upload_live(), with a simulated FIFO and
+ * modem. The image goes up as a chunk declared at its real length, the SOI,
+ * the metadata segment and the frame up to EOI with nothing after, and the
+ * FIFO padding is not sent. When the upload fails, or is never picked up,
+ * the image goes to the SD card instead.
+ */
+
+#include "host.h"
+#include "hayes.h"
+#include "ring_log.h"
+#include "jpeg.h"
+#include "task/camera_task.h"
+#include "task/sampler_task.h"
+#include "task/skywire_task.h"
+#include "task/beacon_task.h"
+#include "peripheral/skywire.h"
+
+#define FRAME_MAX (1 << 20)
+
+/* The FIFO length register counts in whole 4 KB pages past the frame. */
+#define FIFO_PAGE 4096
+
+uint8_t camera_task_setup(void);
+void start_image(void);
+void poll_image(void);
+void poll_live(void);
+void flush_samples(void);
+uint8_t upload_live(ATDevice* dev);
+extern uint8_t captureActive;
+extern uint8_t captureLive;
+extern uint8_t sceneReferenceValid;
+
+static uint8_t frame[FRAME_MAX];
+static uint8_t stored[FRAME_MAX + 512];
+static uint32_t frameLength;
+static Sample sampleStorage[16];
+static char modemBuffer[512];
+
+/* A road scene with texture, so the frame compresses like a real one. */
+static uint8_t
+scene(void* context, uint32_t x, uint32_t y, uint8_t component) {
+	if (component != 0) {
+		return 128 + (int)((x / 64 + y / 48) % 5) * 4;
+	}
+	int level = (y < 200) ? 180 - y / 4 : 90 + ((x / 60) % 2) * 10;
+	return level + (int)((x * 7 + y * 13) % 11);
+}
+
+static void
+add_sample(void) {
+	static int32_t count;
+	Sample sample = { hostTicks, 101325, 2000 + count, 2100, 4550 };
+	count++;
+	CHECK(sample_ring_put(&sampleRing, &sample, 0) == SAMPLE_RING_OK);
+	flush_samples();
+}
+
+/* Capture the frame with FIFO padding out to the next page, with the
+   Skywire task waiting for an image or not. */
+static void
+capture(uint8_t waiting) {
+	liveWaiting = waiting;
+	host_fifo_load(frame, frameLength, FIFO_PAGE - (1 + frameLength) % FIFO_PAGE);
+	hostTicks += IMAGE_RATE_MS;
+	start_image();
+	CHECK(captureActive);
+	while (captureActive && !captureLive) {
+		poll_image();
+	}
+	CHECK(!hostSpiHeld);
+}
+
+/* Length of the metadata segment after the SOI of an image. */
+static uint32_t
+metadata_length(const uint8_t* image) {
+	CHECK(image[0] == JPEG_MARKER && image[1] == JPEG_SOI);
+	CHECK(image[2] == JPEG_MARKER && image[3] == JPEG_APP0 + IMAGE_METADATA_APP);
+	return 2 + ((image[4] << 8) | image[5]);
+}
+
+/* Find an attachment by the start of its name in the chunks of the POST.
+   Each chunk must be its attachment's declared length plus the header. */
+static uint8_t*
+attachment(const char* name, uint32_t* length) {
+	hostModemTx[hostModemTxLength] = '\0';
+	char* p = strstr((char*)hostModemTx, "\r\n\r\n");
+	CHECK(p != NULL);
+	p += 4;
+	for (;;) {
+		unsigned long chunk = strtoul(p, NULL, 16);
+		p = strstr(p, "\r\n") + 2;
+		if (chunk == 0) {
+			return NULL;
+		}
+		char header[33], found[32];
+		unsigned long declared;
+		memcpy(header, p, 32);
+		header[32] = '\0';
+		CHECK(sscanf(header, "%31[^,],%lu", found, &declared) == 2);
+		CHECK(declared + 32 == chunk);
+		CHECK((uint8_t*)p + chunk + 2 <= hostModemTx + hostModemTxLength);
+		if (strncmp(found, name, strlen(name)) == 0) {
+			*length = declared;
+			return (uint8_t*)p + 32;
+		}
+		p += chunk;
+		CHECK(p[0] == '\r' && p[1] == '\n');
+		p += 2;
+	}
+}
+
+/* Check the last image in the store is the frame with its metadata. */
+static void
+check_stored(void) {
+	RingCursor cursor;
+	RingRecord record, last = { 0 };
+	rlog_cursor(&imageStore, &cursor);
+	while (rlog_next(&imageStore, &cursor, &record) == RLOG_OK) {
+		last = record;
+	}
+	CHECK(last.Header.Type == RLOG_TYPE_JPEG);
+	CHECK(rlog_read(&imageStore, &last, 0, stored, last.Header.Length) == RLOG_OK);
+	uint32_t metadata = metadata_length(stored);
+	CHECK(last.Header.Length == frameLength + metadata);
+	CHECK(memcmp(stored + 2 + metadata, frame + 2, frameLength - 2) == 0);
+}
+
+int
+main(void) {
+	host_disk_create(90000);
+	fn_initvolume(host_disk_initfunc);
+	CHECK(f_format(F_FAT16_MEDIA) == F_NO_ERROR);
+	fn_delvolume();
+	CHECK(camera_task_setup() == 1);
+	CHECK(sample_ring_init(&sampleRing, sampleStorage, 16, SAMPLE_RING_OVERWRITE, 1) == SAMPLE_RING_OK);
+	xLiveQueue = xQueueCreate(1, sizeof(LiveImage));
+	xLiveResultQueue = xQueueCreate(1, sizeof(uint32_t));
+	xSLUpdatesQueue = xQueueCreate(8, sizeof(SLUpdate));
+
+	ATDevice dev;
+	dev.api.count = skywire_count;
+	dev.api.getc = skywire_getc;
+	dev.api.write = (uint8_t (*)(uint8_t*, uint8_t, uint8_t))skywire_write;
+	dev.buffer = modemBuffer;
+	dev.length = sizeof(modemBuffer);
+
+	HostJpegOptions options = { 640, 480, 3, 2, 1, 85, 0, 0 };
+	frameLength = host_jpeg_encode(&options, scene, NULL, frame, FRAME_MAX, NULL);
+	CHECK(frameLength > 0);
+	for (uint8_t i = 0; i < 3; i++) {
+		add_sample();
+	}
+
+	/* The image goes up at its real length, and the samples with it. */
+	capture(1);
+	CHECK(captureLive);
+	host_modem_reset();
+	hostFifoBursts = hostFifoBurstBytes = 0;
+	CHECK(upload_live(&dev) == 1);
+	CHECK(!hostSpiHeld);
+	uint32_t length;
+	CHECK(attachment(SAMPLE_ATTACHMENT, &length) != NULL);
+	CHECK(length > 0);
+	uint8_t* image = attachment("live", &length);
+	CHECK(image != NULL);
+	uint32_t metadata = metadata_length(image);
+	CHECK(length == frameLength + metadata);
+	CHECK(memcmp(image + 2 + metadata, frame + 2, frameLength - 2) == 0);
+	printf("live image: %lu bytes declared and sent for a %lu byte frame in a %lu byte FIFO\n",
+			(unsigned long)length, (unsigned long)frameLength, (unsigned long)hostFifoLength - 1);
+
+	/* The FIFO is read through to EOI twice, and never into the padding
+	   beyond the burst EOI falls in. */
+	CHECK(hostFifoBurstBytes <= 2 * (frameLength + LIVE_BURST_LENGTH + 1));
+	CHECK(hostFifoMaxBurst <= LIVE_BURST_LENGTH + 1);
+	SLUpdate update;
+	CHECK(xQueueReceive(xSLUpdatesQueue, &update, 0) == pdTRUE && update.limit == 50);
+
+	poll_live();
+	CHECK(!captureLive && !captureActive);
+	CHECK(!hostSpiHeld);
+	CHECK(rlog_used(&imageStore) == 0);
+	RingCursor cursor;
+	RingRecord record;
+	rlog_cursor(&dataLog, &cursor);
+	CHECK(rlog_next(&dataLog, &cursor, &record) != RLOG_OK);
+	printf("live upload: samples released, nothing on the card\n");
+
+	/* The modem fails part way through the image. The image is stored and
+	   the samples kept. */
+	add_sample();
+	capture(1);
+	CHECK(captureLive);
+	host_modem_reset();
+	hostModemFailAfter = 5000;
+	CHECK(upload_live(&dev) == 0);
+	hostModemFailAfter = ~0u;
+	CHECK(!hostSpiHeld);
+	poll_live();
+	CHECK(!captureLive && !captureActive);
+	check_stored();
+	rlog_cursor(&dataLog, &cursor);
+	CHECK(rlog_next(&dataLog, &cursor, &record) == RLOG_OK);
+	printf("modem failure: image stored, samples kept\n");
+	rlog_reset(&imageStore);
+
+	/* The server does not answer. */
+	sceneReferenceValid = 0;
+	capture(1);
+	CHECK(captureLive);
+	host_modem_reset();
+	hostModemAnswer = 0;
+	CHECK(upload_live(&dev) == 0);
+	hostModemAnswer = 1;
+	poll_live();
+	CHECK(!captureLive);
+	check_stored();
+	printf("no response: image stored\n");
+	rlog_reset(&imageStore);
+
+	/* The Skywire task stops waiting before it takes the image, and the
+	   camera task takes it back after LIVE_CLAIM_MS. */
+	sceneReferenceValid = 0;
+	capture(1);
+	CHECK(captureLive);
+	liveWaiting = 0;
+	poll_live();
+	CHECK(captureLive);
+	hostTicks += LIVE_CLAIM_MS;
+	poll_live();
+	CHECK(!captureLive);
+	check_stored();
+	LiveImage live;
+	CHECK(xQueueReceive(xLiveQueue, &live, 0) != pdTRUE);
+	printf("unclaimed: image taken back and stored\n");
+	rlog_reset(&imageStore);
+
+	/* With the Skywire task busy, the image goes straight to the card. */
+	sceneReferenceValid = 0;
+	capture(0);
+	CHECK(!captureLive && !captureActive);
+	check_stored();
+	printf("uplink busy: image stored\n");
+
+	host_disk_destroy();
+	printf("ok\n");
+	return 0;
+}
@@ -0,0 +1,248 @@
+/**
+ * Ring log on a multi-megabyte container: the head wraps the data area
+ * several times over records of mixed sizes, some records are aborted part
+ * way through, and rlog_seek() and rlog_rewind() find the records a model
+ * of the log expects, before and after the log is reopened.
+ */
+
+#include "host.h"
+#include "ring_log.h"
+
+#define LOG_NAME    "data.rlg"
+#define LOG_SECTORS 16384
+#define RECORDS     25000
+#define IMAGE_MAX   36000
+
+static RingLog ringLog;
+static uint8_t payload[IMAGE_MAX];
+
+/* Tick stamped on each committed record, by sequence number. */
+static uint32_t ticks[RECORDS * 2];
+static uint32_t sequence = 1;
+static uint32_t tick = 1000;
+static unsigned long aborts;
+
+static void
+open_log(void) {
+	CHECK(rlog_open(&ringLog, LOG_NAME, LOG_SECTORS) == RLOG_OK);
+	CHECK(ringLog.HeadSequence == sequence);
+}
+
+/* Consume the oldest records, as an upload does, until count have gone. */
+static void
+consume(int count) {
+	RingCursor cursor;
+	RingRecord record;
+	rlog_cursor(&ringLog, &cursor);
+	for (int i = 0; i < count && rlog_next(&ringLog, &cursor, &record) == RLOG_OK; i++) {
+		CHECK(record.Header.TickCount == ticks[record.Header.Sequence]);
+	}
+	CHECK(rlog_consume(&ringLog, &cursor) == RLOG_OK);
+}
+
+/* Write an image as the camera does, in chunks behind an aligned header.
+   Returns 0 if the log filled and the record was abandoned. */
+static int
+write_image(uint32_t length, uint32_t abortAfter) {
+	uint8_t result = rlog_begin_aligned(&ringLog, RLOG_TYPE_JPEG, tick, 0);
+	if (result == RLOG_FULL) {
+		return 0;
+	}
+	CHECK(result == RLOG_OK);
+	for (uint32_t offset = 0; offset < length; offset += 4096) {
+		if (offset >= abortAfter) {
+			CHECK(rlog_abort(&ringLog) == RLOG_OK);
+			aborts++;
+			return 1;
+		}
+		uint32_t count = (length - offset < 4096) ? length - offset : 4096;
+		result = rlog_write(&ringLog, payload + offset, count);
+		if (result == RLOG_FULL) {
+			return 0;
+		}
+		CHECK(result == RLOG_OK);
+	}
+	CHECK(rlog_end(&ringLog) == RLOG_OK);
+	ticks[sequence++] = tick;
+	return 1;
+}
+
+/* Append a record of random size, some of them images, some aborted. */
+static void
+append(void) {
+	tick += 1 + rand() % 5000;
+	for (;;) {
+		int written;
+		if (rand() % 20 == 0) {
+			uint32_t length = 20000 + rand() % (IMAGE_MAX - 20000);
+			uint32_t abortAfter = (rand() % 4 == 0) ? 12000 + rand() % (length - 12000) : length;
+			written = write_image(length, abortAfter);
+			if (written && abortAfter < length) {
+				/* A smaller retry takes the aborted record's place and
+				   number, short of the blocks the aborted one reached. */
+				length = 1000 + rand() % 4000;
+				written = write_image(length, length);
+			}
+		} else {
+			uint32_t length = 100 + rand() % 40;
+			uint8_t result = rlog_append(&ringLog, RLOG_TYPE_SAMPLE, tick, payload, length);
+			CHECK(result == RLOG_OK || result == RLOG_FULL);
+			written = (result == RLOG_OK);
+			if (written) {
+				ticks[sequence++] = tick;
+			}
+		}
+		if (written) {
+			return;
+		}
+		consume(300);
+	}
+}
+
+/* The first sequence number, at or after from, stamped at or after tick. */
+static uint32_t
+expected(uint32_t from, uint32_t target) {
+	for (uint32_t s = from; s < sequence; s++) {
+		if ((int32_t)(ticks[s] - target) >= 0) {
+			return s;
+		}
+	}
+	return 0;
+}
+
+/* Seek to random ticks across the history and the live records. */
+static void
+check_seeks(int count) {
+	RingCursor oldest;
+	CHECK(rlog_seek(&ringLog, 0, &oldest) == RLOG_OK || sequence == ringLog.TailSequence);
+	for (int i = 0; i < count; i++) {
+		uint32_t target = ticks[1] + (uint32_t)((uint64_t)rand() * (tick - ticks[1] + 10000) / RAND_MAX);
+		RingCursor cursor;
+		RingRecord record;
+		uint8_t result = rlog_seek(&ringLog, target, &cursor);
+		uint32_t live = expected(ringLog.TailSequence, target);
+		if (result == RLOG_EMPTY) {
+			CHECK(live == 0);
+			continue;
+		}
+		CHECK(result == RLOG_OK);
+		CHECK(rlog_next(&ringLog, &cursor, &record) == RLOG_OK);
+		uint32_t found = record.Header.Sequence;
+		CHECK(found < sequence);
+		CHECK(record.Header.TickCount == ticks[found]);
+		CHECK((int32_t)(ticks[found] - target) >= 0);
+		if ((int32_t)(target - ticks[ringLog.TailSequence]) > 0) {
+			/* Among the live records the answer is exact. */
+			CHECK(found == live);
+		} else {
+			/* In the history, counting from the oldest record found. */
+			CHECK(found <= ringLog.TailSequence);
+			CHECK(found == expected(oldest.Sequence, target));
+		}
+	}
+}
+
+/* Move the tail back to a tick in the history and read on from there. */
+static void
+check_rewind(void) {
+	uint32_t tailSequence = ringLog.TailSequence;
+	RingCursor cursor;
+	RingRecord record;
+
+	/* Nothing moves for a tick past the tail. */
+	CHECK(rlog_rewind(&ringLog, ticks[tailSequence] + 1) == RLOG_EMPTY);
+	CHECK(ringLog.TailSequence == tailSequence);
+
+	/* The oldest record still on the card bounds the rewind. */
+	CHECK(rlog_seek(&ringLog, 0, &cursor) == RLOG_OK);
+	uint32_t oldest = cursor.Sequence;
+	CHECK(oldest < tailSequence);
+
+	uint32_t target = ticks[oldest + (tailSequence - oldest) / 2];
+	CHECK(rlog_rewind(&ringLog, target) == RLOG_OK);
+	CHECK(ringLog.TailSequence == expected(oldest, target));
+	CHECK(rlog_used(&ringLog) > 0);
+	printf("rewound the tail from sequence %u to %u\n", tailSequence, ringLog.TailSequence);
+
+	/* Every record from there to the head reads back in order. */
+	rlog_cursor(&ringLog, &cursor);
+	uint32_t next = ringLog.TailSequence;
+	while (rlog_next(&ringLog, &cursor, &record) == RLOG_OK) {
+		CHECK(record.Header.Sequence == next);
+		CHECK(record.Header.TickCount == ticks[next]);
+		next++;
+	}
+	CHECK(next == sequence);
+
+	/* The rewind was checkpointed. */
+	open_log();
+	CHECK(ringLog.TailSequence == expected(oldest, target));
+}
+
+int
+main(void) {
+	host_disk_create(40000);
+	fn_initvolume(host_disk_initfunc);
+	CHECK(f_format(F_FAT16_MEDIA) == F_NO_ERROR);
+	CHECK(fn_initvolume(host_disk_initfunc) == F_NO_ERROR);
+	open_log();
+	printf("data area %u bytes, %u index slots\n", ringLog.Capacity, ringLog.IndexSlots);
+
+	srand(29);
+	for (uint32_t i = 0; i < 256; i++) {
+		payload[i] = (uint8_t)i;
+	}
+	for (uint32_t i = 256; i < IMAGE_MAX; i++) {
+		payload[i] = payload[i - 256] + 1;
+	}
+
+	uint64_t written = 0;
+	for (int i = 0; i < RECORDS; i++) {
+		uint32_t head = ringLog.Head;
+		unsigned long before = aborts;
+		append();
+		written += (ringLog.Head - head + ringLog.Capacity) % ringLog.Capacity;
+
+		/* Upload keeps up with half the log, leaving the rest as history,
+		   then falls behind until the log fills. */
+		if (i < RECORDS * 3 / 4 && rlog_used(&ringLog) > ringLog.Capacity / 2) {
+			consume(300);
+		}
+
+		/* Seek right after each abort, once its place has been taken. */
+		if (aborts != before) {
+			check_seeks(20);
+		}
+		if (i % 2000 == 1000) {
+			/* Reopen, from a checkpoint, with the head to be recovered. */
+			CHECK(rlog_flush(&ringLog) == RLOG_OK);
+			open_log();
+			check_seeks(50);
+		}
+	}
+	printf("%u records, %lu aborted, %llu bytes written, %.1f laps\n",
+			sequence - 1, aborts, (unsigned long long)written,
+			(double)written / ringLog.Capacity);
+	CHECK(aborts > 10);
+	CHECK(written > 3 * (uint64_t)ringLog.Capacity);
+
+	check_seeks(2000);
+
+	/* An abort leaves the index as it found it after a reopen too. */
+	tick += 1000;
+	CHECK(write_image(IMAGE_MAX, 5 * RLOG_INDEX_BLOCK) == 1);
+	CHECK(rlog_flush(&ringLog) == RLOG_OK);
+	open_log();
+	append();
+	check_seeks(200);
+
+	/* Upload catches up, leaving a full log of history to rewind into. */
+	consume(sequence - ringLog.TailSequence - 100);
+	check_rewind();
+	check_seeks(200);
+
+	fn_delvolume();
+	host_disk_destroy();
+	printf("ok\n");
+	return 0;
+}
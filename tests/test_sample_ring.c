@@ -0,0 +1,223 @@
+/**
+ * Sample ring under each overflow policy, at and past its capacity, with
+ * the indices about to wrap. Overwriting keeps the newest samples and
+ * counts the ones the consumer lost, decimation thins the samples above
+ * the high water mark, and blocking waits for room before dropping. The
+ * overwriting ring is also run with the producer and consumer on threads
+ * of their own.
+ */
+
+#include <pthread.h>
+
+#include "host.h"
+#include "sample_ring.h"
+
+#define CAPACITY 16
+#define THREAD_SAMPLES 2000000
+
+static Sample buffer[CAPACITY];
+static SampleRing ring;
+
+/* A sample whose fields all follow from its tick, so a torn copy shows. */
+static Sample
+sample(uint32_t tick) {
+	Sample s = { tick, (int32_t)(tick * 3), (int16_t)tick, (int16_t)(tick >> 3), (int16_t)~tick };
+	return s;
+}
+
+static void
+check_sample(const Sample* s, uint32_t tick) {
+	Sample expected = sample(tick);
+	CHECK(memcmp(s, &expected, sizeof(Sample)) == 0);
+}
+
+/* Set up an empty ring with its indices just short of wrapping. */
+static void
+init(uint8_t policy, uint8_t decimation) {
+	CHECK(sample_ring_init(&ring, buffer, CAPACITY, policy, decimation) == SAMPLE_RING_OK);
+	ring.Head = ring.Tail = 0xFFFFFFF8u;
+}
+
+/* Put samples with ticks from first, and count the ones kept. */
+static uint32_t
+put(uint32_t first, uint32_t count) {
+	uint32_t kept = 0;
+	for (uint32_t i = 0; i < count; i++) {
+		Sample s = sample(first + i);
+		kept += (sample_ring_put(&ring, &s, 0) == SAMPLE_RING_OK);
+	}
+	return kept;
+}
+
+static void
+check_overwrite(void) {
+	Sample out[CAPACITY * 2];
+	init(SAMPLE_RING_OVERWRITE, 1);
+
+	/* Full at one less than the capacity. */
+	CHECK(put(0, CAPACITY - 1) == CAPACITY - 1);
+	CHECK(sample_ring_count(&ring) == CAPACITY - 1);
+
+	/* Past it, the oldest go and the count stays put. */
+	CHECK(put(CAPACITY - 1, CAPACITY + 5) == CAPACITY + 5);
+	CHECK(ring.Dropped == 0);
+	CHECK(sample_ring_count(&ring) == CAPACITY - 1);
+
+	/* The consumer has been lapped: it skips to the newest CAPACITY - 1
+	   and counts the rest as overwritten. */
+	uint32_t total = 2 * CAPACITY + 4;
+	CHECK(sample_ring_get(&ring, out, CAPACITY * 2) == CAPACITY - 1);
+	for (uint32_t i = 0; i < CAPACITY - 1; i++) {
+		check_sample(&out[i], total - (CAPACITY - 1) + i);
+	}
+	CHECK(ring.Overwritten == total - (CAPACITY - 1));
+	CHECK(sample_ring_count(&ring) == 0);
+	CHECK(sample_ring_get(&ring, out, 1) == 0);
+
+	/* The newest is still there to be read once taken. */
+	Sample latest;
+	CHECK(sample_ring_latest(&ring, &latest));
+	check_sample(&latest, total - 1);
+
+	/* Partial takes leave the rest in order. */
+	CHECK(put(total, 5) == 5);
+	CHECK(sample_ring_get(&ring, out, 2) == 2);
+	check_sample(&out[0], total);
+	check_sample(&out[1], total + 1);
+	CHECK(sample_ring_get(&ring, out, CAPACITY) == 3);
+	check_sample(&out[2], total + 4);
+	CHECK(ring.Overwritten == total - (CAPACITY - 1));
+	printf("overwrite: newest %d kept, %lu overwritten\n", CAPACITY - 1, (unsigned long)ring.Overwritten);
+}
+
+static void
+check_decimate(void) {
+	const uint8_t decimation = 4;
+	const uint32_t highWater = CAPACITY * SAMPLE_RING_HIGH_WATER / 100;
+	Sample out[CAPACITY];
+	init(SAMPLE_RING_DECIMATE, decimation);
+
+	/* Every sample is kept up to the high water mark. */
+	CHECK(put(0, highWater) == highWater);
+	CHECK(ring.Dropped == 0);
+
+	/* Above it, one in decimation, until the ring is full. */
+	uint32_t tick = highWater;
+	for (uint32_t used = highWater; used < CAPACITY; used++) {
+		CHECK(put(tick, decimation - 1) == 0);
+		CHECK(put(tick + decimation - 1, 1) == 1);
+		tick += decimation;
+	}
+	CHECK(sample_ring_count(&ring) == CAPACITY);
+	CHECK(ring.Dropped == (CAPACITY - highWater) * (decimation - 1));
+
+	/* Full, every sample is dropped. */
+	CHECK(put(tick, 10) == 0);
+	CHECK(ring.Dropped == (CAPACITY - highWater) * (decimation - 1) + 10);
+	tick += 10;
+
+	/* The samples come out in order, thinning above the mark. */
+	CHECK(sample_ring_get(&ring, out, CAPACITY) == CAPACITY);
+	for (uint32_t i = 0; i < CAPACITY; i++) {
+		uint32_t expected = (i < highWater) ? i : highWater + (i - highWater + 1) * decimation - 1;
+		check_sample(&out[i], expected);
+	}
+	CHECK(ring.Overwritten == 0);
+
+	/* Emptied, every sample is kept again. */
+	CHECK(put(tick, highWater) == highWater);
+	printf("decimate: all kept to %lu, then 1 in %u, %lu dropped\n", (unsigned long)highWater,
+			decimation, (unsigned long)ring.Dropped);
+}
+
+static void
+check_block(void) {
+	Sample out[CAPACITY];
+	init(SAMPLE_RING_BLOCK, 1);
+
+	/* Every slot can be used. */
+	CHECK(put(0, CAPACITY) == CAPACITY);
+	CHECK(sample_ring_count(&ring) == CAPACITY);
+
+	/* Full, a put without a wait drops the sample at once, and one with a
+	   wait gives up after it. */
+	Sample s = sample(CAPACITY);
+	TickType_t start = hostTicks;
+	CHECK(sample_ring_put(&ring, &s, 0) == SAMPLE_RING_DROPPED);
+	CHECK(hostTicks == start);
+	CHECK(sample_ring_put(&ring, &s, 25) == SAMPLE_RING_DROPPED);
+	CHECK(hostTicks == start + 25);
+	CHECK(ring.Dropped == 2);
+
+	/* Once the consumer makes room, the put goes straight in. */
+	CHECK(sample_ring_get(&ring, out, 1) == 1);
+	check_sample(&out[0], 0);
+	start = hostTicks;
+	CHECK(sample_ring_put(&ring, &s, 25) == SAMPLE_RING_OK);
+	CHECK(hostTicks == start);
+	CHECK(sample_ring_get(&ring, out, CAPACITY) == CAPACITY);
+	check_sample(&out[0], 1);
+	check_sample(&out[CAPACITY - 1], CAPACITY);
+	CHECK(ring.Dropped == 2 && ring.Overwritten == 0);
+	printf("block: full at %d, %lu dropped after waiting\n", CAPACITY, (unsigned long)ring.Dropped);
+}
+
+static void*
+producer(void* context) {
+	for (uint32_t tick = 0; tick < THREAD_SAMPLES; tick++) {
+		Sample s = sample(tick);
+		CHECK(sample_ring_put(&ring, &s, 0) == SAMPLE_RING_OK);
+	}
+	return NULL;
+}
+
+/* Every sample taken must be whole and newer than the last, and every
+   sample put either taken or counted as overwritten. */
+static void
+check_threads(void) {
+	Sample out[CAPACITY];
+	init(SAMPLE_RING_OVERWRITE, 1);
+	pthread_t thread;
+	CHECK(pthread_create(&thread, NULL, producer, NULL) == 0);
+
+	uint32_t taken = 0, next = 0;
+	for (;;) {
+		uint8_t done = (ring.Head - 0xFFFFFFF8u == THREAD_SAMPLES);
+		uint32_t count = sample_ring_get(&ring, out, 1 + taken % CAPACITY);
+		for (uint32_t i = 0; i < count; i++) {
+			CHECK(out[i].TickCount >= next);
+			check_sample(&out[i], out[i].TickCount);
+			next = out[i].TickCount + 1;
+		}
+		taken += count;
+		if (done && count == 0) {
+			break;
+		}
+	}
+	CHECK(pthread_join(thread, NULL) == 0);
+	CHECK(next == THREAD_SAMPLES);
+	CHECK(taken + ring.Overwritten == THREAD_SAMPLES);
+	printf("threads: %lu taken, %lu overwritten\n", (unsigned long)taken, (unsigned long)ring.Overwritten);
+}
+
+int
+main(void) {
+	/* The capacity must be a power of two, and the decimation nonzero. */
+	CHECK(sample_ring_init(&ring, buffer, 1, SAMPLE_RING_OVERWRITE, 1) == SAMPLE_RING_ERROR);
+	CHECK(sample_ring_init(&ring, buffer, 12, SAMPLE_RING_OVERWRITE, 1) == SAMPLE_RING_ERROR);
+	CHECK(sample_ring_init(&ring, buffer, CAPACITY, SAMPLE_RING_DECIMATE, 0) == SAMPLE_RING_ERROR);
+
+	/* Nothing to read before the first sample. */
+	Sample latest;
+	init(SAMPLE_RING_OVERWRITE, 1);
+	ring.Head = ring.Tail = 0;
+	CHECK(!sample_ring_latest(&ring, &latest));
+
+	check_overwrite();
+	check_decimate();
+	check_block();
+	check_threads();
+
+	printf("ok\n");
+	return 0;
+}
@@ -0,0 +1,311 @@
+/**
+ * Samples from SampleRecords and packed blocks back to DATA lines through
+ * tools/sample_decode.py, the way the server reads samples.bin. The lines
+ * must match the ones the firmware formats itself, for readings at the
+ * ends of their ranges and with channels missing, with records and blocks
+ * mixed in one file. A record with a bad CRC or an unknown version is
+ * reported and skipped, and the rest still decoded. A block of the worst
+ * samples fits SAMPLE_PACK_LENGTH, and a typical day packs to a fraction
+ * of the size of the records.
+ */
+
+#include <unistd.h>
+
+#include "host.h"
+#include "sample_record.h"
+#include "sample_pack.h"
+#include "task/camera_task.h"
+
+#ifndef SAMPLE_DECODE
+#define SAMPLE_DECODE "../tools/sample_decode.py"
+#endif
+
+#define SAMPLES    500
+#define DAY        2880  /* Four hours at a sample every 5 s */
+#define LINE_MAX   160
+#define OUTPUT_MAX (DAY * LINE_MAX)
+
+/* Bytes a typical sample may take once packed, a third of a record. */
+#define PACKED_SAMPLE_MAX (sizeof(SampleRecord) / 3.0)
+
+int format_readings(char* buffer, uint8_t length, Sample* sample);
+
+static Sample samples[DAY];
+static char expected[OUTPUT_MAX];
+static char output[OUTPUT_MAX];
+
+/* The DATA line the firmware wrote for a sample. */
+static int
+data_line(char* buffer, uint32_t length, Sample* sample) {
+	char readings[LINE_MAX];
+	format_readings(readings, LINE_MAX, sample);
+	return snprintf(buffer, length, "DATA:{\"tick\":%lu,%s}\n",
+			(unsigned long)sample->TickCount, readings);
+}
+
+/* Readings drifting through a typical day, and with edges, some at the
+   ends of their ranges and some channels missing. */
+static void
+make_samples(int count, uint8_t edges) {
+	int32_t lpsTemp = 2150, lpsPres = 101325, htsTemp = 2200, htsHum = 4500;
+	uint32_t tick = 5000;
+	for (int i = 0; i < count; i++) {
+		lpsTemp += rand() % 7 - 3;
+		lpsPres += rand() % 21 - 10;
+		htsTemp += rand() % 5 - 2;
+		htsHum += rand() % 31 - 15;
+		tick += 5000 + rand() % 9 - 4;
+		Sample sample = { tick, lpsPres, lpsTemp, htsTemp, htsHum };
+		samples[i] = sample;
+		if (!edges) {
+			continue;
+		}
+		if (i % 13 == 3) {
+			sample.LPS331Pressure = SAMPLE_NO_READING;
+		}
+		if (i % 17 == 5) {
+			sample.HTS221Humidity = SAMPLE_NO_READING;
+		}
+		if (i % 29 == 0) {
+			sample.LPS331Temperature = -32767;
+			sample.HTS221Temperature = 32767;
+		}
+		if (i % 31 == 1) {
+			sample.LPS331Pressure = INT32_MAX;
+			sample.TickCount = 0xFFFFFFFF;
+		}
+		if (i % 37 == 2) {
+			sample.LPS331Pressure = INT32_MIN;
+		}
+		if (i % 41 == 7) {
+			sample.LPS331Temperature = sample.LPS331Pressure = SAMPLE_NO_READING;
+			sample.HTS221Temperature = sample.HTS221Humidity = SAMPLE_NO_READING;
+		}
+		samples[i] = sample;
+	}
+}
+
+/* Run the decoder over a file, with its output and its errors in buffers. */
+static void
+decode(const char* path, char* out, uint32_t outLength, char* errors, uint32_t errorsLength) {
+	char errorPath[] = "/tmp/sample_errorsXXXXXX";
+	int descriptor = mkstemp(errorPath);
+	CHECK(descriptor >= 0);
+	close(descriptor);
+
+	char command[512];
+	snprintf(command, sizeof(command), "python3 %s %s 2>%s", SAMPLE_DECODE, path, errorPath);
+	FILE* pipe = popen(command, "r");
+	CHECK(pipe != NULL);
+	size_t length = fread(out, 1, outLength - 1, pipe);
+	out[length] = '\0';
+	CHECK(pclose(pipe) == 0);
+
+	FILE* file = fopen(errorPath, "r");
+	CHECK(file != NULL);
+	length = fread(errors, 1, errorsLength - 1, file);
+	errors[length] = '\0';
+	fclose(file);
+	unlink(errorPath);
+}
+
+/* Print the sizes the decoder gives for a file, and check it counts the
+   same samples and bytes. */
+static void
+check_stats(const char* path, uint32_t samples, uint32_t bytes) {
+	char command[512], line[128];
+	snprintf(command, sizeof(command), "python3 %s --stats %s", SAMPLE_DECODE, path);
+	FILE* pipe = popen(command, "r");
+	CHECK(pipe != NULL);
+	unsigned long count = 0, size = 0;
+	while (fgets(line, sizeof(line), pipe) != NULL) {
+		printf("  %s", line);
+		sscanf(line, "samples %lu", &count);
+		sscanf(line, "stored bytes %lu", &size);
+	}
+	CHECK(pclose(pipe) == 0);
+	CHECK(count == samples && size == bytes);
+}
+
+/* Create a temporary file, its name in path. */
+static FILE*
+create(char* path) {
+	strcpy(path, "/tmp/samplesXXXXXX");
+	int descriptor = mkstemp(path);
+	CHECK(descriptor >= 0);
+	FILE* file = fdopen(descriptor, "wb");
+	CHECK(file != NULL);
+	return file;
+}
+
+/* Write samples in batches of SAMPLE_FLUSH_BATCH as flush_samples() does,
+   each batch as a packed block, or as records where records is set and
+   every fifth batch. Returns the bytes written. */
+static uint32_t
+write_samples(FILE* file, int count, uint8_t records) {
+	uint8_t block[SAMPLE_PACK_LENGTH(SAMPLE_FLUSH_BATCH)];
+	uint32_t written = 0;
+	for (int i = 0; i < count; i += SAMPLE_FLUSH_BATCH) {
+		int batch = MIN(SAMPLE_FLUSH_BATCH, count - i);
+		if (records && (i / SAMPLE_FLUSH_BATCH) % 5 == 4) {
+			for (int k = 0; k < batch; k++) {
+				SampleRecord record;
+				sample_record_encode(&record, &samples[i + k]);
+				CHECK(fwrite(&record, sizeof(record), 1, file) == 1);
+				written += sizeof(record);
+			}
+			continue;
+		}
+		SamplePack pack;
+		sample_pack_begin(&pack, block, sizeof(block));
+		for (int k = 0; k < batch; k++) {
+			CHECK(sample_pack_add(&pack, &samples[i + k]) == SAMPLE_PACK_OK);
+		}
+		uint16_t length = sample_pack_end(&pack);
+		CHECK(length <= SAMPLE_PACK_LENGTH(batch));
+		CHECK(fwrite(block, length, 1, file) == 1);
+		written += length;
+	}
+	return written;
+}
+
+static uint32_t
+data_lines(char* buffer, int count) {
+	uint32_t length = 0;
+	for (int i = 0; i < count; i++) {
+		length += data_line(buffer + length, OUTPUT_MAX - length, &samples[i]);
+	}
+	return length;
+}
+
+/* A block of samples each as large as a sample can be packed, with the
+   tick and every value swinging further than a 16 bit code holds, are
+   added until the block is full. SAMPLE_PACK_LENGTH must give room for at
+   least as many as asked for, and the block must stay in its buffer. */
+static void
+check_worst_block(void) {
+	uint8_t block[SAMPLE_PACK_LENGTH(SAMPLE_FLUSH_BATCH)];
+	SamplePack pack;
+	sample_pack_begin(&pack, block, sizeof(block));
+	int count = 0;
+	for (;;) {
+		int k = count;
+		int16_t value = (k & 1) ? -32767 : 32767;
+		Sample sample = { (k & 1) ? 0 : 0x40000000u, (k & 1) ? -0x40000000 : 0x40000000,
+				value, value, value };
+		samples[k] = sample;
+		if (sample_pack_add(&pack, &sample) == SAMPLE_PACK_FULL) {
+			break;
+		}
+		count++;
+	}
+	CHECK(count >= SAMPLE_FLUSH_BATCH);
+	CHECK(pack.Count == count);
+	uint16_t length = sample_pack_end(&pack);
+	CHECK(length <= sizeof(block));
+
+	char path[32];
+	FILE* file = create(path);
+	CHECK(fwrite(block, length, 1, file) == 1);
+	fclose(file);
+	char errors[1024];
+	data_lines(expected, count);
+	decode(path, output, OUTPUT_MAX, errors, sizeof(errors));
+	CHECK(strcmp(output, expected) == 0);
+	CHECK(errors[0] == '\0');
+	unlink(path);
+	printf("worst block: full at %d samples, %u bytes of %lu\n", count, length,
+			(unsigned long)sizeof(block));
+
+	/* The count is a byte, so a block holds at most 255 samples. */
+	static uint8_t large[SAMPLE_PACK_LENGTH(300)];
+	Sample extra = { 0 };
+	sample_pack_begin(&pack, large, sizeof(large));
+	for (int k = 0; k < UINT8_MAX; k++) {
+		CHECK(sample_pack_add(&pack, &extra) == SAMPLE_PACK_OK);
+	}
+	CHECK(sample_pack_add(&pack, &extra) == SAMPLE_PACK_FULL);
+}
+
+int
+main(void) {
+	srand(49);
+	make_samples(SAMPLES, 1);
+
+	/* Every sample as a record, back to back as in samples.bin. */
+	char path[32];
+	FILE* file = create(path);
+	uint32_t length = 0;
+	for (int i = 0; i < SAMPLES; i++) {
+		SampleRecord record;
+		sample_record_encode(&record, &samples[i]);
+		CHECK(fwrite(&record, sizeof(record), 1, file) == 1);
+		length += data_line(expected + length, OUTPUT_MAX - length, &samples[i]);
+	}
+	fclose(file);
+
+	char errors[1024];
+	decode(path, output, OUTPUT_MAX, errors, sizeof(errors));
+	CHECK(strcmp(output, expected) == 0);
+	CHECK(errors[0] == '\0');
+	printf("%d records decoded to the firmware's DATA lines\n", SAMPLES);
+
+	/* A record with a bad CRC and one from a later layout are skipped. */
+	file = fopen(path, "r+b");
+	CHECK(file != NULL);
+	uint8_t byte;
+	CHECK(fseek(file, 10 * sizeof(SampleRecord) + 4, SEEK_SET) == 0);
+	CHECK(fread(&byte, 1, 1, file) == 1);
+	byte ^= 0x01;
+	CHECK(fseek(file, 10 * sizeof(SampleRecord) + 4, SEEK_SET) == 0);
+	CHECK(fwrite(&byte, 1, 1, file) == 1);
+	byte = SAMPLE_RECORD_VERSION + 7;
+	CHECK(fseek(file, 20 * sizeof(SampleRecord), SEEK_SET) == 0);
+	CHECK(fwrite(&byte, 1, 1, file) == 1);
+	fclose(file);
+
+	length = 0;
+	for (int i = 0; i < SAMPLES; i++) {
+		if (i != 10 && i != 20) {
+			length += data_line(expected + length, OUTPUT_MAX - length, &samples[i]);
+		}
+	}
+	decode(path, output, OUTPUT_MAX, errors, sizeof(errors));
+	CHECK(strcmp(output, expected) == 0);
+	CHECK(strstr(errors, "bad record at offset 200") != NULL);
+	CHECK(strstr(errors, "bad record at offset 400") != NULL);
+	printf("bad records skipped:\n%s", errors);
+	unlink(path);
+
+	/* Packed blocks with batches of records between them. */
+	file = create(path);
+	write_samples(file, SAMPLES, 1);
+	fclose(file);
+	data_lines(expected, SAMPLES);
+	decode(path, output, OUTPUT_MAX, errors, sizeof(errors));
+	CHECK(strcmp(output, expected) == 0);
+	CHECK(errors[0] == '\0');
+	printf("%d samples decoded from blocks and records\n", SAMPLES);
+	unlink(path);
+
+	check_worst_block();
+
+	/* How small a typical day packs, against records and DATA lines. */
+	make_samples(DAY, 0);
+	file = create(path);
+	uint32_t packed = write_samples(file, DAY, 0);
+	fclose(file);
+	uint32_t text = data_lines(expected, DAY);
+	decode(path, output, OUTPUT_MAX, errors, sizeof(errors));
+	CHECK(strcmp(output, expected) == 0);
+	CHECK(errors[0] == '\0');
+	printf("%d samples: %lu bytes packed, %.2f per sample; %.1f times smaller than records, "
+			"%.1f times smaller than DATA lines\n", DAY, (unsigned long)packed, (double)packed / DAY,
+			(double)DAY * sizeof(SampleRecord) / packed, (double)text / packed);
+	check_stats(path, DAY, packed);
+	CHECK((double)packed / DAY <= PACKED_SAMPLE_MAX);
+	unlink(path);
+
+	printf("ok\n");
+	return 0;
+}
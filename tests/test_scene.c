@@ -0,0 +1,165 @@
+/**
+ * Scene change detection over a roadside sequence: a static background
+ * with sensor noise and slow changes in brightness, and a car crossing in
+ * some frames, at two qualities and with and without restart markers. The
+ * signature decoded from the DC coefficients as the FIFO streams past must
+ * match the mean of the encoded pixels, the car frames must be stored, and
+ * the frames with no change logged as unchanged.
+ *
+ *   test_scene [directory]   also writes the frames, for scene_check
+ */
+
+#include <math.h>
+#include <sys/stat.h>
+
+#include "host.h"
+#include "jpeg.h"
+#include "task/camera_task.h"
+
+#define WIDTH     640
+#define HEIGHT    480
+#define FRAMES    40
+#define FRAME_MAX (1 << 20)
+
+/* Largest difference allowed between a signature cell and the mean of the
+   pixels, in grey levels, for the DC quantisation and the rounding. */
+#define SIGNATURE_ERROR 2
+
+typedef struct _Frame {
+	int Number;
+	double Gain;
+	int Car;
+	int CarX;
+} Frame;
+
+static uint8_t frame[FRAME_MAX];
+static uint8_t means[(WIDTH / 8) * (HEIGHT / 8)];
+
+static uint32_t
+hash(uint32_t x, uint32_t y, uint32_t seed) {
+	uint32_t h = x * 0x9E3779B1u ^ y * 0x85EBCA77u ^ seed * 0xC2B2AE3Du;
+	h ^= h >> 15;
+	h *= 0x2C1B3C6Du;
+	h ^= h >> 12;
+	return h;
+}
+
+static uint8_t
+clamp(double value) {
+	return (value < 0) ? 0 : (value > 255) ? 255 : (uint8_t)(value + 0.5);
+}
+
+/* Sky, a road with lane marks and a verge, and a white car on the road. */
+static uint8_t
+scene(void* context, uint32_t x, uint32_t y, uint8_t component) {
+	const Frame* f = context;
+	double v = (y < 200) ? 170 + 30 * sin(x / 40.0) : (y < 380) ? 90 + ((x / 60) % 2) * 5 : 120;
+	if (y > 330 && y < 336 && (x / 40) % 2) {
+		v = 230;
+	}
+	double r = v, g = v, b = v + 10;
+	if (f->Car && y > 260 && y < 360 && (int)x > f->CarX && (int)x < f->CarX + 180) {
+		r = 220;
+		g = 220;
+		b = 225;
+	}
+	double noise = (int)(hash(x, y, f->Number) % 9) - 4;
+	r = r * f->Gain + noise;
+	g = g * f->Gain + noise;
+	b = b * f->Gain + noise;
+	switch (component) {
+	case 0:
+		return clamp(0.299 * r + 0.587 * g + 0.114 * b);
+	case 1:
+		return clamp(128 - 0.168736 * r - 0.331264 * g + 0.5 * b);
+	default:
+		return clamp(128 + 0.5 * r - 0.418688 * g - 0.081312 * b);
+	}
+}
+
+/* Check the signature against the means of the encoded luma blocks, over
+   the MCU grid the decoder divides into cells. */
+static double
+signature_error(const uint8_t* signature) {
+	const int mcusX = WIDTH / 16, mcusY = HEIGHT / 8, blocksX = WIDTH / 8;
+	double sums[JPEG_SIGNATURE_CELLS] = { 0 };
+	int counts[JPEG_SIGNATURE_CELLS] = { 0 };
+	for (int by = 0; by < HEIGHT / 8; by++) {
+		for (int bx = 0; bx < blocksX; bx++) {
+			int cell = (by * JPEG_SIGNATURE_GRID / mcusY) * JPEG_SIGNATURE_GRID
+					+ (bx / 2) * JPEG_SIGNATURE_GRID / mcusX;
+			sums[cell] += means[by * blocksX + bx];
+			counts[cell]++;
+		}
+	}
+	double worst = 0;
+	for (int i = 0; i < JPEG_SIGNATURE_CELLS; i++) {
+		double error = fabs(signature[i] - sums[i] / counts[i]);
+		worst = (error > worst) ? error : worst;
+	}
+	return worst;
+}
+
+int
+main(int argc, char** argv) {
+	const char* directory = (argc > 1) ? argv[1] : NULL;
+	if (directory != NULL) {
+		mkdir(directory, 0755);
+	}
+	host_scene_setup();
+
+	int stored = 0, same = 0;
+	double worst = 0;
+	for (int n = 0; n < FRAMES; n++) {
+		/* Clouds, and a car in frames 6 to 9 of every 10, moving across. */
+		Frame f = { n, 1.0 + 0.15 * sin(n / 6.0), n % 10 >= 6, (n % 10 - 6) * 150 + 20 };
+		HostJpegOptions options = { WIDTH, HEIGHT, 3, 2, 1, (n % 3 == 0) ? 60 : 85, (n % 2) ? 0 : 8, 0 };
+		uint32_t length = host_jpeg_encode(&options, scene, &f, frame, FRAME_MAX, means);
+		CHECK(length > 0);
+		if (directory != NULL) {
+			char path[1024];
+			snprintf(path, sizeof(path), "%s/f%02d.jpg", directory, n);
+			FILE* file = fopen(path, "wb");
+			CHECK(file != NULL);
+			CHECK(fwrite(frame, 1, length, file) == length);
+			fclose(file);
+		}
+
+		HostSceneFrame result;
+		host_scene_frame(frame, length, IMAGE_RATE_MS, &result);
+		CHECK(result.Decoded);
+		double error = signature_error(result.Signature);
+		worst = (error > worst) ? error : worst;
+		CHECK(error <= SIGNATURE_ERROR);
+
+		/* The first frame, the car frames and the first frame after the
+		   car has gone differ from the last stored image. */
+		int changed = (n == 0) || f.Car || (n % 10 == 0);
+		printf("f%02d: %6lu bytes, %2u cells changed, %s\n", n, (unsigned long)length,
+				result.Cells, result.Stored ? "stored" : "same");
+		CHECK(result.Stored == changed);
+		CHECK(result.Same == !changed);
+		CHECK(changed ? result.Cells >= SCENE_CHANGE_CELLS : result.Cells < SCENE_CHANGE_CELLS);
+		stored += result.Stored;
+		same += result.Same;
+	}
+	printf("%d stored, %d logged as unchanged, worst signature error %.2f grey levels\n",
+			stored, same, worst);
+
+	/* Once the car has gone, a keyframe is still stored however little has
+	   changed. */
+	Frame f = { FRAMES, 1.0, 0, 0 };
+	HostJpegOptions options = { WIDTH, HEIGHT, 3, 2, 1, 85, 0, 0 };
+	uint32_t length = host_jpeg_encode(&options, scene, &f, frame, FRAME_MAX, NULL);
+	HostSceneFrame result;
+	host_scene_frame(frame, length, IMAGE_RATE_MS, &result);
+	CHECK(result.Stored);
+	host_scene_frame(frame, length, IMAGE_RATE_MS, &result);
+	CHECK(result.Same && result.Cells == 0);
+	host_scene_frame(frame, length, SCENE_KEYFRAME_MS, &result);
+	CHECK(result.Stored);
+
+	host_disk_destroy();
+	printf("ok\n");
+	return 0;
+}
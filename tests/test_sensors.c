@@ -0,0 +1,188 @@
+/**
+ * Fixed point sensor conversions against the float conversions they
+ * replaced. The HTS221 is given random calibrations over the range the
+ * datasheet allows, and each conversion must come within a hundredth of
+ * the float result rounded to hundredths. The LPS331 conversions are
+ * checked over their whole input range. Readings also go through the
+ * register reads, over a simulated I2C bus.
+ */
+
+#include <math.h>
+
+#include "host.h"
+#include "peripheral/hts221.h"
+#include "peripheral/lps331.h"
+#include "peripheral/i2c_spi_bus.h"
+
+#define CALIBRATIONS 2000
+#define READINGS     200
+
+/* Largest difference allowed from the float result, in hundredths. */
+#define CONVERSION_ERROR 1
+
+/* The register files of the two sensors. */
+static uint8_t hts221Registers[256];
+static uint8_t lps331Registers[256];
+
+typedef struct _Errors {
+	long Worst;
+	unsigned long Count;
+} Errors;
+
+/* The sensors on the bus, which increment the register address after each
+   byte read when the MSB of the address is set. */
+Devices_StatusTypeDef
+i2c_read8(uint8_t device, uint8_t address, uint8_t* data, uint8_t length) {
+	uint8_t* registers = (device == LPS331_ADDRESS) ? lps331Registers : hts221Registers;
+	CHECK(device == LPS331_ADDRESS || device == HTS221_ADDRESS_R);
+	for (uint8_t i = 0; i < length; i++) {
+		data[i] = registers[(address & 0x7F) + ((address & 0x80) ? i : 0)];
+	}
+	return DEVICES_OK;
+}
+
+Devices_StatusTypeDef
+i2c_write8_8(uint8_t device, uint8_t address, uint8_t data) {
+	return DEVICES_OK;
+}
+
+/* The previous calibration, kept as floats and interpolated on each read. */
+typedef struct _FloatCalib {
+	float H0_rH;
+	float H1_rH;
+	float T0_degC;
+	float T1_degC;
+	int16_t H0_T0_OUT;
+	int16_t H1_T0_OUT;
+	int16_t T0_OUT;
+	int16_t T1_OUT;
+} FloatCalib;
+
+static void
+float_calib(FloatCalib* calib) {
+	uint8_t* buffer = &hts221Registers[HTS221_H0_rH_x2];
+	calib->H0_rH = (float)buffer[0] / 2.0;
+	calib->H1_rH = (float)buffer[1] / 2.0;
+	calib->T0_degC = (float)(buffer[2] + ((buffer[5] & 0x3) << 8)) / 8.0;
+	calib->T1_degC = (float)(buffer[3] + ((buffer[5] & 0xC) << 6)) / 8.0;
+	calib->H0_T0_OUT = (int16_t)(buffer[6] | (buffer[7] << 8));
+	calib->H1_T0_OUT = (int16_t)(buffer[10] | (buffer[11] << 8));
+	calib->T0_OUT = (int16_t)(buffer[12] | (buffer[13] << 8));
+	calib->T1_OUT = (int16_t)(buffer[14] | (buffer[15] << 8));
+}
+
+static float
+float_temp_C(const FloatCalib* c, int16_t temp) {
+	return c->T0_degC + (float)(c->T1_degC - c->T0_degC) *
+			((float)(temp - c->T0_OUT) / (float)(c->T1_OUT - c->T0_OUT));
+}
+
+static float
+float_hum_rel(const FloatCalib* c, int16_t hum) {
+	return c->H0_rH + (float)(c->H1_rH - c->H0_rH) *
+			((float)(hum - c->H0_T0_OUT) / (float)(c->H1_T0_OUT - c->H0_T0_OUT));
+}
+
+static void
+put16(uint8_t* registers, uint8_t address, int16_t value) {
+	registers[address] = value & 0xFF;
+	registers[address + 1] = (value >> 8) & 0xFF;
+}
+
+/* Compare a fixed point result with the float one, where the float one is
+   in the range the result can hold. */
+static void
+compare(Errors* errors, long fixed, double reference) {
+	if (fabs(reference * 100) >= INT16_MAX) {
+		return;
+	}
+	long error = labs(fixed - lround(reference * 100));
+	errors->Worst = (error > errors->Worst) ? error : errors->Worst;
+	errors->Count++;
+}
+
+/* A calibration as the factory writes it: two humidity points in 1/2 %rH
+   and two temperature points in 1/8 degC, ten bits wide, with the counts
+   the sensor gave at each. */
+static void
+random_calibration(void) {
+	uint8_t* c = &hts221Registers[HTS221_H0_rH_x2];
+	int h0 = rand() % 80 + 20, h1 = h0 + rand() % 100 + 40;
+	int t0 = rand() % 160 + 40, t1 = t0 + rand() % 240 + 80;
+	int16_t h0Out = rand() % 20000 - 10000;
+	int16_t h1Out = h0Out + (rand() % 12000 + 3000) * ((rand() & 1) ? 1 : -1);
+	int16_t t0Out = rand() % 2000 - 1000;
+	int16_t t1Out = t0Out + (rand() % 1000 + 200) * ((rand() & 1) ? 1 : -1);
+	memset(c, 0, 16);
+	c[0] = h0;
+	c[1] = h1;
+	c[2] = t0 & 0xFF;
+	c[3] = t1 & 0xFF;
+	c[5] = ((t0 >> 8) & 3) | (((t1 >> 8) & 3) << 2);
+	put16(c, 6, h0Out);
+	put16(c, 10, h1Out);
+	put16(c, 12, t0Out);
+	put16(c, 14, t1Out);
+}
+
+int
+main(void) {
+	Errors hts221Temp = { 0 }, hts221Hum = { 0 }, lps331Temp = { 0 }, lps331Pres = { 0 };
+	srand(45);
+
+	for (int k = 0; k < CALIBRATIONS; k++) {
+		random_calibration();
+		FloatCalib calib;
+		float_calib(&calib);
+		CHECK(hts221_read_calib(&hts221_calib) == DEVICES_OK);
+		for (int j = 0; j < READINGS; j++) {
+			int16_t temp = calib.T0_OUT + rand() % 3000 - 1500;
+			int16_t hum = (int16_t)(rand() % 65536);
+			compare(&hts221Temp, hts221_temp_cC(temp), float_temp_C(&calib, temp));
+			compare(&hts221Hum, hts221_hum_crH(hum), float_hum_rel(&calib, hum));
+		}
+
+		/* The same through the register reads. */
+		int16_t temp = calib.T0_OUT + rand() % 3000 - 1500;
+		int16_t hum = calib.H0_T0_OUT + rand() % 2000 - 1000;
+		put16(hts221Registers, HTS221_HUMIDITY_OUT_L, hum);
+		put16(hts221Registers, HTS221_TEMP_OUT_L, temp);
+		HTS221_SampleTypeDef sample;
+		CHECK(hts221_read_sample(&sample) == DEVICES_OK);
+		CHECK(sample.Humidity == hum && sample.Temperature == temp);
+		compare(&hts221Temp, hts221_temp_cC(sample.Temperature), float_temp_C(&calib, temp));
+		compare(&hts221Hum, hts221_hum_crH(sample.Humidity), float_hum_rel(&calib, hum));
+		compare(&hts221Temp, lroundf(hts221_read_temp_C() * 100), float_temp_C(&calib, temp));
+		compare(&hts221Hum, lroundf(hts221_read_hum_rel() * 100), float_hum_rel(&calib, hum));
+	}
+
+	/* Every LPS331 temperature, and pressures over the 24 bit range. */
+	for (int32_t value = INT16_MIN; value <= INT16_MAX; value++) {
+		compare(&lps331Temp, lps331_temp_cC(value), 42.5 + ((float)value / 480.0));
+	}
+	for (int32_t value = 0; value < (1 << 24); value += 7) {
+		compare(&lps331Pres, lps331_pres_Pa(value), (float)value / 4096.0);
+	}
+	int32_t pressure = 1013 * 4096 + 1234;
+	lps331Registers[LPS331_PRESS_OUT_XL] = pressure & 0xFF;
+	lps331Registers[LPS331_PRESS_OUT_XL + 1] = (pressure >> 8) & 0xFF;
+	lps331Registers[LPS331_PRESS_OUT_XL + 2] = (pressure >> 16) & 0xFF;
+	put16(lps331Registers, LPS331_TEMP_OUT_L, -9600);
+	LPS331_SampleTypeDef sample;
+	CHECK(lps331_read_sample(&sample) == DEVICES_OK);
+	CHECK(sample.Pressure == pressure && sample.Temperature == -9600);
+	compare(&lps331Pres, lps331_pres_Pa(sample.Pressure), (float)pressure / 4096.0);
+	compare(&lps331Temp, lps331_temp_cC(sample.Temperature), 42.5 + (-9600 / 480.0));
+
+	printf("hts221 temperature: worst %ld hundredth over %lu readings\n", hts221Temp.Worst, hts221Temp.Count);
+	printf("hts221 humidity:    worst %ld hundredth over %lu readings\n", hts221Hum.Worst, hts221Hum.Count);
+	printf("lps331 temperature: worst %ld hundredth over %lu readings\n", lps331Temp.Worst, lps331Temp.Count);
+	printf("lps331 pressure:    worst %ld Pa over %lu readings\n", lps331Pres.Worst, lps331Pres.Count);
+	CHECK(hts221Temp.Worst <= CONVERSION_ERROR);
+	CHECK(hts221Hum.Worst <= CONVERSION_ERROR);
+	CHECK(lps331Temp.Worst <= CONVERSION_ERROR);
+	CHECK(lps331Pres.Worst <= CONVERSION_ERROR);
+
+	printf("ok\n");
+	return 0;
+}
@@ -0,0 +1,199 @@
+/**
+ * JPEG size control over three days of frames every IMAGE_RATE_MS. Scene
+ * detail follows a day and night cycle, with cloud cover as a slow random
+ * walk and noise from frame to frame. The size of each frame comes from a
+ * table of 720p frames encoded over a range of detail and qscale, so
+ * camera_size_control() sees the sizes the encoder gives. With it the
+ * frames stay near IMAGE_TARGET_BYTES, where a fixed qscale lets them
+ * swing with the light.
+ */
+
+#include <math.h>
+
+#include "host.h"
+#include "task/camera_task.h"
+#include "peripheral/arducam.h"
+
+#define FRAMES (3 * 24 * 60 * 60 * 1000 / IMAGE_RATE_MS)
+#define FRAME_MAX (1 << 20)
+
+void camera_size_control(uint32_t imageLength);
+
+/* The OV5642 scales its quantisation tables by qscale. qscale 12 is taken
+   as the Annex K tables at quality 50, unscaled. */
+#define QSCALE_UNSCALED 12
+
+/* Detail levels and qscales the sizes are tabulated at. */
+#define DETAIL_STEPS 7
+#define DETAIL_MAX   1.5
+static const uint8_t qscales[] = { 2, 3, 4, 6, 8, 12, 16, 24, 32, 48, 63 };
+#define QSCALE_STEPS (int)(sizeof(qscales) / sizeof(qscales[0]))
+
+typedef struct _Sizes {
+	unsigned Within;
+	double Sum;
+	double SumSquares;
+	double Min;
+	double Max;
+} Sizes;
+
+/* Log of the frame size by detail step and qscale. */
+static double logSizes[DETAIL_STEPS][QSCALE_STEPS];
+static uint8_t frame[FRAME_MAX];
+
+static uint8_t
+quality(uint8_t qscale) {
+	if (qscale >= QSCALE_UNSCALED) {
+		return 50 * QSCALE_UNSCALED / qscale;
+	}
+	return 100 - 50 * qscale / QSCALE_UNSCALED;
+}
+
+static uint32_t
+hash(uint32_t x, uint32_t y) {
+	uint32_t h = x * 0x9E3779B1u ^ y * 0x85EBCA77u;
+	h ^= h >> 15;
+	h *= 0x2C1B3C6Du;
+	h ^= h >> 12;
+	return h;
+}
+
+/* Sky over a road with lane marks. The light and the texture rise with the
+   detail. */
+static uint8_t
+scene(void* context, uint32_t x, uint32_t y, uint8_t component) {
+	double detail = *(const double*)context;
+	double light = 0.4 + 0.6 * ((detail < 1) ? detail : 1);
+	if (component != 0) {
+		return 128 + (int)(light * ((x / 64 + y / 48) % 5) * 4);
+	}
+	double level = (y < 330) ? 200 - y / 6 : 100 + ((x / 80) % 2) * 12;
+	if (y > 530 && y < 550 && (x / 100) % 2) {
+		level = 240;
+	}
+	double texture = (int)(hash((x + 1) / 5, (y + 1) / 5) % 21) - 10;
+	level = level * light + texture * detail;
+	return (level < 0) ? 0 : (level > 255) ? 255 : (uint8_t)level;
+}
+
+static void
+tabulate(void) {
+	HostJpegOptions options = { 1280, 720, 3, 2, 1, 0, 0, 0 };
+	for (int d = 0; d < DETAIL_STEPS; d++) {
+		double detail = DETAIL_MAX * d / (DETAIL_STEPS - 1);
+		for (int q = 0; q < QSCALE_STEPS; q++) {
+			options.Quality = quality(qscales[q]);
+			uint32_t length = host_jpeg_encode(&options, scene, &detail, frame, FRAME_MAX, NULL);
+			CHECK(length > 0);
+			logSizes[d][q] = log(length);
+		}
+	}
+}
+
+/* Frame size for a detail and qscale, interpolated from the table in the
+   detail and the log of the qscale. */
+static uint32_t
+frame_size(double detail, uint8_t qscale) {
+	double dPosition = detail / DETAIL_MAX * (DETAIL_STEPS - 1);
+	int d = (int)dPosition;
+	d = (d < 0) ? 0 : (d > DETAIL_STEPS - 2) ? DETAIL_STEPS - 2 : d;
+	double dFraction = dPosition - d;
+
+	int q = 0;
+	while (q < QSCALE_STEPS - 2 && qscales[q + 1] < qscale) {
+		q++;
+	}
+	double qFraction = log((double)qscale / qscales[q]) / log((double)qscales[q + 1] / qscales[q]);
+
+	double low = logSizes[d][q] + (logSizes[d][q + 1] - logSizes[d][q]) * qFraction;
+	double high = logSizes[d + 1][q] + (logSizes[d + 1][q + 1] - logSizes[d + 1][q]) * qFraction;
+	return (uint32_t)exp(low + (high - low) * dFraction);
+}
+
+/* Scene detail for frame i, from midnight. */
+static double
+detail_at(int i, double* cloud) {
+	double hours = (double)i * IMAGE_RATE_MS / (60 * 60 * 1000);
+	double day = 0.5 + 0.5 * sin(2 * M_PI * (hours - 6) / 24);
+	*cloud += ((double)rand() / RAND_MAX - 0.5) * 0.01;
+	*cloud = (*cloud < -0.3) ? -0.3 : (*cloud > 0.3) ? 0.3 : *cloud;
+	double noise = 1 + ((double)rand() / RAND_MAX - 0.5) * 0.1;
+	return (0.15 + 0.85 * day) * (1 + *cloud) * noise;
+}
+
+static void
+sizes_add(Sizes* sizes, uint32_t length) {
+	uint32_t tolerance = IMAGE_TARGET_BYTES / 100 * IMAGE_TARGET_TOLERANCE_PERCENT;
+	if (length + tolerance >= IMAGE_TARGET_BYTES && length <= IMAGE_TARGET_BYTES + tolerance) {
+		sizes->Within++;
+	}
+	sizes->Sum += length;
+	sizes->SumSquares += (double)length * length;
+	sizes->Min = (sizes->Min == 0 || length < sizes->Min) ? length : sizes->Min;
+	sizes->Max = (length > sizes->Max) ? length : sizes->Max;
+}
+
+static double
+sizes_print(const char* name, const Sizes* sizes) {
+	double mean = sizes->Sum / FRAMES;
+	double sd = sqrt(sizes->SumSquares / FRAMES - mean * mean);
+	double within = 100.0 * sizes->Within / FRAMES;
+	printf("%-16s %5.1f%% in %u KB +-%u%%, mean %5.1f KB, sd %5.1f KB, %5.1f to %5.1f KB\n",
+			name, within, IMAGE_TARGET_BYTES / 1024, IMAGE_TARGET_TOLERANCE_PERCENT,
+			mean / 1024, sd / 1024, sizes->Min / 1024, sizes->Max / 1024);
+	return within;
+}
+
+int
+main(void) {
+	tabulate();
+
+	Sizes fixed = { 0 }, controlled = { 0 };
+	double cloud = 0;
+	unsigned changes = 0;
+	hostQscale = QSCALE_UNSCALED;
+	srand(36);
+	for (int i = 0; i < FRAMES; i++) {
+		double detail = detail_at(i, &cloud);
+		sizes_add(&fixed, frame_size(detail, QSCALE_UNSCALED));
+
+		uint8_t qscale = hostQscale;
+		uint32_t length = frame_size(detail, qscale);
+		sizes_add(&controlled, length);
+		camera_size_control(length);
+		CHECK(hostQscale >= OV5642_QSCALE_MIN && hostQscale <= OV5642_QSCALE_MAX);
+		changes += (hostQscale != qscale);
+	}
+
+	printf("%u frames, %u qscale changes\n", FRAMES, changes);
+	double fixedWithin = sizes_print("fixed qscale 12", &fixed);
+	double controlledWithin = sizes_print("size control", &controlled);
+	CHECK(fixed.Max > 2 * fixed.Min);
+	CHECK(controlledWithin > 90);
+	CHECK(controlledWithin > 3 * fixedWithin);
+	CHECK(changes < FRAMES / 4);
+
+	/* At the ends of the range, frames far off the target leave qscale
+	   alone, however far the controller would like to go. */
+	unsigned long writes = hostQscaleWrites;
+	hostQscale = OV5642_QSCALE_MAX;
+	camera_size_control(IMAGE_TARGET_BYTES * 20);
+	CHECK(hostQscale == OV5642_QSCALE_MAX);
+	hostQscale = OV5642_QSCALE_MIN;
+	camera_size_control(IMAGE_TARGET_BYTES / 20);
+	CHECK(hostQscale == OV5642_QSCALE_MIN);
+	CHECK(hostQscaleWrites == writes);
+
+	/* Near the ends, the step stops at the end of the range. */
+	hostQscale = OV5642_QSCALE_MAX - 1;
+	camera_size_control(IMAGE_TARGET_BYTES * 20);
+	CHECK(hostQscale == OV5642_QSCALE_MAX);
+	hostQscale = OV5642_QSCALE_MIN + 1;
+	camera_size_control(IMAGE_TARGET_BYTES / 20);
+	CHECK(hostQscale == OV5642_QSCALE_MIN);
+	CHECK(hostQscaleWrites == writes + 2);
+	printf("qscale held within %d to %d\n", OV5642_QSCALE_MIN, OV5642_QSCALE_MAX);
+
+	printf("ok\n");
+	return 0;
+}
@@ -0,0 +1,234 @@
+/**
+ * Thumbnails from the JPEG DC coefficients, through the camera task with a
+ * simulated FIFO. Over a range of sizes, chroma sampling, qualities and
+ * restart intervals, each pixel of the stored thumbnail must match the
+ * mean of its encoded 8x8 luma block. Frames too wide for a thumbnail, or
+ * whose headers are not in the first burst, are stored without one and
+ * counted. The decode of a 5 MP frame is timed against a cycle budget.
+ */
+
+#include <time.h>
+
+#include "host.h"
+#include "ring_log.h"
+#include "jpeg.h"
+#include "task/camera_task.h"
+
+#define FRAME_MAX (2 << 20)
+#define THUMB_MAX (JPEG_THUMBNAIL_WIDTH * 256 + 64)
+
+uint8_t camera_task_setup(void);
+void start_image(void);
+void poll_image(void);
+extern uint8_t captureActive;
+
+/* Largest difference allowed between a thumbnail pixel and the mean of its
+   block, in grey levels, for the DC quantisation and the rounding. */
+#define THUMBNAIL_ERROR 2
+
+/* The STM32F401 at 84 MHz, and an estimate of how much slower it runs the
+   decoder than the host: a core retiring several instructions a cycle at
+   a few GHz, against one with flash wait states. */
+#define TARGET_HZ       84000000.0
+#define TARGET_SLOWDOWN 100.0
+
+/* The decode of a 5 MP frame may take a tenth of the time between frames. */
+#define DECODE_BUDGET_CYCLES (TARGET_HZ * IMAGE_RATE_MS / 1000 / 10)
+#define DECODE_RUNS 5
+
+typedef struct _Geometry {
+	const char* Name;
+	HostJpegOptions Options;
+} Geometry;
+
+static const Geometry geometries[] = {
+	{ "5 MP 4:2:2",      { 2592, 1944, 3, 2, 1, 60, 0, 0 } },
+	{ "1080p 4:2:2",     { 1920, 1080, 3, 2, 1, 75, 0, 0 } },
+	{ "1080p 4:2:0 rst", { 1920, 1080, 3, 2, 2, 50, 4, 0 } },
+	{ "VGA 4:4:4",       { 640, 480, 3, 1, 1, 90, 0, 0 } },
+	{ "odd 4:2:0 rst",   { 333, 217, 3, 2, 2, 80, 3, 0 } },
+	{ "QVGA grey",       { 320, 240, 1, 1, 1, 85, 0, 0 } },
+};
+#define GEOMETRIES (int)(sizeof(geometries) / sizeof(geometries[0]))
+
+static uint8_t frame[FRAME_MAX];
+static uint8_t means[(2592 / 8) * (1944 / 8)];
+static uint8_t thumbnail[THUMB_MAX];
+static JpegDcDecoder decoder;
+
+static uint32_t
+hash(uint32_t x, uint32_t y) {
+	uint32_t h = x * 0x9E3779B1u ^ y * 0x85EBCA77u;
+	h ^= h >> 15;
+	h *= 0x2C1B3C6Du;
+	h ^= h >> 12;
+	return h;
+}
+
+/* Sky over a road with lane marks, with texture, scaled to the frame. */
+static uint8_t
+scene(void* context, uint32_t x, uint32_t y, uint8_t component) {
+	const HostJpegOptions* options = context;
+	uint32_t sx = x * 2592 / options->Width, sy = y * 1944 / options->Height;
+	if (component != 0) {
+		return 128 + (int)((sx / 64 + sy / 48) % 5) * 4 - (component == 2) * 10;
+	}
+	int level = (sy < 700) ? 200 - sy / 8 : 90 + ((sx / 120) % 2) * 15;
+	if (sy > 1300 && sy < 1330 && (sx / 160) % 2) {
+		level = 235;
+	}
+	return level + (int)(hash(x / 3, y / 3) % 13) - 6;
+}
+
+/* Capture a frame through the camera task, a keyframe so it is stored. */
+static void
+capture(uint32_t length) {
+	host_fifo_load(frame, length, 100);
+	hostTicks += SCENE_KEYFRAME_MS;
+	start_image();
+	CHECK(captureActive);
+	while (captureActive) {
+		poll_image();
+	}
+}
+
+/* The last record of a store, or a record with no type if it is empty. */
+static RingRecord
+last_record(RingLog* log) {
+	RingCursor cursor;
+	RingRecord record, last = { 0 };
+	rlog_cursor(log, &cursor);
+	while (rlog_next(log, &cursor, &record) == RLOG_OK) {
+		last = record;
+	}
+	return last;
+}
+
+/* Capture a frame and check its thumbnail against the block means. Returns
+   the worst difference. */
+static int
+check_thumbnail(const Geometry* geometry) {
+	const HostJpegOptions* options = &geometry->Options;
+	uint32_t length = host_jpeg_encode(options, scene, (void*)options, frame, FRAME_MAX, means);
+	CHECK(length > 0);
+	uint32_t images = imageStore.HeadSequence;
+	uint32_t thumbnails = thumbStore.HeadSequence;
+	capture(length);
+	CHECK(imageStore.HeadSequence == images + 1);
+	CHECK(thumbStore.HeadSequence == thumbnails + 1);
+
+	/* A binary PGM naming its image. */
+	RingRecord record = last_record(&thumbStore);
+	CHECK(record.Header.Type == RLOG_TYPE_THUMB);
+	CHECK(record.Header.Length < THUMB_MAX);
+	CHECK(rlog_read(&thumbStore, &record, 0, thumbnail, record.Header.Length) == RLOG_OK);
+	thumbnail[record.Header.Length] = '\0';
+	unsigned long sequence;
+	unsigned width, height;
+	int header = 0;
+	CHECK(sscanf((char*)thumbnail, "P5\n# dcim%lu.jpg\n%u %u\n255\n%n",
+			&sequence, &width, &height, &header) == 3);
+	CHECK(header > 0);
+	CHECK(sequence == images);
+	CHECK(width == (options->Width + 7u) / 8 && height == (options->Height + 7u) / 8);
+	CHECK(record.Header.Length == header + width * height);
+
+	int worst = 0;
+	for (uint32_t i = 0; i < width * height; i++) {
+		int error = abs(thumbnail[header + i] - means[i]);
+		worst = (error > worst) ? error : worst;
+	}
+	printf("%-16s %4ux%-4u %7lu bytes, %3ux%-3u thumbnail, worst difference %d\n", geometry->Name,
+			options->Width, options->Height, (unsigned long)length, width, height, worst);
+	CHECK(worst <= THUMBNAIL_ERROR);
+	return worst;
+}
+
+/* Capture a frame that should be stored without a thumbnail. */
+static void
+check_skipped(const char* name, const HostJpegOptions* options) {
+	uint32_t length = host_jpeg_encode(options, scene, (void*)options, frame, FRAME_MAX, NULL);
+	CHECK(length > 0);
+	uint32_t images = imageStore.HeadSequence;
+	uint32_t thumbnails = thumbStore.HeadSequence;
+	uint32_t skipped = thumbnailsSkipped;
+	capture(length);
+	CHECK(imageStore.HeadSequence == images + 1);
+	CHECK(thumbStore.HeadSequence == thumbnails);
+	CHECK(!thumbStore.Writing);
+	CHECK(thumbnailsSkipped == skipped + 1);
+	printf("%-16s %4ux%-4u stored without a thumbnail and counted\n", name, options->Width, options->Height);
+}
+
+/* Decode a frame in capture bursts as read_image() does. */
+static void
+decode(uint32_t length) {
+	uint32_t position = jpeg_dc_begin(&decoder, frame, MIN(length, CAPTURE_BURST_LENGTH));
+	CHECK(position > 0);
+	while (position < length) {
+		uint32_t end = MIN((position / CAPTURE_BURST_LENGTH + 1) * CAPTURE_BURST_LENGTH, length);
+		jpeg_dc_decode(&decoder, frame + position, end - position, end == length);
+		position = end;
+	}
+	CHECK(decoder.State == JPEG_DC_DONE);
+}
+
+static double
+seconds(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+int
+main(void) {
+	host_disk_create(90000);
+	fn_initvolume(host_disk_initfunc);
+	CHECK(f_format(F_FAT16_MEDIA) == F_NO_ERROR);
+	fn_delvolume();
+	CHECK(camera_task_setup() == 1);
+	CHECK(thumbStore.Mounted);
+
+	int worst = 0;
+	for (int i = 0; i < GEOMETRIES; i++) {
+		int error = check_thumbnail(&geometries[i]);
+		worst = (error > worst) ? error : worst;
+	}
+
+	/* Wider than JPEG_THUMBNAIL_WIDTH blocks. Once stored, the same frame
+	   is logged as unchanged, and not counted. */
+	HostJpegOptions wide = { 2720, 200, 3, 2, 1, 60, 0, 0 };
+	check_skipped("too wide", &wide);
+	uint32_t images = imageStore.HeadSequence;
+	uint32_t skipped = thumbnailsSkipped;
+	hostTicks += IMAGE_RATE_MS - SCENE_KEYFRAME_MS;
+	capture(host_jpeg_encode(&wide, scene, &wide, frame, FRAME_MAX, NULL));
+	CHECK(imageStore.HeadSequence == images);
+	CHECK(thumbnailsSkipped == skipped);
+
+	/* Headers that run past the first burst. */
+	HostJpegOptions padded = { 640, 480, 3, 2, 1, 75, 0, CAPTURE_BURST_LENGTH };
+	check_skipped("long headers", &padded);
+
+	/* The decode of a 5 MP frame, the best of a few runs. */
+	const HostJpegOptions* options = &geometries[0].Options;
+	uint32_t length = host_jpeg_encode(options, scene, (void*)options, frame, FRAME_MAX, NULL);
+	double best = 0;
+	for (int run = 0; run < DECODE_RUNS; run++) {
+		double start = seconds();
+		decode(length);
+		double elapsed = seconds() - start;
+		best = (run == 0 || elapsed < best) ? elapsed : best;
+	}
+	double cycles = best * TARGET_HZ * TARGET_SLOWDOWN;
+	uint32_t mcus = decoder.McusX * decoder.McusY;
+	printf("5 MP decode: %.1f ms on the host, about %.0f M cycles on the target, "
+			"%.0f per MCU, %.0f per byte, budget %.0f M\n", best * 1e3, cycles / 1e6,
+			cycles / mcus, cycles / length, DECODE_BUDGET_CYCLES / 1e6);
+	CHECK(cycles <= DECODE_BUDGET_CYCLES);
+
+	printf("worst thumbnail difference %d grey levels\n", worst);
+	host_disk_destroy();
+	printf("ok\n");
+	return 0;
+}
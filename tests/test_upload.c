@@ -0,0 +1,252 @@
+/**
+ * POSTs of the records on the SD card, through the Skywire task's manifest
+ * upload with a simulated card and modem. A record the card cannot read
+ * stops the POST short, with nothing sent in its place, and the records
+ * stay in the logs until a later POST gets them to the server. The SAME
+ * lines of unchanged scenes, logged between the sample records, go up in
+ * an attachment of their own, and samples.bin decodes through
+ * tools/sample_decode.py to every sample.
+ */
+
+#include <unistd.h>
+
+#include "host.h"
+#include "hayes.h"
+#include "ring_log.h"
+#include "task/camera_task.h"
+#include "task/skywire_task.h"
+#include "task/beacon_task.h"
+#include "peripheral/skywire.h"
+
+uint8_t camera_task_setup(void);
+void flush_samples(void);
+uint8_t get_manifest(Manifest* manifest);
+uint8_t post_manifest(ATDevice* dev, Manifest* manifest);
+uint8_t parse_response(ATDevice* dev, uint8_t* speedLimit, uint32_t* resend);
+void free_manifest(Manifest* manifest);
+void camera_log_unchanged(TickType_t tickCount);
+int format_readings(char* buffer, uint8_t length, Sample* sample);
+extern uint32_t sceneReferenceSequence;
+
+#ifndef SAMPLE_DECODE
+#define SAMPLE_DECODE "../tools/sample_decode.py"
+#endif
+
+#define IMAGE_LENGTH 3000
+#define SAMPLES_MAX  64
+#define LINE_MAX     160
+
+static Sample sampleStorage[64];
+static char modemBuffer[512];
+static uint8_t image[IMAGE_LENGTH];
+static Sample added[SAMPLES_MAX];
+static uint32_t addedCount;
+static char expected[SAMPLES_MAX * LINE_MAX];
+static char output[SAMPLES_MAX * LINE_MAX];
+
+/* Flush a batch of samples to the data log. */
+static void
+add_samples(uint8_t count) {
+	for (uint8_t i = 0; i < count; i++) {
+		hostTicks += 5000;
+		Sample sample = { hostTicks, 101325 + i, 2000 + i, 2100, 4550 };
+		CHECK(sample_ring_put(&sampleRing, &sample, 0) == SAMPLE_RING_OK);
+		if (addedCount < SAMPLES_MAX) {
+			added[addedCount++] = sample;
+		}
+	}
+	flush_samples();
+}
+
+/* Store an image of a recognisable pattern. */
+static void
+add_image(uint8_t seed) {
+	for (uint32_t i = 0; i < IMAGE_LENGTH; i++) {
+		image[i] = (uint8_t)(i * 7 + seed + (i >> 8));
+	}
+	CHECK(rlog_append(&imageStore, RLOG_TYPE_JPEG, hostTicks, image, IMAGE_LENGTH) == RLOG_OK);
+	rlog_flush(&imageStore);
+}
+
+/* The sector of the card in the middle of the image last stored, which
+   holds neither its record header nor the next. */
+static unsigned long
+image_sector(void) {
+	for (unsigned long offset = 0; offset + IMAGE_LENGTH <= hostDiskSectors * HOST_SECTOR_SIZE; offset++) {
+		if (memcmp(hostDisk + offset, image, IMAGE_LENGTH) == 0) {
+			return (offset + IMAGE_LENGTH / 2) / HOST_SECTOR_SIZE;
+		}
+	}
+	CHECK(0);
+	return 0;
+}
+
+/* Find an attachment by name in the chunks of the POST. Each chunk must
+   be its attachment's declared length plus the header. */
+static uint8_t*
+attachment(const char* name, uint32_t* length) {
+	hostModemTx[hostModemTxLength] = '\0';
+	char* p = strstr((char*)hostModemTx, "\r\n\r\n");
+	CHECK(p != NULL);
+	p += 4;
+	for (;;) {
+		unsigned long chunk = strtoul(p, NULL, 16);
+		p = strstr(p, "\r\n") + 2;
+		if (chunk == 0) {
+			return NULL;
+		}
+		char header[33], found[32];
+		unsigned long declared;
+		memcpy(header, p, 32);
+		header[32] = '\0';
+		CHECK(sscanf(header, "%31[^,],%lu", found, &declared) == 2);
+		CHECK(declared + 32 == chunk);
+		if (strcmp(found, name) == 0) {
+			*length = declared;
+			return (uint8_t*)p + 32;
+		}
+		p += chunk;
+		CHECK(p[0] == '\r' && p[1] == '\n');
+		p += 2;
+	}
+}
+
+/* Decode samples.bin as the server does, errors and all. */
+static void
+decode(const uint8_t* data, uint32_t length) {
+	char path[] = "/tmp/samplesXXXXXX";
+	int descriptor = mkstemp(path);
+	CHECK(descriptor >= 0);
+	CHECK(write(descriptor, data, length) == (ssize_t)length);
+	close(descriptor);
+
+	char command[512];
+	snprintf(command, sizeof(command), "python3 %s %s 2>&1", SAMPLE_DECODE, path);
+	FILE* pipe = popen(command, "r");
+	CHECK(pipe != NULL);
+	size_t read = fread(output, 1, sizeof(output) - 1, pipe);
+	output[read] = '\0';
+	CHECK(pclose(pipe) == 0);
+	unlink(path);
+}
+
+/* POST the records on the card, as the Skywire task does. Returns 1 if
+   the server has them. */
+static uint8_t
+upload(ATDevice* dev, Manifest* manifest) {
+	host_modem_reset();
+	CHECK(get_manifest(manifest));
+	if (!post_manifest(dev, manifest)) {
+		return 0;
+	}
+	uint8_t speedLimit;
+	uint32_t resend;
+	if (!parse_response(dev, &speedLimit, &resend)) {
+		return 0;
+	}
+	free_manifest(manifest);
+	return 1;
+}
+
+int
+main(void) {
+	host_disk_create(90000);
+	fn_initvolume(host_disk_initfunc);
+	CHECK(f_format(F_FAT16_MEDIA) == F_NO_ERROR);
+	fn_delvolume();
+	CHECK(camera_task_setup() == 1);
+	CHECK(sample_ring_init(&sampleRing, sampleStorage, 64, SAMPLE_RING_OVERWRITE, 1) == SAMPLE_RING_OK);
+	xSLUpdatesQueue = xQueueCreate(8, sizeof(SLUpdate));
+
+	ATDevice dev;
+	dev.api.count = skywire_count;
+	dev.api.getc = skywire_getc;
+	dev.api.write = (uint8_t (*)(uint8_t*, uint8_t, uint8_t))skywire_write;
+	dev.buffer = modemBuffer;
+	dev.length = sizeof(modemBuffer);
+
+	for (uint8_t i = 0; i < 3; i++) {
+		add_samples(SAMPLE_FLUSH_BATCH);
+	}
+	add_image(1);
+	add_image(2);
+
+	/* The middle of the second image cannot be read. The POST stops in its
+	   chunk with no terminating chunk, and nothing is released. */
+	hostDiskBadRead = image_sector();
+	Manifest manifest;
+	CHECK(!upload(&dev, &manifest));
+	CHECK(manifest.samples.count == 3 && manifest.images.count == 2);
+	hostModemTx[hostModemTxLength] = '\0';
+	CHECK(strstr((char*)hostModemTx, "\r\n0\r\n\r\n") == NULL);
+
+	/* The image went out up to the sector that failed, and nothing after
+	   it: no padding in place of the rest. */
+	uint8_t* body = NULL;
+	for (uint8_t* p = hostModemTx; p + 32 <= hostModemTx + hostModemTxLength; p++) {
+		if (memcmp(p, "dcim", 4) == 0) {
+			body = p + 32;
+		}
+	}
+	CHECK(body != NULL);
+	uint32_t sent = hostModemTx + hostModemTxLength - body;
+	CHECK(sent < IMAGE_LENGTH);
+	CHECK(memcmp(body, image, sent) == 0);
+	CHECK(rlog_used(&dataLog) > 0 && rlog_used(&imageStore) > 0);
+	printf("read failure: POST abandoned %lu bytes into a %d byte image, records kept\n",
+			(unsigned long)sent, IMAGE_LENGTH);
+
+	/* Once the card reads again, the same records go up and are released. */
+	hostDiskBadRead = (unsigned long)-1;
+	CHECK(upload(&dev, &manifest));
+	CHECK(manifest.samples.count == 3 && manifest.images.count == 2);
+	CHECK(rlog_used(&dataLog) == 0 && rlog_used(&imageStore) == 0);
+	printf("retry: records uploaded and released\n");
+
+	/* Frames logged as unchanged between the sample records. */
+	addedCount = 0;
+	uint32_t sameLength = 0;
+	add_samples(SAMPLE_FLUSH_BATCH);
+	for (uint8_t i = 0; i < 2; i++) {
+		hostTicks += 1000;
+		camera_log_unchanged(hostTicks);
+		sameLength += snprintf(expected + sameLength, sizeof(expected) - sameLength,
+				"SAME:{\"tick\":%lu,\"file\":\"dcim%lu.jpg\"}\n",
+				(unsigned long)hostTicks, (unsigned long)sceneReferenceSequence);
+		add_samples(SAMPLE_FLUSH_BATCH - 5 * i);
+	}
+	CHECK(upload(&dev, &manifest));
+	CHECK(manifest.samples.count == 5);
+	CHECK(rlog_used(&dataLog) == 0);
+
+	/* The SAME lines as they were logged. */
+	uint32_t length;
+	uint8_t* same = attachment(SAME_ATTACHMENT, &length);
+	CHECK(same != NULL);
+	CHECK(length == sameLength && memcmp(same, expected, length) == 0);
+
+	/* Every sample, and nothing the decoder cannot read. */
+	uint8_t* samples = attachment(SAMPLE_ATTACHMENT, &length);
+	CHECK(samples != NULL);
+	decode(samples, length);
+	uint32_t lines = 0;
+	for (uint32_t i = 0; i < addedCount; i++) {
+		char readings[LINE_MAX];
+		format_readings(readings, LINE_MAX, &added[i]);
+		lines += snprintf(expected + lines, sizeof(expected) - lines, "DATA:{\"tick\":%lu,%s}\n",
+				(unsigned long)added[i].TickCount, readings);
+	}
+	CHECK(strcmp(output, expected) == 0);
+	printf("unchanged scenes: %lu samples decoded, 2 SAME lines in %s\n",
+			(unsigned long)addedCount, SAME_ATTACHMENT);
+
+	/* With no SAME lines, there is no SAME attachment. */
+	add_samples(3);
+	CHECK(upload(&dev, &manifest));
+	CHECK(attachment(SAMPLE_ATTACHMENT, &length) != NULL && length > 0);
+	CHECK(attachment(SAME_ATTACHMENT, &length) == NULL);
+
+	host_disk_destroy();
+	printf("ok\n");
+	return 0;
+}
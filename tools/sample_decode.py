@@ -0,0 +1,193 @@
+#!/usr/bin/env python3
+"""
+Decode the samples uploaded as samples.bin back into the DATA lines the
+firmware used to write, one per sample:
+
+  DATA:{"tick":5000,"lps331":{"temp":21.25,"pres":1013.25},"hts221":{...}}
+
+The file is a run of packed blocks (include/sample_pack.h) and
+SampleRecords (include/sample_record.h), told apart by their first byte.
+Records and blocks with an unknown version or a bad CRC are reported on
+stderr and skipped, and decoding carries on after them. The SAME lines of
+unchanged scenes are uploaded apart from the samples, as same.txt.
+
+With --stats, print how many bytes the samples took against SampleRecords
+and DATA lines, in place of the lines themselves.
+
+Usage: sample_decode.py [--stats] [samples.bin ...]   (stdin if no files)
+"""
+
+import struct
+import sys
+import zlib
+
+SAMPLE_RECORD_VERSION = 1
+SAMPLE_PACK_VERSION = 2
+RECORD = struct.Struct("<BBhIihhI")
+PACK_HEADER = struct.Struct("<BBH")
+PACK_OVERHEAD = PACK_HEADER.size + 4
+
+PACK_TICK_WIDTHS = (7, 9, 12, 32)
+PACK_VALUE_WIDTHS = (4, 8, 16, 32)
+
+MISSING_LPS331_TEMP = 0x01
+MISSING_LPS331_PRES = 0x02
+MISSING_HTS221_TEMP = 0x04
+MISSING_HTS221_HUM = 0x08
+
+
+def hundredths(value, missing):
+    """Format a value held in hundredths as format_hundredths() does."""
+    if missing:
+        return "null"
+    sign = "-" if value < 0 else ""
+    magnitude = abs(value)
+    return "%s%d.%02d" % (sign, magnitude // 100, magnitude % 100)
+
+
+def data_line(tick, missing, lps_temp, lps_pres, hts_temp, hts_hum):
+    """Return the DATA line for one sample."""
+    return ('DATA:{"tick":%d,'
+            '"lps331":{"temp":%s,"pres":%s},'
+            '"hts221":{"temp":%s,"hum":%s}}\n') % (
+        tick,
+        hundredths(lps_temp, missing & MISSING_LPS331_TEMP),
+        hundredths(lps_pres, missing & MISSING_LPS331_PRES),
+        hundredths(hts_temp, missing & MISSING_HTS221_TEMP),
+        hundredths(hts_hum, missing & MISSING_HTS221_HUM))
+
+
+def int32(value):
+    """Wrap a number to a signed 32-bit integer."""
+    value &= 0xFFFFFFFF
+    return value - (1 << 32) if value & 0x80000000 else value
+
+
+class BitReader:
+    """Read a bit stream most significant bit first."""
+
+    def __init__(self, data):
+        self.data = data
+        self.position = 0
+
+    def bits(self, count):
+        value = 0
+        for _ in range(count):
+            byte = self.data[self.position >> 3]
+            value = (value << 1) | ((byte >> (7 - (self.position & 7))) & 1)
+            self.position += 1
+        return value
+
+    def number(self, widths):
+        """Read a zigzag coded number written by pack_number()."""
+        size = 0
+        while size < len(widths) and self.bits(1):
+            size += 1
+        zigzag = self.bits(widths[size - 1]) if size else 0
+        return (zigzag >> 1) ^ -(zigzag & 1)
+
+
+def decode_record(data):
+    """Return the DATA line for one record, or None if it is not valid."""
+    (version, missing, lps_temp, tick, lps_pres,
+     hts_temp, hts_hum, crc) = RECORD.unpack(data)
+    if version != SAMPLE_RECORD_VERSION:
+        return None
+    if zlib.crc32(data[:RECORD.size - 4]) != crc:
+        return None
+    return data_line(tick, missing, lps_temp, lps_pres, hts_temp, hts_hum)
+
+
+def decode_block(data):
+    """Return the DATA lines of a packed block, or None if it is not valid."""
+    version, count, length = PACK_HEADER.unpack_from(data)
+    if version != SAMPLE_PACK_VERSION or length != len(data):
+        return None
+    if zlib.crc32(data[:-4]) != struct.unpack_from("<I", data, length - 4)[0]:
+        return None
+
+    reader = BitReader(data[PACK_HEADER.size:-4])
+    tick = tick_delta = missing = 0
+    values = [0, 0, 0, 0]
+    lines = []
+    try:
+        for _ in range(count):
+            tick_delta = (tick_delta + reader.number(PACK_TICK_WIDTHS)) & 0xFFFFFFFF
+            tick = (tick + tick_delta) & 0xFFFFFFFF
+            if reader.bits(1):
+                missing = reader.bits(4)
+            for channel in range(len(values)):
+                if not missing & (1 << channel):
+                    values[channel] = int32(values[channel]
+                                            + reader.number(PACK_VALUE_WIDTHS))
+            lines.append(data_line(tick, missing, *values))
+    except IndexError:
+        return None
+    return lines
+
+
+def decode(data, name="<stdin>"):
+    """Yield the DATA lines of each valid record and block in a file."""
+    offset = 0
+    while offset < len(data):
+        if data[offset] == SAMPLE_PACK_VERSION and \
+                len(data) - offset >= PACK_OVERHEAD:
+            length = PACK_HEADER.unpack_from(data, offset)[2]
+            if PACK_OVERHEAD <= length <= len(data) - offset:
+                lines = decode_block(data[offset:offset + length])
+                if lines is not None:
+                    yield from lines
+                    offset += length
+                    continue
+        if len(data) - offset < RECORD.size:
+            sys.stderr.write("%s: %d trailing bytes ignored\n"
+                             % (name, len(data) - offset))
+            return
+        line = decode_record(data[offset:offset + RECORD.size])
+        if line is None:
+            sys.stderr.write("%s: bad record at offset %d\n" % (name, offset))
+        else:
+            yield line
+        offset += RECORD.size
+
+
+def stats(files):
+    """Print the size of the samples in each form, and the ratios."""
+    size = samples = text = 0
+    for name, data in files:
+        size += len(data)
+        for line in decode(data, name):
+            samples += 1
+            text += len(line)
+    if samples == 0:
+        print("no samples")
+        return
+    records = samples * RECORD.size
+    print("samples        %10d" % samples)
+    print("stored bytes   %10d  %6.2f per sample" % (size, size / samples))
+    print("as records     %10d  %6.2f times larger" % (records, records / size))
+    print("as DATA lines  %10d  %6.2f times larger" % (text, text / size))
+
+
+def main(argv):
+    args = argv[1:]
+    show_stats = "--stats" in args
+    names = [arg for arg in args if arg != "--stats"]
+    if names:
+        files = []
+        for name in names:
+            with open(name, "rb") as f:
+                files.append((name, f.read()))
+    else:
+        files = [("<stdin>", sys.stdin.buffer.read())]
+
+    if show_stats:
+        stats(files)
+        return 0
+    for name, data in files:
+        sys.stdout.writelines(decode(data, name))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))